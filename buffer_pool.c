@@ -0,0 +1,169 @@
+/**
+ * @file buffer_pool.c
+ * @brief Réserve de buffers par thread pour les lectures d'images.
+ *
+ * Chaque buffer est précédé d'un en-tête indiquant sa classe, ce qui
+ * permet de le rendre sans connaître sa taille. Les buffers plus grands
+ * que la plus grande classe sont alloués et libérés directement.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdint.h> // pour uint32_t
+#include <stdlib.h> // pour malloc, calloc, free
+#include <pthread.h> // pour pthread_once, pthread_key_t
+
+#include "buffer_pool.h"
+
+#define BUFFER_NO_CLASS UINT32_MAX // buffer hors classe, jamais gardé
+
+// En-tête placé devant chaque buffer ; la taille de l'union garde les
+// buffers alignés comme ceux de malloc
+union buffer_header {
+    struct {
+        uint32_t class;
+    } info;
+    long double align_ld;
+    void* align_ptr;
+};
+
+// Buffers gardés par un thread
+struct buffer_pool {
+    union buffer_header* free[BUFFER_CLASSES][BUFFER_DEPTH];
+    uint32_t count[BUFFER_CLASSES];
+    // Mémoire occupée par les buffers gardés
+    size_t kept;
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_key;
+static int pool_key_ok = 0;
+
+/********************************************************************//**
+ * Taille des buffers d'une classe
+ */
+static size_t class_size(uint32_t class)
+{
+    return (size_t)BUFFER_MIN_SIZE << class;
+}
+
+/********************************************************************//**
+ * Plus petite classe pouvant contenir size octets, BUFFER_NO_CLASS si
+ * aucune ne le peut
+ */
+static uint32_t size_class(size_t size)
+{
+    uint32_t class = 0;
+
+    while (class < BUFFER_CLASSES && class_size(class) < size)
+        class++;
+
+    return (class < BUFFER_CLASSES) ? class : BUFFER_NO_CLASS;
+}
+
+/********************************************************************//**
+ * Libère les buffers gardés par une réserve, puis la réserve
+ */
+static void pool_destroy(void* data)
+{
+    struct buffer_pool *pool = data;
+
+    for (uint32_t class = 0; class < BUFFER_CLASSES; class++) {
+        for (uint32_t i = 0; i < pool->count[class]; i++)
+            free(pool->free[class][i]);
+    }
+
+    free(pool);
+}
+
+/********************************************************************//**
+ * Création de la clé des réserves, une seule fois par processus
+ */
+static void pool_key_init(void)
+{
+    pool_key_ok = (pthread_key_create(&pool_key, pool_destroy) == 0);
+}
+
+/********************************************************************//**
+ * Réserve du thread appelant, créée au besoin ; NULL si elle ne peut pas
+ * l'être (les buffers sont alors simplement alloués et libérés)
+ */
+static struct buffer_pool* pool_get(int create)
+{
+    pthread_once(&pool_once, pool_key_init);
+    if (!pool_key_ok)
+        return NULL;
+
+    struct buffer_pool *pool = pthread_getspecific(pool_key);
+    if (pool == NULL && create) {
+        pool = calloc(1, sizeof(struct buffer_pool));
+        if (pool != NULL && pthread_setspecific(pool_key, pool) != 0) {
+            free(pool);
+            pool = NULL;
+        }
+    }
+
+    return pool;
+}
+
+/********************************************************************/
+void* buffer_acquire (size_t size)
+{
+    const uint32_t class = size_class(size);
+    union buffer_header *header = NULL;
+
+    if (class != BUFFER_NO_CLASS) {
+        struct buffer_pool *pool = pool_get(0);
+
+        if (pool != NULL && pool->count[class] > 0) {
+            header = pool->free[class][--pool->count[class]];
+            pool->kept -= class_size(class);
+        } else {
+            header = malloc(sizeof(union buffer_header) + class_size(class));
+        }
+    } else if (size <= SIZE_MAX - sizeof(union buffer_header)) {
+        header = malloc(sizeof(union buffer_header) + size);
+    }
+
+    if (header == NULL)
+        return NULL;
+
+    header->info.class = class;
+
+    return header + 1;
+}
+
+/********************************************************************/
+void buffer_release (void* buffer)
+{
+    if (buffer == NULL)
+        return;
+
+    union buffer_header *header = (union buffer_header*)buffer - 1;
+    const uint32_t class = header->info.class;
+
+    if (class != BUFFER_NO_CLASS) {
+        struct buffer_pool *pool = pool_get(1);
+
+        if (pool != NULL && pool->count[class] < BUFFER_DEPTH
+            && pool->kept + class_size(class) <= BUFFER_MAX_KEPT) {
+            pool->free[class][pool->count[class]++] = header;
+            pool->kept += class_size(class);
+            return;
+        }
+    }
+
+    free(header);
+}
+
+/********************************************************************/
+void buffer_pool_flush (void)
+{
+    struct buffer_pool *pool = pool_get(0);
+    if (pool == NULL)
+        return;
+
+    pthread_setspecific(pool_key, NULL);
+    pool_destroy(pool);
+}
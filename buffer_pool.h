@@ -0,0 +1,53 @@
+/**
+ * @file buffer_pool.h
+ * @brief Réserve de buffers par thread pour les lectures d'images.
+ *
+ * Chaque lecture d'image (fetch_image, do_read, lazily_resize, serveur)
+ * utilisait un buffer alloué, rempli, puis libéré aussitôt. Les buffers
+ * sont désormais rangés par classe de taille (puissances de deux) et les
+ * buffers rendus sont gardés par le thread qui les a rendus pour la
+ * lecture suivante : en régime établi, une lecture ne fait ni allocation
+ * ni défaut de page. Les buffers ne sont pas remis à zéro.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_BUFFER_POOL_H
+#define PICTDBPRJ_BUFFER_POOL_H
+
+#include <stddef.h> // pour size_t
+
+#define BUFFER_MIN_SIZE  4096 // taille de la plus petite classe (octets)
+#define BUFFER_CLASSES   13 // classes de 4 Ko à 16 Mo
+#define BUFFER_DEPTH     4 // buffers gardés au plus par classe et par thread
+#define BUFFER_MAX_KEPT  (32 * 1024 * 1024) // mémoire gardée au plus par thread (octets)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fournit un buffer d'au moins size octets, non initialisé
+ * @param size Taille minimale du buffer
+ * @return Le buffer, à rendre avec buffer_release, ou NULL si la mémoire manque
+ */
+void* buffer_acquire(size_t size);
+
+/**
+ * @brief Rend un buffer obtenu par buffer_acquire (par n'importe quel thread)
+ * @param buffer Le buffer à rendre (peut être NULL)
+ */
+void buffer_release(void* buffer);
+
+/**
+ * @brief Libère les buffers gardés par le thread appelant. Les autres
+ * threads libèrent les leurs en se terminant.
+ */
+void buffer_pool_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ * @file crc32c.c
+ * @brief CRC-32C (polynôme de Castagnoli, réfléchi)
+ *
+ * Sur x86, l'instruction crc32 de SSE4.2 calcule directement ce CRC ; elle
+ * est utilisée si le processeur la propose (détection à l'exécution, le
+ * reste du programme n'étant pas compilé pour SSE4.2). Sinon, le CRC est
+ * calculé par tables, 8 octets à la fois (slicing-by-8).
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <string.h> // pour memcpy
+#include <pthread.h> // pour pthread_once
+
+#include "crc32c.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_SSE42 1
+#include <nmmintrin.h> // pour _mm_crc32_u8, _mm_crc32_u32, _mm_crc32_u64
+#endif
+
+#define CRC32C_POLY 0x82F63B78U // polynôme 0x1EDC6F41 réfléchi
+
+typedef uint32_t (*crc32c_function)(uint32_t crc, const unsigned char* bytes, size_t len);
+
+static uint32_t crc_table[8][256];
+static crc32c_function crc_update = NULL;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/********************************************************************//**
+ * CRC par tables, 8 octets à la fois (crc non inversé)
+ */
+static uint32_t crc32c_slicing(uint32_t crc, const unsigned char* bytes, size_t len)
+{
+    // Alignement sur 8 octets
+    while (len > 0 && ((uintptr_t)bytes & 7) != 0) {
+        crc = crc_table[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    while (len >= 8) {
+        uint32_t low, high;
+        memcpy(&low, bytes, sizeof(uint32_t));
+        memcpy(&high, bytes + 4, sizeof(uint32_t));
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+
+        crc = crc_table[7][low & 0xFF] ^ crc_table[6][(low >> 8) & 0xFF]
+              ^ crc_table[5][(low >> 16) & 0xFF] ^ crc_table[4][low >> 24]
+              ^ crc_table[3][high & 0xFF] ^ crc_table[2][(high >> 8) & 0xFF]
+              ^ crc_table[1][(high >> 16) & 0xFF] ^ crc_table[0][high >> 24];
+
+        bytes += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        crc = crc_table[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    return crc;
+}
+
+#ifdef CRC32C_SSE42
+/********************************************************************//**
+ * CRC par l'instruction crc32 de SSE4.2 (crc non inversé)
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char* bytes, size_t len)
+{
+    while (len > 0 && ((uintptr_t)bytes & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *bytes++);
+        len--;
+    }
+
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(uint64_t));
+        crc64 = _mm_crc32_u64(crc64, word);
+        bytes += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+
+    while (len >= 4) {
+        uint32_t word;
+        memcpy(&word, bytes, sizeof(uint32_t));
+        crc = _mm_crc32_u32(crc, word);
+        bytes += 4;
+        len -= 4;
+    }
+
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *bytes++);
+        len--;
+    }
+
+    return crc;
+}
+#endif
+
+/********************************************************************//**
+ * Construction des tables et choix de l'implémentation (une seule fois)
+ */
+static void crc32c_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0U - (crc & 1U)));
+
+        crc_table[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int slice = 1; slice < 8; slice++)
+            crc_table[slice][i] = crc_table[0][crc_table[slice - 1][i] & 0xFF] ^ (crc_table[slice - 1][i] >> 8);
+    }
+
+    crc_update = crc32c_slicing;
+
+#ifdef CRC32C_SSE42
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        crc_update = crc32c_sse42;
+#endif
+}
+
+/********************************************************************/
+uint32_t crc32c(uint32_t crc, const void* data, size_t len)
+{
+    pthread_once(&crc_once, crc32c_init);
+
+    return ~crc_update(~crc, data, len);
+}
+
+/********************************************************************/
+const char* crc32c_implementation(void)
+{
+    pthread_once(&crc_once, crc32c_init);
+
+    return (crc_update == crc32c_slicing) ? "slicing-by-8" : "sse4.2";
+}
@@ -0,0 +1,38 @@
+/**
+ * @file crc32c.h
+ * @brief Somme de contrôle CRC-32C (Castagnoli) des images stockées,
+ *        accélérée par SSE4.2 lorsque le processeur le permet.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_CRC32C_H
+#define PICTDBPRJ_CRC32C_H
+
+#include <stddef.h> // pour size_t
+#include <stdint.h> // pour uint32_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Calcule (ou poursuit) le CRC-32C d'un buffer
+ * @param crc CRC des données précédentes (0 pour commencer)
+ * @param data Données
+ * @param len Nombre d'octets
+ * @return CRC des données précédentes suivies de data
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Nom de l'implémentation choisie pour ce processeur
+ * @return "sse4.2" ou "slicing-by-8"
+ */
+const char* crc32c_implementation(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file db_arena.c
+ * @brief Zone des identifiants d'images d'une base ouverte.
+ *
+ * Dans le fichier, chaque metadata réserve MAX_PIC_ID + 1 octets pour
+ * l'identifiant de l'image, qui n'en utilise en général qu'une vingtaine.
+ * En mémoire, les identifiants sont copiés les uns à la suite des autres
+ * dans des blocs, et chaque metadata pointe sur le sien. Un identifiant ne
+ * change jamais de place (les index peuvent donc garder un pointeur) ; la
+ * place d'un identifiant supprimé n'est récupérée qu'à la réouverture de la
+ * base, ou après un gc.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdlib.h> // pour malloc, free
+#include <string.h> // pour memcpy
+
+#include "pictDB.h"
+
+#define ID_BLOCK_SIZE 65536 // taille d'un bloc d'identifiants (octets)
+
+// Bloc d'identifiants, chaînés du plus récent au plus ancien
+struct id_block {
+    struct id_block* next;
+    // Octets déjà utilisés dans data
+    size_t used;
+    char data[ID_BLOCK_SIZE];
+};
+
+/********************************************************************/
+const char* pict_id_intern (struct pictdb_file* db_file, const char* pict_id, size_t length)
+{
+    struct id_block *block = db_file->id_blocks;
+
+    // Un identifiant trop long (fichier endommagé) est gardé tel quel, un
+    // octet au-delà de la limite, pour que verify puisse le signaler
+    if (length > MAX_PIC_ID + 1)
+        length = MAX_PIC_ID + 1;
+
+    if (block == NULL || block->used + length + 1 > ID_BLOCK_SIZE) {
+        block = malloc(sizeof(struct id_block));
+        if (block == NULL)
+            return NULL;
+
+        block->next = db_file->id_blocks;
+        block->used = 0;
+        db_file->id_blocks = block;
+    }
+
+    char *copy = &block->data[block->used];
+    memcpy(copy, pict_id, length);
+    copy[length] = '\0';
+
+    block->used += length + 1;
+
+    return copy;
+}
+
+/********************************************************************/
+void pict_id_arena_free (struct pictdb_file* db_file)
+{
+    struct id_block *block = db_file->id_blocks;
+
+    while (block != NULL) {
+        struct id_block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    db_file->id_blocks = NULL;
+}
@@ -8,12 +8,13 @@
 
 #include "pictDB.h"
 
-#include <string.h> // for strncpy
+#include <string.h> // for strncpy, memset
 #include <stdlib.h> // for calloc
 
 /********************************************************************//**
  * Créé la base de donnée appelée db_filename. Ecrit le header et le
- * tableau de metadata vide préalloué dans le fichier de base de donnée.
+ * tableau de metadata vide préalloué dans le fichier de base de donnée,
+ * suivis de l'extension du header si la base est extensible.
  */
 int do_create(const char* filename, struct pictdb_file* db_file)
 {
@@ -26,10 +27,34 @@ int do_create(const char* filename, struct pictdb_file* db_file)
     db_file->header.db_version = 0;
     db_file->header.num_files = 0;
     db_file->header.unused_32 = 0;
-    db_file->header.unused_64 = 0;
+    db_file->header.ext_offset = 0;
+
+    // Base extensible ou avec needles : l'extension suit la table initiale
+    uint32_t page_size = db_file->ext.page_size;
+    uint32_t format_version = (db_file->ext.format_version == PICTDB_FORMAT_NEEDLES) ? PICTDB_FORMAT_NEEDLES : PICTDB_FORMAT_PAGES;
+    memset(&db_file->ext, 0, sizeof(struct pictdb_header_ext));
+
+    if (page_size != 0 || format_version == PICTDB_FORMAT_NEEDLES) {
+        db_file->header.ext_offset = sizeof(struct pictdb_header) + db_file->header.max_files * sizeof(struct pict_metadata_disk);
+
+        db_file->ext.format_version = format_version;
+        db_file->ext.initial_files = db_file->header.max_files;
+        db_file->ext.page_size = page_size;
+    }
 
     db_file->metadata = NULL;
+    db_file->loaded = NULL;
+    db_file->id_blocks = NULL;
+    db_file->pages = NULL;
     db_file->fpdb = NULL;
+    db_file->cache = NULL;
+    memset(&db_file->list, 0, sizeof(struct list_cache));
+    memset(&db_file->ids, 0, sizeof(struct id_index));
+    memset(&db_file->scan, 0, sizeof(struct meta_scan));
+    db_file->sidecar = NULL;
+    db_file->verify_crc = 0;
+    db_file->live_bytes = 0;
+    db_file->live_version = 0;
 
     // Initialisation des métadatas
     db_file->metadata = calloc(db_file->header.max_files, sizeof(struct pict_metadata));
@@ -7,43 +7,52 @@
  */
 
 #include "pictDB.h"
+#include "sidecar.h"
+#include "needle.h"
+#include "stats.h"
+#include "probes.h"
 #include <string.h>
 
 /********************************************************************//**
  * Suppression d'une image
  */
-int do_delete(const char* id, struct pictdb_file* db_file)
+static int delete_image(const char* id, struct pictdb_file* db_file)
 {
-    int haschanged = 0;
-    uint32_t num_files = 0, i = 0;
-    // Recherche du fichier dans les metadata, puis supression
-    while (i < db_file->header.max_files && num_files < db_file->header.num_files) {
-        struct pict_metadata *metadata = &db_file->metadata[i];
-
-        if (metadata->is_valid == NON_EMPTY) {
-            num_files++;
-
-            if (strcmp(metadata->pict_id, id) == 0) {
-                // Reset à zero de cette metadata
-                memset(metadata, 0, sizeof(struct pict_metadata));
+    uint32_t i = 0;
 
-                haschanged = 1;
-                break;
-            }
-        }
+    // Recherche du fichier dans les metadata
+    int retval = find_pict_id(db_file, id, &i);
+    if (retval != ERR_NONE)
+        return retval;
 
-        i++;
-    }
-
-    // Aucune image trouvée
-    if (!haschanged)
-        return ERR_FILE_NOT_FOUND;
+    // Trace de la suppression dans la zone de données
+    retval = needle_append_delete(db_file, id);
+    if (retval != ERR_NONE)
+        return retval;
 
     // Mise à jour du header
     db_file->header.num_files--;
     db_file->header.db_version++;
+    id_index_remove(db_file, i, db_file->header.db_version - 1);
+    sidecar_remove(db_file, i);
+
+    // Reset à zero de cette metadata, puis supression
+    memset(&db_file->metadata[i], 0, sizeof(struct pict_metadata));
+    meta_scan_update(db_file, i, db_file->header.db_version - 1);
+
+    retval = do_write_entry(db_file, i);
 
-    int retval = do_write(db_file, NULL);
+    return retval;
+}
+
+/********************************************************************/
+int do_delete(const char* id, struct pictdb_file* db_file)
+{
+    const uint64_t start = stats_now();
+    PROBE_DELETE_ENTRY(id);
+    int retval = delete_image(id, db_file);
+    stats_record(STAT_DELETE, start, retval);
+    PROBE_DELETE_RETURN(id, retval);
 
     return retval;
 }
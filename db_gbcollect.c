@@ -13,15 +13,28 @@
 
 #include "pictDB.h"
 #include "image_content.h"
+#include "image_cache.h"
+#include "buffer_pool.h"
+#include "stats.h"
 
-int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_name)
+/********************************************************************//**
+ * Copie des images valides dans une nouvelle base (cf. do_gbcollect)
+ */
+static int gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_name)
 {
-    int retval = ERR_NONE;
+    // Toutes les images sont recopiées
+    int retval = metadata_load_all(src);
+    if (retval != ERR_NONE)
+        return retval;
 
     struct pictdb_file tmp;
+    memset(&tmp, 0, sizeof(struct pictdb_file));
 
-    // Copie des valeurs de l'original dans la temporaire
-    tmp.header.max_files = src->header.max_files;
+    // Même disposition que l'original : sa table initiale (bornée par
+    // MAX_MAX_FILES), puis des pages au fil des insertions
+    tmp.header.max_files = (src->header.ext_offset != 0) ? src->ext.initial_files : src->header.max_files;
+    tmp.ext.page_size = src->ext.page_size;
+    tmp.ext.format_version = src->ext.format_version;
     for (int i = 0; i < 2 * (NB_RES - 1); i++)
         tmp.header.res_resized[i] = src->header.res_resized[i];
 
@@ -34,7 +47,6 @@ int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_
     uint32_t srci = 0, tmpi = 0, num_files = 0;
     while (srci < src->header.max_files && num_files < src->header.num_files) {
         struct pict_metadata* srcmeta = &src->metadata[srci];
-        struct pict_metadata* tmpmeta = &tmp.metadata[tmpi];
 
         // Pour chaque image valide (non supprimée)
         if (srcmeta->is_valid == NON_EMPTY) {
@@ -46,16 +58,19 @@ int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_
             if (retval != ERR_NONE)
                 goto error;
 
-            // Insertion dans la structure temporaire
-            retval = do_insert(image, image_size, srcmeta->pict_id, &tmp);
+            // Insertion dans la structure temporaire (le SHA est repris, même en attente)
+            retval = do_insert_hashed(image, image_size, srcmeta->pict_id, srcmeta->SHA, &tmp);
 
-            free(image);
+            buffer_release(image);
             image = NULL;
             image_size = 0;
 
             if (retval != ERR_NONE)
                 goto error;
 
+            // Pris après l'insertion, qui a pu ajouter une page à la table
+            const struct pict_metadata* tmpmeta = &tmp.metadata[tmpi];
+
             // Copie des petites images
             for (uint32_t res = RES_THUMB; res < RES_ORIG; res++) {
                 // Pas de petites images dans src
@@ -73,7 +88,7 @@ int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_
 
                 retval = store_image(&tmp, tmpi, res, image, image_size);
 
-                free(image);
+                buffer_release(image);
                 image = NULL;
                 image_size = 0;
 
@@ -90,20 +105,48 @@ int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_
 
     tmp.header.db_version = src->header.db_version + 1;
 
+    retval = do_write(&tmp, NULL);
+    do_close(&tmp);
+    if (retval != ERR_NONE)
+        goto remove_tmp;
+
+    // La nouvelle base doit se rouvrir avant de remplacer l'original
+    retval = do_open(tmp_name, "rb", &tmp);
+    if (retval != ERR_NONE)
+        goto remove_tmp;
+
+    if (tmp.header.num_files != num_files)
+        retval = ERR_CORRUPT;
+    do_close(&tmp);
+    if (retval != ERR_NONE)
+        goto remove_tmp;
 
-    // Remplacement du fichier d'origine par le nouveau fichier nettoyé
-    retval = remove(src_name);
-    if(retval != 0)
-        return ERR_IO;
+    // Remplacement atomique du fichier d'origine par le nouveau fichier nettoyé
+    if (rename(tmp_name, src_name) != 0) {
+        retval = ERR_IO;
+        goto remove_tmp;
+    }
 
-    retval = rename(tmp_name, src_name);
-    if(retval != 0)
-        return ERR_IO;
+    // Les positions des images ont changé
+    image_cache_invalidate(src->cache);
 
     return ERR_NONE;
 
 error:
     do_close(&tmp);
+remove_tmp:
+    // L'original reste intact
+    remove(tmp_name);
+
+    return retval;
+}
+
+/********************************************************************/
+int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_name)
+{
+    const uint64_t start = stats_now();
+    int retval = gbcollect(src, src_name, tmp_name);
+    stats_record(STAT_GBCOLLECT, start, retval);
 
     return retval;
 }
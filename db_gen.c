@@ -0,0 +1,341 @@
+/**
+ * @file db_gen.c
+ * @brief Implémentation de la commande do_gen (base synthétique)
+ *
+ * Les images sont écrites dans l'ordre, à la suite les unes des autres,
+ * directement dans le fichier : ni recherche de place libre, ni
+ * dé-duplication, ni écriture de metadata par image. Les duplicatas
+ * reprennent les positions d'une image déjà écrite, comme le ferait
+ * do_name_and_content_dedup, et les variantes de toutes les images sont
+ * celles de l'image de base (le redimensionnement ignore les octets ajoutés
+ * à la fin d'un JPEG). Les images effacées le sont à la fin, comme par
+ * do_delete : leurs données restent dans le fichier.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include "pictDB.h"
+#include "image_content.h"
+#include "needle.h"
+#include "crc32c.h"
+#include "dedup.h"
+
+#include <stdlib.h> // pour malloc
+#include <string.h> // pour memcpy, memset
+#include <inttypes.h> // pour PRIu32
+#include <math.h> // pour log
+#include <openssl/sha.h> // pour SHA256
+
+#define GEN_ID_FORMAT "pic%06" PRIu32
+#define GEN_MAX_SIZE (64 * 1024 * 1024) // taille max d'un original
+
+// Image de base : résolution et variantes, communes à toutes les images
+struct gen_seed {
+    const void* data;
+    size_t size;
+    uint32_t res_orig[2];
+    void* variant[RES_ORIG];
+    size_t variant_size[RES_ORIG];
+    uint32_t variant_crc[RES_ORIG];
+};
+
+/********************************************************************//**
+ * Générateur pseudo-aléatoire (xorshift64)
+ */
+static uint64_t gen_rand(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+/********************************************************************//**
+ * Tirage d'un événement de probabilité ratio %
+ */
+static int gen_chance(uint64_t* state, uint32_t ratio)
+{
+    return gen_rand(state) % 100 < ratio;
+}
+
+/********************************************************************//**
+ * Taille tirée d'un original, selon la loi choisie
+ */
+static uint32_t gen_size(uint64_t* state, const struct gen_params* params, size_t seed_size)
+{
+    const uint64_t mean = params->size;
+    uint64_t size = mean;
+
+    switch (params->size_dist) {
+    case GEN_SIZE_UNIFORM:
+        size = mean / 2 + gen_rand(state) % (mean + 1);
+        break;
+
+    case GEN_SIZE_EXP: {
+        const double u = (double)((gen_rand(state) >> 11) + 1) / (double)(UINT64_C(1) << 53);
+        size = (uint64_t)(-log(u) * (double)mean);
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    // Au moins l'image de base et le numéro de l'image
+    if (size < seed_size + sizeof(uint32_t))
+        size = seed_size + sizeof(uint32_t);
+
+    return (uint32_t)((size < GEN_MAX_SIZE) ? size : GEN_MAX_SIZE);
+}
+
+/********************************************************************//**
+ * Contenu de l'original numéro n (de taille size) : l'image de base, n,
+ * puis des octets dérivés de n ; buffer contient déjà l'image de base
+ */
+static void gen_content(char* buffer, size_t seed_size, uint32_t n, uint32_t size)
+{
+    uint64_t state = UINT64_C(0x9E3779B97F4A7C15) ^ ((uint64_t)n << 1) ^ 1;
+
+    memcpy(&buffer[seed_size], &n, sizeof(uint32_t));
+
+    for (size_t i = seed_size + sizeof(uint32_t); i < size; i++)
+        buffer[i] = (char)gen_rand(&state);
+}
+
+/********************************************************************//**
+ * Écrit une image à la position offset (la fin du fichier), précédée
+ * d'un needle si la base en utilise
+ */
+static int gen_write(struct pictdb_file* db_file, uint64_t* offset, uint32_t index, uint32_t res,
+                     const void* data, uint32_t size, uint32_t crc)
+{
+    struct pict_metadata *metadata = &db_file->metadata[index];
+
+    if (needle_enabled(db_file)) {
+        int retval = needle_write(db_file->fpdb, metadata->pict_id, res, 0, size, crc, 0);
+        if (retval != ERR_NONE)
+            return retval;
+
+        *offset += needle_size(metadata->pict_id);
+    }
+
+    if (fwrite(data, size, 1, db_file->fpdb) != 1)
+        return ERR_IO;
+
+    metadata->size[res] = size;
+    metadata->offset[res] = *offset;
+    set_image_crc(metadata, res, crc);
+
+    *offset += size;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Résolution et variantes de l'image de base
+ */
+static int gen_seed_init(const struct pictdb_file* db_file, struct gen_seed* seed)
+{
+    int retval = get_resolution(&seed->res_orig[1], &seed->res_orig[0], seed->data, seed->size);
+    if (retval != ERR_NONE)
+        return retval;
+
+    for (uint32_t res = 0; res < RES_ORIG; res++) {
+        retval = resize_image(db_file, res, seed->data, seed->size, &seed->variant[res], &seed->variant_size[res]);
+        if (retval != ERR_NONE)
+            return retval;
+
+        seed->variant_crc[res] = crc32c(0, seed->variant[res], seed->variant_size[res]);
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ajoute l'image numéro n à la position n
+ */
+static int gen_image(struct pictdb_file* db_file, uint64_t* offset, uint32_t n, char* buffer,
+                     const struct gen_seed* seed, const struct gen_params* params, uint64_t* state,
+                     uint32_t* originals, uint32_t* nb_originals, struct gen_report* report)
+{
+    struct pict_metadata *metadata = &db_file->metadata[n];
+    char pict_id[MAX_PIC_ID + 1];
+
+    snprintf(pict_id, sizeof(pict_id), GEN_ID_FORMAT, n);
+
+    metadata->pict_id = pict_id_intern(db_file, pict_id, strlen(pict_id));
+    if (metadata->pict_id == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    metadata->is_valid = NON_EMPTY;
+
+    // Duplicata d'un original déjà écrit : positions et empreintes partagées
+    if (*nb_originals > 0 && gen_chance(state, params->dup_ratio)) {
+        struct pict_metadata *source = &db_file->metadata[originals[gen_rand(state) % *nb_originals]];
+
+        // SHA de l'original, calculé au premier duplicata
+        if (sha_pending(source)) {
+            const uint32_t source_n = (uint32_t)(source - db_file->metadata);
+
+            gen_content(buffer, seed->size, source_n, source->size[RES_ORIG]);
+            SHA256((const unsigned char*)buffer, source->size[RES_ORIG], source->SHA);
+        }
+
+        memcpy(metadata->SHA, source->SHA, SHA256_DIGEST_LENGTH);
+        memcpy(metadata->res_orig, source->res_orig, sizeof(metadata->res_orig));
+        memcpy(metadata->size, source->size, sizeof(metadata->size));
+        memcpy(metadata->offset, source->offset, sizeof(metadata->offset));
+        metadata->crc_orig = source->crc_orig;
+        memcpy(metadata->crc_resized, source->crc_resized, sizeof(metadata->crc_resized));
+
+        // Needle de partage, comme pour un duplicata inséré
+        if (needle_enabled(db_file)) {
+            int retval = needle_write(db_file->fpdb, pict_id, RES_ORIG, NEEDLE_LINK, metadata->size[RES_ORIG],
+                                      metadata->crc_orig, metadata->offset[RES_ORIG]);
+            if (retval != ERR_NONE)
+                return retval;
+
+            *offset += needle_size(pict_id);
+        }
+
+        report->duplicates++;
+
+        return ERR_NONE;
+    }
+
+    // Nouvel original (le SHA n'est calculé qu'à la demande, cf. dedup.h)
+    const uint32_t size = gen_size(state, params, seed->size);
+    gen_content(buffer, seed->size, n, size);
+
+    memcpy(metadata->res_orig, seed->res_orig, sizeof(metadata->res_orig));
+
+    int retval = gen_write(db_file, offset, n, RES_ORIG, buffer, size, crc32c(0, buffer, size));
+    if (retval != ERR_NONE)
+        return retval;
+
+    report->bytes += size;
+    originals[(*nb_originals)++] = n;
+
+    if (gen_chance(state, params->variant_ratio)) {
+        for (uint32_t res = 0; res < RES_ORIG; res++) {
+            retval = gen_write(db_file, offset, n, res, seed->variant[res], (uint32_t)seed->variant_size[res],
+                               seed->variant_crc[res]);
+            if (retval != ERR_NONE)
+                return retval;
+
+            report->bytes += seed->variant_size[res];
+        }
+
+        report->variants++;
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int do_gen(const char* filename, struct pictdb_file* db_file, const void* seed_data, size_t seed_size,
+           const struct gen_params* params, struct gen_report* report)
+{
+    if (params->count == 0 || params->count > db_file->header.max_files)
+        return ERR_MAX_FILES;
+
+    if (params->dup_ratio > 100 || params->variant_ratio > 100 || params->deleted_ratio > 100
+        || seed_size + sizeof(uint32_t) > GEN_MAX_SIZE)
+        return ERR_INVALID_ARGUMENT;
+
+    memset(report, 0, sizeof(struct gen_report));
+
+    // Variables libérées en cas d'erreur
+    struct gen_seed seed;
+    memset(&seed, 0, sizeof(struct gen_seed));
+    seed.data = seed_data;
+    seed.size = seed_size;
+    uint32_t *originals = NULL;
+    char *buffer = NULL;
+
+    int retval = do_create(filename, db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    retval = gen_seed_init(db_file, &seed);
+    if (retval != ERR_NONE)
+        goto error;
+
+    originals = calloc(params->count, sizeof(uint32_t));
+    buffer = malloc(GEN_MAX_SIZE);
+    if (originals == NULL || buffer == NULL) {
+        retval = ERR_OUT_OF_MEMORY;
+        goto error;
+    }
+
+    memcpy(buffer, seed_data, seed_size);
+
+    // Les données suivent le header et les metadatas écrits par do_create
+    if (fseek(db_file->fpdb, 0, SEEK_END) != 0) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    const long end = ftell(db_file->fpdb);
+    if (end < 0) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    uint64_t offset = (uint64_t)end;
+    uint64_t state = params->seed * UINT64_C(0x9E3779B97F4A7C15) | 1;
+    uint32_t nb_originals = 0;
+
+    for (uint32_t n = 0; n < params->count; n++) {
+        retval = gen_image(db_file, &offset, n, buffer, &seed, params, &state, originals, &nb_originals, report);
+        if (retval != ERR_NONE)
+            goto error;
+    }
+
+    db_file->header.num_files = params->count;
+    db_file->header.db_version = params->count;
+
+    // Suppressions, tracées après les données comme par do_delete
+    for (uint32_t n = 0; n < params->count; n++) {
+        if (!gen_chance(&state, params->deleted_ratio))
+            continue;
+
+        retval = needle_append_delete(db_file, db_file->metadata[n].pict_id);
+        if (retval != ERR_NONE)
+            goto error;
+
+        memset(&db_file->metadata[n], 0, sizeof(struct pict_metadata));
+        db_file->header.num_files--;
+        db_file->header.db_version++;
+        report->deleted++;
+    }
+
+    report->pictures = db_file->header.num_files;
+
+    // Seule écriture des metadatas
+    retval = do_write(db_file, NULL);
+    if (retval != ERR_NONE)
+        goto error;
+
+    for (uint32_t res = 0; res < RES_ORIG; res++)
+        g_free(seed.variant[res]);
+
+    free(originals);
+    free(buffer);
+
+    return ERR_NONE;
+
+error:
+    for (uint32_t res = 0; res < RES_ORIG; res++)
+        g_free(seed.variant[res]);
+
+    free(originals);
+    free(buffer);
+    do_close(db_file);
+
+    return retval;
+}
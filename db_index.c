@@ -0,0 +1,238 @@
+/**
+ * @file db_index.c
+ * @brief Index des images trié par identifiant : recherche par dichotomie
+ *        et parcours ordonné pour les listes paginées.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdlib.h> // pour qsort, realloc
+#include <string.h> // pour strcmp, memmove
+
+#include "pictDB.h"
+#include "sidecar.h"
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/********************************************************************//**
+ * Comparaison de deux entrées de l'index (pour qsort)
+ */
+static int entry_cmp(const void* a, const void* b)
+{
+    return strcmp(((const struct id_index_entry*)a)->pict_id,
+                  ((const struct id_index_entry*)b)->pict_id);
+}
+
+/********************************************************************//**
+ * Indique si l'index est construit et correspond à la version de la base
+ */
+static int id_index_is_current(const struct pictdb_file* db_file)
+{
+    return db_file->ids.entries != NULL && db_file->ids.version == db_file->header.db_version;
+}
+
+/********************************************************************//**
+ * Position de la première entrée dont l'identifiant est >= pict_id
+ */
+static uint32_t lower_bound(const struct id_index* ids, const char* pict_id)
+{
+    uint32_t low = 0, high = ids->count;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (strcmp(ids->entries[middle].pict_id, pict_id) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+/********************************************************************/
+uint64_t pict_id_hash (const char* pict_id)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (const unsigned char *c = (const unsigned char*)pict_id; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/********************************************************************/
+void id_index_free (struct pictdb_file* db_file)
+{
+    free(db_file->ids.entries);
+    memset(&db_file->ids, 0, sizeof(struct id_index));
+}
+
+/********************************************************************/
+int id_index_build (struct pictdb_file* db_file)
+{
+    if (id_index_is_current(db_file))
+        return ERR_NONE;
+
+    int retval = metadata_load_all(db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    struct id_index *ids = &db_file->ids;
+    const struct pictdb_header *header = &db_file->header;
+
+    // Capacité pour la base pleine : les insertions n'ont pas à réallouer
+    if (ids->capacity < header->max_files || ids->entries == NULL) {
+        struct id_index_entry *entries = realloc(ids->entries, (header->max_files > 0 ? header->max_files : 1) * sizeof(struct id_index_entry));
+        if (entries == NULL) {
+            id_index_free(db_file);
+            return ERR_OUT_OF_MEMORY;
+        }
+
+        ids->entries = entries;
+        ids->capacity = header->max_files;
+    }
+
+    ids->count = 0;
+
+    uint32_t i = 0;
+    while (i < header->max_files && ids->count < header->num_files) {
+        if (db_file->metadata[i].is_valid == NON_EMPTY) {
+            ids->entries[ids->count].pict_id = db_file->metadata[i].pict_id;
+            ids->entries[ids->count].index = i;
+            ids->count++;
+        }
+
+        i++;
+    }
+
+    qsort(ids->entries, ids->count, sizeof(struct id_index_entry), entry_cmp);
+
+    ids->version = header->db_version;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int find_pict_id (struct pictdb_file* db_file, const char* pict_id, uint32_t* index)
+{
+    if (pict_id == NULL)
+        return ERR_INVALID_PICID;
+
+    // Recherche dans le fichier d'index à jour
+    if (sidecar_is_current(db_file))
+        return sidecar_find(db_file, pict_id, index);
+
+    // Recherche par dichotomie dans l'index à jour
+    if (id_index_is_current(db_file)) {
+        const struct id_index *ids = &db_file->ids;
+        uint32_t position = lower_bound(ids, pict_id);
+
+        if (position < ids->count && !strcmp(ids->entries[position].pict_id, pict_id)) {
+            *index = ids->entries[position].index;
+            return ERR_NONE;
+        }
+
+        return ERR_FILE_NOT_FOUND;
+    }
+
+    // Sinon, parcours des metadatas
+    int retval = metadata_load_all(db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    uint32_t i = 0, num_files = 0;
+    while (i < db_file->header.max_files && num_files < db_file->header.num_files) {
+        const struct pict_metadata *metadata = &db_file->metadata[i];
+
+        if (metadata->is_valid == NON_EMPTY) {
+            num_files++;
+
+            if (!strcmp(metadata->pict_id, pict_id)) {
+                *index = i;
+                return ERR_NONE;
+            }
+        }
+
+        i++;
+    }
+
+    return ERR_FILE_NOT_FOUND;
+}
+
+/********************************************************************/
+void id_index_add (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version)
+{
+    struct id_index *ids = &db_file->ids;
+
+    // Index pas construit ou déjà obsolète : il sera reconstruit
+    if (ids->entries == NULL || ids->version != previous_version)
+        return;
+
+    if (ids->count >= ids->capacity) {
+        id_index_free(db_file);
+        return;
+    }
+
+    const char *pict_id = db_file->metadata[index].pict_id;
+    uint32_t position = lower_bound(ids, pict_id);
+
+    memmove(&ids->entries[position + 1], &ids->entries[position],
+            (ids->count - position) * sizeof(struct id_index_entry));
+
+    ids->entries[position].pict_id = pict_id;
+    ids->entries[position].index = index;
+    ids->count++;
+
+    ids->version = db_file->header.db_version;
+}
+
+/********************************************************************/
+void id_index_remove (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version)
+{
+    struct id_index *ids = &db_file->ids;
+
+    if (ids->entries == NULL || ids->version != previous_version)
+        return;
+
+    uint32_t position = lower_bound(ids, db_file->metadata[index].pict_id);
+
+    if (position >= ids->count || ids->entries[position].index != index) {
+        // Index incohérent : on le reconstruira
+        id_index_free(db_file);
+        return;
+    }
+
+    memmove(&ids->entries[position], &ids->entries[position + 1],
+            (ids->count - position - 1) * sizeof(struct id_index_entry));
+    ids->count--;
+
+    ids->version = db_file->header.db_version;
+}
+
+/********************************************************************/
+uint32_t id_index_page_start (const struct pictdb_file* db_file, const struct list_query* query)
+{
+    const struct id_index *ids = &db_file->ids;
+    uint32_t start = 0;
+
+    if (query->prefix != NULL)
+        start = lower_bound(ids, query->prefix);
+
+    if (query->after != NULL) {
+        uint32_t after = lower_bound(ids, query->after);
+
+        // Le curseur lui-même est exclu
+        if (after < ids->count && !strcmp(ids->entries[after].pict_id, query->after))
+            after++;
+
+        if (after > start)
+            start = after;
+    }
+
+    return start;
+}
@@ -7,44 +7,92 @@
  */
 
 #include <stdlib.h> // pour calloc
-#include <string.h> // pour strlen()
-#include <openssl/sha.h> // pour SHA256_DIGEST_LENGTH and SHA256()
+#include <string.h> // pour strlen(), memcpy()
+#include <openssl/sha.h> // pour SHA256_DIGEST_LENGTH
 
 #include "pictDB.h"
 #include "image_content.h"
 #include "dedup.h"
+#include "needle.h"
+#include "crc32c.h"
+#include "stats.h"
+#include "probes.h"
 
-/********************************************************************/
-int do_insert(const char* img, size_t size, const char* pict_id, struct pictdb_file* db_file)
+#define STREAM_COPY_CHUNK 65536 // taille des blocs recopiés dans la base
+
+/********************************************************************//**
+ * Recherche d'une position libre dans l'index. Une base extensible pleine
+ * est agrandie d'une page : la première metadata de la page est libre.
+ */
+static int find_free_slot(struct pictdb_file* db_file, uint32_t* index)
 {
-    if (db_file->header.num_files >= db_file->header.max_files)
-        return ERR_FULL_DATABASE;
+    if (db_file->header.num_files >= db_file->header.max_files) {
+        uint32_t first = db_file->header.max_files;
 
-    uint32_t new_image_index = 0;
+        int retval = metadata_grow(db_file);
+        if (retval != ERR_NONE)
+            return retval;
 
-    // Recherche d'une position libre dans l'index
-    for (new_image_index = 0; new_image_index < db_file->header.max_files; ++new_image_index) {
-        if (db_file->metadata[new_image_index].is_valid == EMPTY)
-            break;
+        *index = first;
+        return ERR_NONE;
     }
 
-    // Pas nécessaire, mais sécurité supplémentaire
-    if (new_image_index >= db_file->header.max_files)
-        return ERR_FULL_DATABASE;
+    // Premier bit nul du bitmap des positions occupées
+    if (meta_scan_build(db_file) == ERR_NONE) {
+        *index = meta_scan_next(&db_file->scan, 0, 0);
+        return (*index < db_file->header.max_files) ? ERR_NONE : ERR_FULL_DATABASE;
+    }
+
+    for (uint32_t i = 0; i < db_file->header.max_files; ++i) {
+        if (db_file->metadata[i].is_valid == EMPTY) {
+            *index = i;
+            return ERR_NONE;
+        }
+    }
+
+    return ERR_FULL_DATABASE;
+}
+
+/********************************************************************//**
+ * Insertion d'une image en mémoire (cf. do_insert_hashed), chaque étape
+ * étant mesurée
+ */
+static int insert_image(const char* img, size_t size, const char* pict_id, const unsigned char* sha,
+                        struct pictdb_file* db_file)
+{
+    uint32_t new_image_index = 0;
+
+    uint64_t start = stats_now();
+    int retval = find_free_slot(db_file, &new_image_index);
+    stats_record(STAT_INSERT_PROBE, start, retval);
+    if (retval != ERR_NONE)
+        return retval;
 
     struct pict_metadata *metadata = &db_file->metadata[new_image_index];
 
-    // Initialisation des metadatas
-    SHA256((const unsigned char*)img, size, (unsigned char*)&metadata->SHA);
+    // Initialisation des metadatas : le SHA, s'il n'est pas fourni, n'est
+    // calculé que si la dé-duplication trouve une image de même empreinte
+    if (sha != NULL)
+        memcpy(metadata->SHA, sha, SHA256_DIGEST_LENGTH);
+
+    start = stats_now();
+    const uint32_t crc = crc32c(0, img, size);
+    set_image_crc(metadata, RES_ORIG, crc);
+    stats_record(STAT_INSERT_HASH, start, ERR_NONE);
+
+    const size_t length = strlen(pict_id);
 
-    strncpy(metadata->pict_id, pict_id, MAX_PIC_ID);
-    metadata->pict_id[MAX_PIC_ID] = '\0';
+    metadata->pict_id = pict_id_intern(db_file, pict_id, (length < MAX_PIC_ID) ? length : MAX_PIC_ID);
+    if (metadata->pict_id == NULL)
+        return ERR_OUT_OF_MEMORY;
 
     metadata->size[RES_ORIG] = (uint32_t)size;
     metadata->is_valid = NON_EMPTY;
 
     // De-duplication de l'image
-    int retval = do_name_and_content_dedup(db_file, new_image_index);
+    start = stats_now();
+    retval = do_name_and_content_dedup(db_file, new_image_index, img);
+    stats_record(STAT_INSERT_DEDUP, start, retval);
     if (retval != ERR_NONE)
         goto error;
 
@@ -54,18 +102,292 @@ int do_insert(const char* img, size_t size, const char* pict_id, struct pictdb_f
         goto error;
 
     db_file->header.num_files++;
+    db_file->header.db_version++;
+    list_cache_add(db_file, new_image_index, db_file->header.db_version - 1);
+    id_index_add(db_file, new_image_index, db_file->header.db_version - 1);
+    meta_scan_update(db_file, new_image_index, db_file->header.db_version - 1);
 
     // Ecriture de l'image sur le disque
-    if (metadata->offset[RES_ORIG] == 0)
+    if (metadata->offset[RES_ORIG] == 0) {
+        start = stats_now();
         retval = store_image(db_file, new_image_index, RES_ORIG, img, (uint32_t)size);
-    else
-        retval = do_write(db_file, NULL);
+        stats_record(STAT_INSERT_STORE, start, retval);
+
+        return retval;
+    }
+
+    // Duplicata : seul un needle désigne l'image partagée
+    if (needle_enabled(db_file)) {
+        if (fseek(db_file->fpdb, 0, SEEK_END) != 0)
+            return ERR_IO;
+
+        retval = needle_write(db_file->fpdb, metadata->pict_id, RES_ORIG, NEEDLE_LINK, (uint32_t)size,
+                              crc, metadata->offset[RES_ORIG]);
+        if (retval != ERR_NONE)
+            return retval;
+    }
+
+    start = stats_now();
+    retval = do_write_entry(db_file, new_image_index);
+    stats_record(STAT_INSERT_WRITE, start, retval);
+
+    return retval;
+
+error:
+    // Nettoyage des metadatas
+    memset(metadata, 0, sizeof(struct pict_metadata));
+    meta_scan_update(db_file, new_image_index, db_file->header.db_version);
+
+    return retval;
+}
+
+/********************************************************************/
+int do_insert(const char* img, size_t size, const char* pict_id, struct pictdb_file* db_file)
+{
+    return do_insert_hashed(img, size, pict_id, NULL, db_file);
+}
+
+/********************************************************************/
+int do_insert_hashed(const char* img, size_t size, const char* pict_id, const unsigned char* sha,
+                     struct pictdb_file* db_file)
+{
+    const uint64_t start = stats_now();
+    PROBE_INSERT_ENTRY(pict_id, size);
+    int retval = insert_image(img, size, pict_id, sha, db_file);
+    stats_record(STAT_INSERT, start, retval);
+    PROBE_INSERT_RETURN(pict_id, size, retval);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Recopie à la fin de la base l'image reçue dans le fichier temporaire,
+ * précédée d'un needle provisoire (taille et CRC nuls, ignoré par
+ * do_recover) complété une fois l'image acceptée
+ */
+static int stream_flush(struct insert_stream* stream, struct pictdb_file* db_file)
+{
+    char chunk[STREAM_COPY_CHUNK];
+    FILE *file = db_file->fpdb;
+
+    if (fseek(file, 0, SEEK_END) != 0)
+        return ERR_IO;
+
+    long offset = ftell(file);
+    if (offset == -1)
+        return ERR_IO;
+
+    stream->offset = (uint64_t)offset;
+
+    if (needle_enabled(db_file)) {
+        int retval = needle_write(file, stream->pict_id, RES_ORIG, 0, 0, 0, 0);
+        if (retval != ERR_NONE)
+            return retval;
+
+        stream->needle = needle_size(stream->pict_id);
+        stream->offset += stream->needle;
+    }
+
+    rewind(stream->staging);
+
+    for (uint64_t copied = 0; copied < stream->size; ) {
+        size_t len = (stream->size - copied < STREAM_COPY_CHUNK) ? (size_t)(stream->size - copied) : STREAM_COPY_CHUNK;
+
+        if (fread(chunk, len, 1, stream->staging) != 1)
+            return ERR_IO;
+
+        if (fwrite(chunk, len, 1, file) != 1)
+            return ERR_IO;
+
+        copied += len;
+    }
+
+    stats_add(STAT_BYTES_WRITTEN, stream->size);
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Libère le fichier temporaire d'une insertion en flux
+ */
+static void stream_release(struct insert_stream* stream)
+{
+    if (stream->staging != NULL)
+        fclose(stream->staging);
+
+    stream->staging = NULL;
+}
+
+/********************************************************************/
+int do_insert_begin(const char* pict_id, struct pictdb_file* db_file, struct insert_stream* stream)
+{
+    if (stream == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    // État vide : do_insert_abort reste possible après un échec
+    memset(stream, 0, sizeof(struct insert_stream));
+
+    if (pict_id == NULL || strlen(pict_id) == 0 || strlen(pict_id) > MAX_PIC_ID)
+        return ERR_INVALID_PICID;
+
+    if (db_file == NULL || db_file->fpdb == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    if (db_file->header.num_files >= db_file->header.max_files && db_file->ext.page_size == 0)
+        return ERR_FULL_DATABASE;
+
+    // Refus immédiat d'un identifiant déjà présent, avant de recevoir l'image
+    uint32_t existing = 0;
+    if (find_pict_id(db_file, pict_id, &existing) == ERR_NONE)
+        return ERR_DUPLICATE_ID;
+
+    // L'image est reçue dans un fichier temporaire, puis recopiée d'un seul
+    // tenant à la fin de la base par do_insert_end : les écritures des
+    // autres insertions ne s'intercalent pas dans l'image
+    stream->staging = tmpfile();
+    if (stream->staging == NULL)
+        return ERR_IO;
+
+    stream->db_file = db_file;
+
+    strncpy(stream->pict_id, pict_id, MAX_PIC_ID);
+    stream->pict_id[MAX_PIC_ID] = '\0';
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int do_insert_append(struct insert_stream* stream, const void* data, size_t len)
+{
+    if (stream == NULL || stream->db_file == NULL || (data == NULL && len > 0))
+        return ERR_INVALID_ARGUMENT;
+
+    if (len == 0)
+        return ERR_NONE;
+
+    // Les tailles d'images sont stockées sur 32 bits
+    if (stream->size + len > UINT32_MAX)
+        return ERR_INVALID_ARGUMENT;
+
+    if (fwrite(data, len, 1, stream->staging) != 1)
+        return ERR_IO;
+
+    stream->crc = crc32c(stream->crc, data, len);
+    stream->size += len;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Fin d'une insertion en flux (cf. do_insert_end), chaque étape étant
+ * mesurée
+ */
+static int insert_stream_end(struct insert_stream* stream)
+{
+    if (stream == NULL || stream->db_file == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    struct pictdb_file *db_file = stream->db_file;
+    stream->db_file = NULL;
+
+    if (stream->size == 0)
+        return ERR_INVALID_ARGUMENT;
+
+    uint32_t new_image_index = 0;
+
+    uint64_t start = stats_now();
+    int retval = find_free_slot(db_file, &new_image_index);
+    stats_record(STAT_INSERT_PROBE, start, retval);
+    if (retval != ERR_NONE)
+        return retval;
+
+    retval = stream_flush(stream, db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    struct pict_metadata *metadata = &db_file->metadata[new_image_index];
+
+    // Initialisation des metadatas : le SHA reste en attente, sauf si la
+    // dé-duplication trouve une image de même empreinte
+    metadata->pict_id = pict_id_intern(db_file, stream->pict_id, strlen(stream->pict_id));
+    if (metadata->pict_id == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    metadata->size[RES_ORIG] = (uint32_t)stream->size;
+    metadata->offset[RES_ORIG] = stream->offset;
+    metadata->is_valid = NON_EMPTY;
+    set_image_crc(metadata, RES_ORIG, stream->crc);
+
+    // De-duplication de l'image (le nom a pu être pris entre temps)
+    start = stats_now();
+    retval = do_name_and_content_dedup(db_file, new_image_index, NULL);
+    stats_record(STAT_INSERT_DEDUP, start, retval);
+    if (retval != ERR_NONE)
+        goto error;
+
+    // Image nouvelle : on référence les octets reçus
+    if (metadata->offset[RES_ORIG] == 0)
+        metadata->offset[RES_ORIG] = stream->offset;
+
+    // Résolution lue dans les en-têtes JPEG, sans charger l'image en mémoire
+    retval = get_resolution_from_file(&metadata->res_orig[1], &metadata->res_orig[0], db_file->fpdb,
+                                      metadata->offset[RES_ORIG], metadata->size[RES_ORIG]);
+    if (retval != ERR_NONE)
+        goto error;
+
+    // Image acceptée : le needle provisoire (de taille nulle, ignoré par
+    // do_recover) est complété avec la taille et le CRC de l'image reçue
+    if (stream->needle != 0) {
+        if (fseek(db_file->fpdb, (long)(stream->offset - stream->needle), SEEK_SET) != 0) {
+            retval = ERR_IO;
+            goto error;
+        }
+
+        retval = needle_write(db_file->fpdb, stream->pict_id, RES_ORIG, 0, (uint32_t)stream->size, stream->crc, 0);
+        if (retval != ERR_NONE)
+            goto error;
+    }
+
+    db_file->header.num_files++;
+    db_file->header.db_version++;
+    list_cache_add(db_file, new_image_index, db_file->header.db_version - 1);
+    id_index_add(db_file, new_image_index, db_file->header.db_version - 1);
+    meta_scan_update(db_file, new_image_index, db_file->header.db_version - 1);
+
+    start = stats_now();
+    retval = do_write_entry(db_file, new_image_index);
+    stats_record(STAT_INSERT_WRITE, start, retval);
 
     return retval;
 
 error:
     // Nettoyage des metadatas
     memset(metadata, 0, sizeof(struct pict_metadata));
+    meta_scan_update(db_file, new_image_index, db_file->header.db_version);
+
+    return retval;
+}
+
+/********************************************************************/
+int do_insert_end(struct insert_stream* stream)
+{
+    const uint64_t start = stats_now();
+    PROBE_INSERT_ENTRY(stream->pict_id, stream->size);
+    int retval = insert_stream_end(stream);
+    stream_release(stream);
+    stats_record(STAT_INSERT, start, retval);
+    PROBE_INSERT_RETURN(stream->pict_id, stream->size, retval);
 
     return retval;
 }
+
+/********************************************************************/
+void do_insert_abort(struct insert_stream* stream)
+{
+    if (stream == NULL)
+        return;
+
+    stream_release(stream);
+    stream->db_file = NULL;
+    stream->size = 0;
+}
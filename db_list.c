@@ -6,19 +6,29 @@
  * @date 9 Mar 2016
  */
 
+#include <stdlib.h> // pour realloc
 #include <string.h>
-#include <json-c/json.h>
+#include <stdio.h> // pour snprintf
+#include <inttypes.h> // pour PRIu32
 
 #include "pictDB.h"
 
+#define LIST_PREFIX "{ \"Pictures\": [ "
+#define LIST_SUFFIX " ] }"
+#define LIST_SEPARATOR ", "
+#define LIST_INITIAL_CAPACITY 256
+#define JSON_ESCAPE_MAX 6 // "\u00XX"
+#define LIST_FIELDS_MAX 128 // longueur maximale des champs optionnels d'une image
+
+static const char* const RES_NAMES[NB_RES] = { "thumb", "small", "orig" };
+
 /* Fonctions "privées" pour do_list */
 const char* do_list_stdout (const struct pictdb_file* db_file);
-const char* do_list_json (const struct pictdb_file* db_file);
 
 /********************************************************************//**
  * Affiche complet de la base de donnée
  */
-const char* do_list (const struct pictdb_file* db_file, enum do_list_mode mode)
+const char* do_list (struct pictdb_file* db_file, enum do_list_mode mode)
 {
     const char *response = NULL;
 
@@ -27,7 +37,7 @@ const char* do_list (const struct pictdb_file* db_file, enum do_list_mode mode)
         response = do_list_stdout(db_file);
         break;
     case JSON:
-        response = do_list_json(db_file);
+        response = do_list_json(db_file, NULL);
         break;
     default:
         response = "unimplemented do_list mode";
@@ -61,52 +71,345 @@ const char* do_list_stdout (const struct pictdb_file* db_file)
     return NULL;
 }
 
-const char* do_list_json (const struct pictdb_file* db_file)
+/********************************************************************//**
+ * Agrandit le buffer de la liste pour pouvoir y ajouter needed octets
+ */
+static int list_reserve (struct list_cache* list, size_t needed)
 {
-    const struct pictdb_header header = db_file->header;
+    if (list->length + needed + 1 <= list->capacity)
+        return ERR_NONE;
+
+    size_t capacity = (list->capacity > 0) ? list->capacity : LIST_INITIAL_CAPACITY;
+    while (list->length + needed + 1 > capacity)
+        capacity *= 2;
 
-    const char*  response = NULL;
-    json_object* json_response = json_object_new_object();
-    json_object* pictures = json_object_new_array();
+    char *json = realloc(list->json, capacity);
+    if (json == NULL)
+        return ERR_OUT_OF_MEMORY;
 
-    uint32_t i = 0, num_files = 0;
-    while (i < header.max_files && num_files < header.num_files) {
-        struct pict_metadata metadata = db_file->metadata[i];
+    list->json = json;
+    list->capacity = capacity;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ajoute la chaine str (de longueur len) à la fin de la liste
+ */
+static int list_append (struct list_cache* list, const char* str, size_t len)
+{
+    int retval = list_reserve(list, len);
+    if (retval != ERR_NONE)
+        return retval;
+
+    memcpy(&list->json[list->length], str, len);
+    list->length += len;
+    list->json[list->length] = '\0';
+
+    return ERR_NONE;
+}
 
-        if (metadata.is_valid == NON_EMPTY) {
-            json_object* pict_id = json_object_new_string(metadata.pict_id);
+/********************************************************************//**
+ * Ajoute une chaine JSON (échappée, entre guillemets) à la liste
+ */
+static int list_append_string (struct list_cache* list, const char* str)
+{
+    // Pire cas : chaque caractère échappé, plus les guillemets
+    int retval = list_reserve(list, 2 + JSON_ESCAPE_MAX * strlen(str));
+    if (retval != ERR_NONE)
+        return retval;
 
-            json_object_array_add(pictures, pict_id);
+    char *out = &list->json[list->length];
 
-            num_files++;
+    *out++ = '"';
+    for (const unsigned char *c = (const unsigned char*)str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            *out++ = '\\';
+            *out++ = (char)*c;
+        } else if (*c < 0x20) {
+            out += sprintf(out, "\\u%04x", *c);
+        } else {
+            *out++ = (char)*c;
+        }
+    }
+    *out++ = '"';
+    *out = '\0';
+
+    list->length = (size_t)(out - list->json);
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ajoute l'identifiant d'une image (chaine JSON échappée) à la liste
+ */
+static int list_append_id (struct list_cache* list, const char* pict_id)
+{
+    int retval = ERR_NONE;
+
+    if (list->count > 0)
+        retval = list_append(list, LIST_SEPARATOR, strlen(LIST_SEPARATOR));
+
+    if (retval == ERR_NONE)
+        retval = list_append_string(list, pict_id);
+
+    if (retval == ERR_NONE)
+        list->count++;
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Ajoute une image et ses champs optionnels (objet JSON) à la liste
+ */
+static int list_append_entry (struct list_cache* list, const struct pict_metadata* metadata, uint32_t fields)
+{
+    if (fields == 0)
+        return list_append_id(list, metadata->pict_id);
+
+    char buffer[LIST_FIELDS_MAX];
+    int retval = ERR_NONE;
+
+    if (list->count > 0)
+        retval = list_append(list, LIST_SEPARATOR, strlen(LIST_SEPARATOR));
+
+    if (retval == ERR_NONE)
+        retval = list_append(list, "{ \"pict_id\": ", strlen("{ \"pict_id\": "));
+
+    if (retval == ERR_NONE)
+        retval = list_append_string(list, metadata->pict_id);
+
+    if (retval == ERR_NONE && (fields & LIST_FIELD_SIZES)) {
+        int len = snprintf(buffer, sizeof(buffer), ", \"sizes\": { \"%s\": %" PRIu32 ", \"%s\": %" PRIu32 ", \"%s\": %" PRIu32 " }",
+                           RES_NAMES[RES_THUMB], metadata->size[RES_THUMB],
+                           RES_NAMES[RES_SMALL], metadata->size[RES_SMALL],
+                           RES_NAMES[RES_ORIG], metadata->size[RES_ORIG]);
+        retval = list_append(list, buffer, (size_t)len);
+    }
+
+    if (retval == ERR_NONE && (fields & LIST_FIELD_RESOLUTION)) {
+        int len = snprintf(buffer, sizeof(buffer), ", \"width\": %" PRIu32 ", \"height\": %" PRIu32,
+                           metadata->res_orig[0], metadata->res_orig[1]);
+        retval = list_append(list, buffer, (size_t)len);
+    }
+
+    if (retval == ERR_NONE && (fields & LIST_FIELD_VARIANTS)) {
+        int len = snprintf(buffer, sizeof(buffer), ", \"variants\": [");
+        uint32_t variants = 0;
+
+        for (uint32_t res = 0; res < NB_RES; res++) {
+            if (metadata->offset[res] != 0)
+                len += snprintf(&buffer[len], sizeof(buffer) - (size_t)len, "%s\"%s\"",
+                                (variants++ == 0) ? " " : ", ", RES_NAMES[res]);
+        }
+
+        len += snprintf(&buffer[len], sizeof(buffer) - (size_t)len, " ]");
+        retval = list_append(list, buffer, (size_t)len);
+    }
+
+    if (retval == ERR_NONE)
+        retval = list_append(list, " }", strlen(" }"));
+
+    if (retval == ERR_NONE)
+        list->count++;
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Reconstruit entièrement la liste JSON à partir des metadatas
+ */
+static int list_rebuild (struct pictdb_file* db_file)
+{
+    struct list_cache *list = &db_file->list;
+    const struct pictdb_header *header = &db_file->header;
+
+    list->length = 0;
+    list->count = 0;
+    list->end = 0;
+
+    int retval = list_append(list, LIST_PREFIX, strlen(LIST_PREFIX));
+
+    uint32_t i = 0;
+    while (retval == ERR_NONE && i < header->max_files && list->count < header->num_files) {
+        if (db_file->metadata[i].is_valid == NON_EMPTY) {
+            retval = list_append_id(list, db_file->metadata[i].pict_id);
+            list->end = i + 1;
         }
 
         i++;
     }
 
-    json_object_object_add(json_response, "Pictures", pictures);
+    if (retval == ERR_NONE)
+        retval = list_append(list, LIST_SUFFIX, strlen(LIST_SUFFIX));
 
-    const char *json_buffer = json_object_to_json_string(json_response);
-    if (json_buffer == NULL)
-        goto error;
+    if (retval != ERR_NONE) {
+        free(list->json);
+        memset(list, 0, sizeof(struct list_cache));
+        return retval;
+    }
 
-    size_t response_length = strlen(json_buffer);
-    response = calloc(response_length + 1, sizeof(char));
-    if (response == NULL)
-        goto error;
+    list->version = header->db_version;
 
-    strcpy((char*)response, json_buffer);
+    return ERR_NONE;
+}
 
-    json_object_put(json_response); // Free
+/********************************************************************/
+const char* do_list_json (struct pictdb_file* db_file, size_t* length)
+{
+    struct list_cache *list = &db_file->list;
 
-    return response;
+    // La liste n'est reconstruite que si la base a changé
+    if (list->json == NULL || list->version != db_file->header.db_version) {
+        if (list_rebuild(db_file) != ERR_NONE)
+            return NULL;
+    }
 
-error:
-    if (json_response != NULL)
-        json_object_put(json_response);
+    if (length != NULL)
+        *length = list->length;
 
-    if (response != NULL)
-        free((void*)response);
+    return list->json;
+}
 
-    return NULL;
+/********************************************************************/
+void list_cache_add (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version)
+{
+    struct list_cache *list = &db_file->list;
+
+    // Liste pas encore construite ou déjà obsolète : rien à mettre à jour.
+    // Une image placée dans une position libérée avant la fin de la liste
+    // n'y serait pas à sa place : la liste reste obsolète
+    if (list->json == NULL || list->version != previous_version || index < list->end)
+        return;
+
+    // On retire la fin du document, ajoute l'image, puis remet la fin
+    list->length -= strlen(LIST_SUFFIX);
+
+    int retval = list_append_id(list, db_file->metadata[index].pict_id);
+    if (retval == ERR_NONE)
+        retval = list_append(list, LIST_SUFFIX, strlen(LIST_SUFFIX));
+
+    if (retval != ERR_NONE) {
+        // Reconstruite lors de la prochaine lecture
+        free(list->json);
+        memset(list, 0, sizeof(struct list_cache));
+        return;
+    }
+
+    list->end = index + 1;
+    list->version = db_file->header.db_version;
+}
+
+/********************************************************************/
+const char* do_list_page (struct pictdb_file* db_file, enum do_list_mode mode, const struct list_query* query)
+{
+    return do_list_page_multi(&db_file, 1, mode, query);
+}
+
+/********************************************************************//**
+ * Base dont la prochaine image (à la position cursors[i] de son index)
+ * a le plus petit identifiant, ou count si toutes les bases sont parcourues
+ */
+static uint32_t next_file (struct pictdb_file* const* db_files, uint32_t count, const uint32_t* cursors)
+{
+    uint32_t best = count;
+    const char *best_id = NULL;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (cursors[i] >= db_files[i]->ids.count)
+            continue;
+
+        const char *pict_id = db_files[i]->ids.entries[cursors[i]].pict_id;
+        if (best_id == NULL || strcmp(pict_id, best_id) < 0) {
+            best = i;
+            best_id = pict_id;
+        }
+    }
+
+    return best;
+}
+
+/********************************************************************/
+const char* do_list_page_multi (struct pictdb_file* const* db_files, uint32_t count, enum do_list_mode mode, const struct list_query* query)
+{
+    if (db_files == NULL || count == 0 || query == NULL)
+        return NULL;
+
+    // Position courante dans l'index trié de chaque base
+    uint32_t *cursors = calloc(count, sizeof(uint32_t));
+    if (cursors == NULL)
+        return NULL;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (id_index_build(db_files[i]) != ERR_NONE) {
+            free(cursors);
+            return NULL;
+        }
+
+        cursors[i] = id_index_page_start(db_files[i], query);
+    }
+
+    size_t prefix_length = (query->prefix != NULL) ? strlen(query->prefix) : 0;
+    const char *last = NULL, *next = NULL;
+
+    struct list_cache page;
+    memset(&page, 0, sizeof(struct list_cache));
+
+    int retval = ERR_NONE;
+    if (mode == JSON)
+        retval = list_append(&page, LIST_PREFIX, strlen(LIST_PREFIX));
+
+    // Fusion des index triés à partir du curseur
+    uint32_t file = 0;
+    while (retval == ERR_NONE && (file = next_file(db_files, count, cursors)) < count) {
+        const struct pictdb_file *db_file = db_files[file];
+        const struct pict_metadata *metadata = &db_file->metadata[db_file->ids.entries[cursors[file]++].index];
+
+        // Les identifiants étant triés, plus aucune image n'a le préfixe
+        if (prefix_length > 0 && strncmp(metadata->pict_id, query->prefix, prefix_length) != 0)
+            break;
+
+        // Page pleine alors qu'il reste des images : on retourne le curseur
+        if (query->limit > 0 && page.count == query->limit) {
+            next = last;
+            break;
+        }
+
+        last = metadata->pict_id;
+
+        if (mode == JSON) {
+            retval = list_append_entry(&page, metadata, query->fields);
+        } else {
+            print_metadata(metadata);
+            page.count++;
+        }
+    }
+
+    free(cursors);
+
+    if (mode != JSON) {
+        if (next != NULL)
+            printf("NEXT: %s\n", next);
+
+        return NULL;
+    }
+
+    if (retval == ERR_NONE)
+        retval = list_append(&page, " ]", strlen(" ]"));
+
+    if (retval == ERR_NONE && next != NULL) {
+        retval = list_append(&page, ", \"next\": ", strlen(", \"next\": "));
+        if (retval == ERR_NONE)
+            retval = list_append_string(&page, next);
+    }
+
+    if (retval == ERR_NONE)
+        retval = list_append(&page, " }", strlen(" }"));
+
+    if (retval != ERR_NONE) {
+        free(page.json);
+        return NULL;
+    }
+
+    return page.json;
 }
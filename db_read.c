@@ -5,32 +5,30 @@
  * @author Dominique Roduit, Thierry Treyer
  * @date 2 Mai 2015
  */
-#include <string.h> // for strcmp()
-
 #include "pictDB.h"
 #include "image_content.h"
+#include "stats.h"
+#include "trace.h"
+#include "probes.h"
 
 /********************************************************************/
-int do_read(const char* pict_id, uint32_t res, char** image_buffer, uint32_t* image_size, struct pictdb_file* db_file)
+int do_read_prepare(const char* pict_id, uint32_t res, uint32_t* index, struct pictdb_file* db_file)
 {
-
     if (pict_id == NULL)
         return ERR_INVALID_PICID;
 
+    if (res >= NB_RES)
+        return ERR_RESOLUTIONS;
+
     uint32_t image_index = 0;
 
     // On cherche l'entrée qui nous intéresse
-    for (image_index = 0; image_index < db_file->header.max_files; ++image_index) {
-        if (db_file->metadata[image_index].is_valid == EMPTY)
-            continue;
-
-        if (!strcmp(db_file->metadata[image_index].pict_id, pict_id))
-            break;
-    }
-
-    // Si l'identifiant demandé n'a pas pu être trouvé
-    if (image_index >= db_file->header.max_files)
-        return ERR_FILE_NOT_FOUND;
+    uint64_t start = stats_now();
+    int ret = find_pict_id(db_file, pict_id, &image_index);
+    stats_record(STAT_READ_LOOKUP, start, ret);
+    trace_end("lookup", start, "%s", pict_id);
+    if (ret != ERR_NONE)
+        return ret;
 
     struct pict_metadata *metadata = &db_file->metadata[image_index];
 
@@ -39,18 +37,40 @@ int do_read(const char* pict_id, uint32_t res, char** image_buffer, uint32_t* im
         return ERR_FILE_NOT_FOUND;
 
     // Si l'image n'existe pas dans la résolution demandée on la créé
-    int ret = ERR_NONE;
     if (metadata->offset[res] == 0) {
+        start = stats_now();
+        stats_gauge_add(STAT_RESIZE_PENDING, 1);
         ret = lazily_resize(db_file, image_index, res);
+        stats_gauge_add(STAT_RESIZE_PENDING, -1);
+        stats_record(STAT_READ_RESIZE, start, ret);
         if (ret != ERR_NONE)
             return ret;
     }
 
-    ret = fetch_image(db_file, image_index, res, (void**)image_buffer);
-    if (ret != ERR_NONE)
-        return ret;
+    *index = image_index;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int do_read(const char* pict_id, uint32_t res, char** image_buffer, uint32_t* image_size, struct pictdb_file* db_file)
+{
+    uint32_t image_index = 0;
+    const uint64_t start = stats_now();
+    PROBE_READ_ENTRY(pict_id, res);
+
+    int ret = do_read_prepare(pict_id, res, &image_index, db_file);
+    if (ret == ERR_NONE) {
+        const uint64_t fetch_start = stats_now();
+        ret = fetch_image(db_file, image_index, res, (void**)image_buffer);
+        stats_record(STAT_READ_FETCH, fetch_start, ret);
+    }
+
+    if (ret == ERR_NONE)
+        *image_size = db_file->metadata[image_index].size[res];
 
-    *image_size = metadata->size[res];
+    stats_record(STAT_READ, start, ret);
+    PROBE_READ_RETURN(pict_id, res, (ret == ERR_NONE) ? *image_size : 0, ret);
 
     return ret;
 }
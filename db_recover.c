@@ -0,0 +1,384 @@
+/**
+ * @file db_recover.c
+ * @brief Reconstruction des metadatas d'une base à partir de ses needles
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdlib.h> // pour calloc, malloc, free
+#include <string.h> // pour memset, memcmp, strcmp
+#include <openssl/sha.h> // pour SHA256
+
+#include "pictDB.h"
+#include "needle.h"
+#include "crc32c.h"
+#include "image_content.h"
+
+#define RECOVER_CHUNK 65536 // taille des blocs lus pour rechercher un needle
+#define SLOT_EMPTY 0
+#define SLOT_DELETED UINT32_MAX
+
+// Index pict_id -> metadata des images déjà retrouvées (adressage ouvert)
+struct recover_map {
+    // Position de la metadata + 1, SLOT_EMPTY ou SLOT_DELETED
+    uint32_t* slots;
+    uint32_t capacity;
+    uint32_t filled;
+    // Metadatas libérées par des suppressions, à réutiliser
+    uint32_t* free;
+    uint32_t free_count;
+    uint32_t free_capacity;
+    // Première metadata jamais utilisée
+    uint32_t next;
+};
+
+/********************************************************************//**
+ * Recherche de la case de pict_id : sa case si l'image est connue (*found
+ * vaut alors 1), sinon la case où l'ajouter
+ */
+static uint32_t map_lookup(const struct recover_map* map, const struct pictdb_file* db_file,
+                           const char* pict_id, int* found)
+{
+    const uint32_t mask = map->capacity - 1;
+    uint32_t i = (uint32_t)pict_id_hash(pict_id) & mask;
+    uint32_t target = map->capacity;
+
+    for (; map->slots[i] != SLOT_EMPTY; i = (i + 1) & mask) {
+        if (map->slots[i] == SLOT_DELETED) {
+            if (target == map->capacity)
+                target = i;
+        } else if (!strcmp(db_file->metadata[map->slots[i] - 1].pict_id, pict_id)) {
+            *found = 1;
+            return i;
+        }
+    }
+
+    *found = 0;
+
+    return (target == map->capacity) ? i : target;
+}
+
+/********************************************************************//**
+ * Double la capacité de l'index (sans les cases supprimées)
+ */
+static int map_grow(struct recover_map* map, const struct pictdb_file* db_file)
+{
+    struct recover_map grown = *map;
+    grown.capacity = map->capacity * 2;
+    grown.filled = 0;
+    grown.slots = calloc(grown.capacity, sizeof(uint32_t));
+    if (grown.slots == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    for (uint32_t i = 0; i < map->capacity; i++) {
+        if (map->slots[i] == SLOT_EMPTY || map->slots[i] == SLOT_DELETED)
+            continue;
+
+        int found = 0;
+        uint32_t slot = map_lookup(&grown, db_file, db_file->metadata[map->slots[i] - 1].pict_id, &found);
+        grown.slots[slot] = map->slots[i];
+        grown.filled++;
+    }
+
+    free(map->slots);
+    *map = grown;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Metadata libre pour une nouvelle image (la base est agrandie au besoin)
+ */
+static int map_take(struct recover_map* map, struct pictdb_file* db_file, uint32_t* index)
+{
+    if (map->free_count > 0) {
+        *index = map->free[--map->free_count];
+        return ERR_NONE;
+    }
+
+    if (map->next >= db_file->header.max_files) {
+        int retval = metadata_grow(db_file);
+        if (retval != ERR_NONE)
+            return retval;
+    }
+
+    *index = map->next++;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Rend une metadata libre (image supprimée)
+ */
+static int map_release(struct recover_map* map, uint32_t index)
+{
+    if (map->free_count == map->free_capacity) {
+        uint32_t capacity = (map->free_capacity > 0) ? 2 * map->free_capacity : 64;
+
+        uint32_t *free_slots = realloc(map->free, capacity * sizeof(uint32_t));
+        if (free_slots == NULL)
+            return ERR_OUT_OF_MEMORY;
+
+        map->free = free_slots;
+        map->free_capacity = capacity;
+    }
+
+    map->free[map->free_count++] = index;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Position du prochain NEEDLE_MAGIC à partir de offset (end si aucun)
+ */
+static uint64_t next_magic(FILE* file, uint64_t offset, uint64_t end)
+{
+    static const uint32_t magic = NEEDLE_MAGIC;
+    char chunk[RECOVER_CHUNK];
+
+    while (offset + sizeof(uint32_t) <= end) {
+        size_t len = (end - offset < RECOVER_CHUNK) ? (size_t)(end - offset) : RECOVER_CHUNK;
+
+        if (fseek(file, (long)offset, SEEK_SET) != 0 || fread(chunk, len, 1, file) != 1)
+            return end;
+
+        for (size_t i = 0; i + sizeof(uint32_t) <= len; i++) {
+            if (!memcmp(&chunk[i], &magic, sizeof(uint32_t)))
+                return offset + i;
+        }
+
+        // La marque peut chevaucher deux blocs
+        offset += len - (sizeof(uint32_t) - 1);
+    }
+
+    return end;
+}
+
+/********************************************************************//**
+ * Lit les size octets à la position offset et vérifie leur CRC
+ */
+static int read_checked(FILE* file, uint64_t offset, uint32_t size, uint32_t crc, void** data)
+{
+    *data = malloc(size);
+    if (*data == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    if (fseek(file, (long)offset, SEEK_SET) != 0 || fread(*data, size, 1, file) != 1
+        || crc32c(0, *data, size) != crc) {
+        free(*data);
+        *data = NULL;
+        return ERR_IO;
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Applique un needle valide aux metadatas reconstruites. Un needle dont
+ * les données sont endommagées est ignoré (retourne ERR_IO).
+ */
+static int apply_needle(struct recover_map* map, struct pictdb_file* db_file, const struct pict_needle* needle,
+                        const char* pict_id, uint64_t data_offset, uint64_t end)
+{
+    int found = 0;
+    uint32_t slot = map_lookup(map, db_file, pict_id, &found);
+
+    // Suppression de l'image
+    if (needle->flags & NEEDLE_DELETE) {
+        if (!found)
+            return ERR_NONE;
+
+        uint32_t index = map->slots[slot] - 1;
+        memset(&db_file->metadata[index], 0, sizeof(struct pict_metadata));
+        map->slots[slot] = SLOT_DELETED;
+        db_file->header.num_files--;
+
+        return map_release(map, index);
+    }
+
+    // Petite image d'une image connue
+    if (needle->res != RES_ORIG) {
+        if (!found || needle->size == 0)
+            return ERR_NONE;
+
+        void *data = NULL;
+        int retval = read_checked(db_file->fpdb, data_offset, needle->size, needle->crc, &data);
+        free(data);
+        if (retval != ERR_NONE)
+            return retval;
+
+        struct pict_metadata *metadata = &db_file->metadata[map->slots[slot] - 1];
+        metadata->size[needle->res] = needle->size;
+        metadata->offset[needle->res] = data_offset;
+        set_image_crc(metadata, needle->res, needle->crc);
+
+        return ERR_NONE;
+    }
+
+    // Image originale, stockée ici ou partagée (NEEDLE_LINK)
+    const uint64_t offset = (needle->flags & NEEDLE_LINK) ? needle->link : data_offset;
+    if (needle->size == 0 || offset + needle->size > end)
+        return ERR_IO;
+
+    void *data = NULL;
+    int retval = read_checked(db_file->fpdb, offset, needle->size, needle->crc, &data);
+    if (retval != ERR_NONE)
+        return retval;
+
+    uint32_t index = 0;
+    if (found) {
+        // Image remplacée (p.ex. supprimée sans que la suppression soit écrite)
+        index = map->slots[slot] - 1;
+        db_file->header.num_files--;
+    } else {
+        retval = map_take(map, db_file, &index);
+        if (retval != ERR_NONE) {
+            free(data);
+            return retval;
+        }
+
+        map->slots[slot] = index + 1;
+        map->filled++;
+    }
+
+    struct pict_metadata *metadata = &db_file->metadata[index];
+    memset(metadata, 0, sizeof(struct pict_metadata));
+
+    metadata->pict_id = pict_id_intern(db_file, pict_id, strlen(pict_id));
+    if (metadata->pict_id == NULL) {
+        free(data);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    SHA256((const unsigned char*)data, needle->size, metadata->SHA);
+    metadata->size[RES_ORIG] = needle->size;
+    metadata->offset[RES_ORIG] = offset;
+    metadata->is_valid = NON_EMPTY;
+    set_image_crc(metadata, RES_ORIG, needle->crc);
+
+    // Résolution laissée à 0 x 0 si l'image ne peut pas être décodée
+    (void)get_resolution(&metadata->res_orig[1], &metadata->res_orig[0], data, needle->size);
+    free(data);
+
+    db_file->header.num_files++;
+
+    // Index gardé rempli à moitié au plus
+    if (map->filled * 2 > map->capacity)
+        return map_grow(map, db_file);
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int do_recover(const char* filename, struct pictdb_file* db_file)
+{
+    if (filename == NULL || db_file == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    int retval = ERR_NONE;
+    struct recover_map map;
+    memset(&map, 0, sizeof(struct recover_map));
+
+    memset(db_file, 0, sizeof(struct pictdb_file));
+
+    db_file->fpdb = fopen(filename, "r+b");
+    if (db_file->fpdb == NULL)
+        return ERR_IO;
+
+    FILE *file = db_file->fpdb;
+
+    // Header et extension (qui doivent être intacts)
+    if (fread(&db_file->header, sizeof(struct pictdb_header), 1, file) != 1) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    if (db_file->header.ext_offset == 0 || fseek(file, (long)db_file->header.ext_offset, SEEK_SET) != 0
+        || fread(&db_file->ext, sizeof(struct pictdb_header_ext), 1, file) != 1) {
+        retval = ERR_INVALID_ARGUMENT;
+        goto error;
+    }
+
+    if (!needle_enabled(db_file) || db_file->ext.format_version > PICTDB_FORMAT_VERSION
+        || db_file->ext.initial_files == 0 || db_file->ext.initial_files > MAX_MAX_FILES
+        || db_file->header.ext_offset != sizeof(struct pictdb_header) + db_file->ext.initial_files * sizeof(struct pict_metadata_disk)) {
+        retval = ERR_INVALID_ARGUMENT;
+        goto error;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    long size = ftell(file);
+    if (size == -1) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    const uint64_t end = (uint64_t)size;
+
+    // Les pages existantes sont abandonnées : seule la table initiale reste
+    db_file->header.max_files = db_file->ext.initial_files;
+    db_file->header.num_files = 0;
+    db_file->ext.nb_pages = 0;
+    db_file->ext.first_page = 0;
+    db_file->ext.last_page = 0;
+
+    db_file->metadata = calloc(db_file->header.max_files, sizeof(struct pict_metadata));
+    map.capacity = 64;
+    map.slots = calloc(map.capacity, sizeof(uint32_t));
+    if (db_file->metadata == NULL || map.slots == NULL) {
+        retval = ERR_OUT_OF_MEMORY;
+        goto error;
+    }
+
+    // Parcours séquentiel de la zone de données ; ce qui n'est pas un needle
+    // valide (anciennes pages, données endommagées) est sauté jusqu'au
+    // prochain needle
+    uint64_t offset = db_file->header.ext_offset + sizeof(struct pictdb_header_ext);
+
+    while (offset < end) {
+        struct pict_needle needle;
+        char pict_id[MAX_PIC_ID + 1];
+
+        if (needle_read(file, offset, end, &needle, pict_id) != ERR_NONE) {
+            offset = next_magic(file, offset + 1, end);
+            continue;
+        }
+
+        const uint64_t data_offset = offset + sizeof(struct pict_needle) + needle.id_length;
+
+        retval = apply_needle(&map, db_file, &needle, pict_id, data_offset, end);
+        if (retval == ERR_OUT_OF_MEMORY || retval == ERR_FULL_DATABASE)
+            goto error;
+
+        if (retval != ERR_NONE) {
+            offset = next_magic(file, offset + 1, end);
+            continue;
+        }
+
+        offset = data_offset + ((needle.flags == 0) ? needle.size : 0);
+    }
+
+    // Écriture des metadatas reconstruites ; les index dérivés sont obsolètes
+    db_file->header.db_version++;
+
+    retval = do_write(db_file, NULL);
+    if (retval != ERR_NONE)
+        goto error;
+
+    free(map.slots);
+    free(map.free);
+
+    return ERR_NONE;
+
+error:
+    free(map.slots);
+    free(map.free);
+    do_close(db_file);
+
+    return retval;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file db_scan.c
+ * @brief Représentation compacte des metadatas pour les parcours complets
+ *        (dé-duplication, recherche d'une position libre, recherche d'un
+ *        identifiant sans index).
+ *
+ * Une metadata occupe 216 octets, dont 128 pour l'identifiant, alors que
+ * ces parcours n'en lisent que quelques champs. Chaque champ utile a donc
+ * son propre tableau (validité sous forme de bitmap, hash de
+ * l'identifiant, taille et CRC de l'original, début du SHA) : un parcours
+ * lit une vingtaine d'octets par position au lieu de quatre lignes de cache.
+ * Le format sur le disque ne change pas.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdlib.h> // pour malloc, free
+#include <string.h> // pour memset, memcpy
+
+#include "pictDB.h"
+
+#define SCAN_WORD_BITS 64
+
+/********************************************************************//**
+ * Nombre de mots du bitmap pour count positions
+ */
+static size_t scan_words(uint32_t count)
+{
+    return ((size_t)count + SCAN_WORD_BITS - 1) / SCAN_WORD_BITS;
+}
+
+/********************************************************************//**
+ * Copie les champs utiles d'une metadata dans la représentation compacte
+ */
+static void scan_set(struct meta_scan* scan, const struct pict_metadata* metadata, uint32_t index)
+{
+    const uint64_t bit = UINT64_C(1) << (index % SCAN_WORD_BITS);
+
+    if (metadata->is_valid == NON_EMPTY) {
+        scan->valid[index / SCAN_WORD_BITS] |= bit;
+        scan->id_hash[index] = pict_id_hash(metadata->pict_id);
+        memcpy(&scan->sha_prefix[index], metadata->SHA, sizeof(uint64_t));
+        scan->size[index] = metadata->size[RES_ORIG];
+        scan->crc[index] = metadata->crc_orig;
+    } else {
+        scan->valid[index / SCAN_WORD_BITS] &= ~bit;
+    }
+}
+
+/********************************************************************//**
+ * Indique si la représentation compacte correspond à la base
+ */
+static int meta_scan_is_current(const struct pictdb_file* db_file)
+{
+    const struct meta_scan *scan = &db_file->scan;
+
+    return scan->valid != NULL && scan->version == db_file->header.db_version
+           && scan->count == db_file->header.max_files;
+}
+
+/********************************************************************/
+void meta_scan_free (struct pictdb_file* db_file)
+{
+    // Un seul bloc alloué, qui commence par le bitmap
+    free(db_file->scan.valid);
+    memset(&db_file->scan, 0, sizeof(struct meta_scan));
+}
+
+/********************************************************************/
+int meta_scan_build (struct pictdb_file* db_file)
+{
+    if (meta_scan_is_current(db_file))
+        return ERR_NONE;
+
+    int retval = metadata_load_all(db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    const uint32_t count = db_file->header.max_files;
+    const size_t words = scan_words(count);
+    struct meta_scan *scan = &db_file->scan;
+
+    if (scan->valid == NULL || scan->count != count) {
+        meta_scan_free(db_file);
+
+        // Tableaux de 64 bits d'abord, pour l'alignement
+        uint64_t *block = malloc(words * sizeof(uint64_t)
+                                 + (size_t)count * (2 * sizeof(uint64_t) + 2 * sizeof(uint32_t)) + 1);
+        if (block == NULL)
+            return ERR_OUT_OF_MEMORY;
+
+        scan->valid = block;
+        scan->id_hash = &block[words];
+        scan->sha_prefix = &scan->id_hash[count];
+        scan->size = (uint32_t*)&scan->sha_prefix[count];
+        scan->crc = &scan->size[count];
+        scan->count = count;
+    }
+
+    memset(scan->valid, 0, words * sizeof(uint64_t));
+
+    // Parcours complet : une image en cours d'insertion est déjà valide mais
+    // pas encore comptée dans header.num_files
+    for (uint32_t i = 0; i < count; i++) {
+        if (db_file->metadata[i].is_valid == NON_EMPTY)
+            scan_set(scan, &db_file->metadata[i], i);
+    }
+
+    scan->version = db_file->header.db_version;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+void meta_scan_update (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version)
+{
+    struct meta_scan *scan = &db_file->scan;
+
+    // Pas construite ou déjà obsolète : elle sera reconstruite
+    if (scan->valid == NULL || scan->version != previous_version)
+        return;
+
+    if (index >= scan->count || scan->count != db_file->header.max_files) {
+        meta_scan_free(db_file);
+        return;
+    }
+
+    scan_set(scan, &db_file->metadata[index], index);
+    scan->version = db_file->header.db_version;
+}
+
+/********************************************************************/
+uint32_t meta_scan_next (const struct meta_scan* scan, uint32_t from, int valid)
+{
+    // Positions libres : on cherche les bits nuls
+    const uint64_t flip = valid ? 0 : UINT64_MAX;
+    size_t word = from / SCAN_WORD_BITS;
+    const size_t words = scan_words(scan->count);
+
+    if (from >= scan->count)
+        return scan->count;
+
+    // Bits du premier mot avant from ignorés
+    uint64_t bits = (scan->valid[word] ^ flip) & (UINT64_MAX << (from % SCAN_WORD_BITS));
+
+    while (bits == 0) {
+        if (++word >= words)
+            return scan->count;
+
+        bits = scan->valid[word] ^ flip;
+    }
+
+    const uint32_t index = (uint32_t)(word * SCAN_WORD_BITS) + (uint32_t)__builtin_ctzll(bits);
+
+    // Bits de fin du dernier mot, au-delà de count
+    return (index < scan->count) ? index : scan->count;
+}
@@ -7,14 +7,22 @@
  */
 
 #include "pictDB.h"
+#include "image_cache.h"
+#include "sidecar.h"
+#include "dedup.h"
+#include "stats.h"
+#include "trace.h"
 
 #include <stdint.h> // pour uint8_t
 #include <stdio.h> // pour sprintf
 #include <stdlib.h> // pour calloc
-#include <string.h> // pour strcmp
+#include <string.h> // pour strcmp, memchr, memcpy
 #include <inttypes.h> // pour PRI...
 #include <openssl/sha.h> // pour SHA256_DIGEST_LENGTH
 
+#define METADATA_IO_BATCH 256 // metadatas converties par lecture ou écriture
+#define METADATA_BLOCK 256 // metadatas lues ensemble par une base ouverte à la demande
+
 /********************************************************************//**
  * SHA lisible par un humain
  */
@@ -58,7 +66,7 @@ print_metadata (const struct pict_metadata* metadata)
     sha_to_string(metadata->SHA, sha_printable);
 
     printf("PICTURE ID: %s\n", metadata->pict_id);
-    printf("SHA: %s\n", sha_printable);
+    printf("SHA: %s\n", sha_pending(metadata) ? "(pending)" : sha_printable);
     printf("VALID: %" PRIu16 "\n", metadata->is_valid);
     printf("UNUSED: %" PRIu16 "\n", metadata->unused_16);
     printf("OFFSET ORIG. : %" PRIu64 "\t\tSIZE ORIG. : %" PRIu32 "\n", metadata->offset[RES_ORIG], metadata->size[RES_ORIG]);
@@ -68,14 +76,286 @@ print_metadata (const struct pict_metadata* metadata)
     printf("*****************************************\n");
 }
 
+/********************************************************************//**
+ * Position dans le fichier de la metadata index
+ */
+static long metadata_position(const struct pictdb_file* db_file, uint32_t index)
+{
+    const struct pictdb_header_ext *ext = &db_file->ext;
+
+    // Table initiale (toute la table pour une base de taille fixe)
+    if (db_file->header.ext_offset == 0 || index < ext->initial_files)
+        return (long)(sizeof(struct pictdb_header) + index * sizeof(struct pict_metadata_disk));
+
+    uint32_t page = (index - ext->initial_files) / ext->page_size;
+    uint32_t entry = (index - ext->initial_files) % ext->page_size;
+
+    return (long)(db_file->pages[page] + sizeof(struct pict_metadata_page) + entry * sizeof(struct pict_metadata_disk));
+}
+
+/********************************************************************//**
+ * Conversion d'une metadata en mémoire vers son format dans le fichier
+ */
+static void metadata_to_disk(const struct pict_metadata* metadata, struct pict_metadata_disk* disk)
+{
+    memset(disk, 0, sizeof(struct pict_metadata_disk));
+
+    if (metadata->pict_id != NULL)
+        strncpy(disk->pict_id, metadata->pict_id, MAX_PIC_ID);
+
+    memcpy(disk->SHA, metadata->SHA, SHA256_DIGEST_LENGTH);
+    memcpy(disk->res_orig, metadata->res_orig, sizeof(disk->res_orig));
+    memcpy(disk->size, metadata->size, sizeof(disk->size));
+    disk->crc_orig = metadata->crc_orig;
+    memcpy(disk->offset, metadata->offset, sizeof(disk->offset));
+    disk->is_valid = metadata->is_valid;
+    disk->unused_16 = metadata->unused_16;
+    memcpy(disk->crc_resized, metadata->crc_resized, sizeof(disk->crc_resized));
+}
+
+/********************************************************************//**
+ * Conversion d'une metadata lue dans le fichier ; l'identifiant est copié
+ * dans la zone des identifiants de la base
+ */
+static int metadata_from_disk(struct pictdb_file* db_file, const struct pict_metadata_disk* disk,
+                              struct pict_metadata* metadata)
+{
+    metadata->pict_id = NULL;
+
+    if (disk->is_valid != EMPTY) {
+        const char *end = memchr(disk->pict_id, '\0', MAX_PIC_ID + 1);
+        const size_t length = (end != NULL) ? (size_t)(end - disk->pict_id) : MAX_PIC_ID + 1;
+
+        metadata->pict_id = pict_id_intern(db_file, disk->pict_id, length);
+        if (metadata->pict_id == NULL)
+            return ERR_OUT_OF_MEMORY;
+    }
+
+    memcpy(metadata->SHA, disk->SHA, SHA256_DIGEST_LENGTH);
+    memcpy(metadata->res_orig, disk->res_orig, sizeof(metadata->res_orig));
+    memcpy(metadata->size, disk->size, sizeof(metadata->size));
+    metadata->crc_orig = disk->crc_orig;
+    memcpy(metadata->offset, disk->offset, sizeof(metadata->offset));
+    metadata->is_valid = disk->is_valid;
+    metadata->unused_16 = disk->unused_16;
+    memcpy(metadata->crc_resized, disk->crc_resized, sizeof(metadata->crc_resized));
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Lecture de count metadatas consécutives dans le fichier, à partir de la
+ * position courante, par lots de METADATA_IO_BATCH
+ */
+static int read_metadata(struct pictdb_file* db_file, uint32_t first, uint32_t count)
+{
+    struct pict_metadata_disk *batch = malloc(METADATA_IO_BATCH * sizeof(struct pict_metadata_disk));
+    if (batch == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    int err = ERR_NONE;
+
+    for (uint32_t done = 0; err == ERR_NONE && done < count; ) {
+        const uint32_t n = (count - done < METADATA_IO_BATCH) ? count - done : METADATA_IO_BATCH;
+
+        if (fread(batch, sizeof(struct pict_metadata_disk), n, db_file->fpdb) != n) {
+            err = ERR_IO;
+            break;
+        }
+
+        for (uint32_t i = 0; err == ERR_NONE && i < n; i++)
+            err = metadata_from_disk(db_file, &batch[i], &db_file->metadata[first + done + i]);
+
+        done += n;
+    }
+
+    free(batch);
+
+    return err;
+}
+
+/********************************************************************//**
+ * Écriture de count metadatas consécutives dans le fichier, à partir de la
+ * position courante
+ */
+static int write_metadata(const struct pictdb_file* db_file, uint32_t first, uint32_t count)
+{
+    struct pict_metadata_disk *batch = malloc(METADATA_IO_BATCH * sizeof(struct pict_metadata_disk));
+    if (batch == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    int err = ERR_NONE;
+
+    for (uint32_t done = 0; done < count; ) {
+        const uint32_t n = (count - done < METADATA_IO_BATCH) ? count - done : METADATA_IO_BATCH;
+
+        for (uint32_t i = 0; i < n; i++)
+            metadata_to_disk(&db_file->metadata[first + done + i], &batch[i]);
+
+        if (fwrite(batch, sizeof(struct pict_metadata_disk), n, db_file->fpdb) != n) {
+            err = ERR_IO;
+            break;
+        }
+
+        done += n;
+    }
+
+    free(batch);
+
+    return err;
+}
+
+/********************************************************************//**
+ * Lecture des metadatas first à first + count - 1, qui peuvent s'étendre
+ * sur la table initiale et plusieurs pages
+ */
+static int load_range(struct pictdb_file* db_file, uint32_t first, uint32_t count)
+{
+    const struct pictdb_header_ext *ext = &db_file->ext;
+    const uint32_t initial_files = (db_file->header.ext_offset != 0) ? ext->initial_files : db_file->header.max_files;
+
+    while (count > 0) {
+        // Metadatas contiguës dans le fichier : jusqu'à la fin de la table
+        // initiale ou de la page
+        uint32_t contiguous = (first < initial_files) ? initial_files - first
+                              : ext->page_size - (first - initial_files) % ext->page_size;
+        uint32_t n = (count < contiguous) ? count : contiguous;
+
+        if (fseek(db_file->fpdb, metadata_position(db_file, first), SEEK_SET) != 0)
+            return ERR_IO;
+
+        int err = read_metadata(db_file, first, n);
+        if (err != ERR_NONE)
+            return err;
+
+        first += n;
+        count -= n;
+    }
+
+    return ERR_NONE;
+}
+
 /********************************************************************/
-int do_open(const char* db_filename, const char* mode, struct pictdb_file* db_file)
+int metadata_load(struct pictdb_file* db_file, uint32_t index)
+{
+    if (db_file->loaded == NULL)
+        return ERR_NONE;
+
+    if (index >= db_file->header.max_files)
+        return ERR_INVALID_ARGUMENT;
+
+    const uint32_t block = index / METADATA_BLOCK;
+    if (db_file->loaded[block])
+        return ERR_NONE;
+
+    const uint32_t first = block * METADATA_BLOCK;
+    const uint32_t left = db_file->header.max_files - first;
+
+    int err = load_range(db_file, first, (left < METADATA_BLOCK) ? left : METADATA_BLOCK);
+    if (err != ERR_NONE)
+        return err;
+
+    db_file->loaded[block] = 1;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int metadata_load_all(struct pictdb_file* db_file)
+{
+    if (db_file->loaded == NULL)
+        return ERR_NONE;
+
+    for (uint32_t index = 0; index < db_file->header.max_files; index += METADATA_BLOCK) {
+        int err = metadata_load(db_file, index);
+        if (err != ERR_NONE)
+            return err;
+    }
+
+    free(db_file->loaded);
+    db_file->loaded = NULL;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Lecture de l'extension du header et de la chaîne des pages
+ */
+static int read_pages(struct pictdb_file* db_file)
+{
+    struct pictdb_header_ext *ext = &db_file->ext;
+    FILE *file = db_file->fpdb;
+
+    if (fseek(file, (long)db_file->header.ext_offset, SEEK_SET) != 0)
+        return ERR_IO;
+
+    if (fread(ext, sizeof(struct pictdb_header_ext), 1, file) != 1)
+        return ERR_IO;
+
+    if (ext->format_version < PICTDB_FORMAT_PAGES || ext->format_version > PICTDB_FORMAT_VERSION)
+        return ERR_INVALID_ARGUMENT;
+
+    // Taille de page nulle : base de taille fixe (sans pages)
+    if (ext->page_size > MAX_MAX_FILES || (ext->page_size == 0 && ext->nb_pages != 0))
+        return ERR_MAX_FILES;
+
+    // Seules les pages permettent de dépasser MAX_MAX_FILES (cf. do_recover)
+    if (ext->initial_files > MAX_MAX_FILES)
+        return ERR_MAX_FILES;
+
+    // Le nombre de metadatas doit correspondre à la table et aux pages
+    if ((uint64_t)ext->initial_files + (uint64_t)ext->nb_pages * ext->page_size != db_file->header.max_files)
+        return ERR_MAX_FILES;
+
+    if (ext->nb_pages == 0)
+        return ERR_NONE;
+
+    db_file->pages = calloc(ext->nb_pages, sizeof(uint64_t));
+    if (db_file->pages == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    uint64_t offset = ext->first_page;
+    for (uint32_t i = 0; i < ext->nb_pages; i++) {
+        struct pict_metadata_page page;
+
+        if (offset == 0 || fseek(file, (long)offset, SEEK_SET) != 0)
+            return ERR_IO;
+
+        if (fread(&page, sizeof(struct pict_metadata_page), 1, file) != 1)
+            return ERR_IO;
+
+        if (page.count != ext->page_size)
+            return ERR_IO;
+
+        db_file->pages[i] = offset;
+        offset = page.next;
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ouverture d'une base ; les metadatas ne sont lues que si lazy est nul
+ */
+static int open_db(const char* db_filename, const char* mode, struct pictdb_file* db_file, int lazy)
 {
     size_t retval = 0;
     enum error_codes err = ERR_NONE;
 
     db_file->fpdb = NULL;
     db_file->metadata = NULL;
+    db_file->loaded = NULL;
+    db_file->id_blocks = NULL;
+    db_file->pages = NULL;
+    db_file->cache = NULL;
+    memset(&db_file->ext, 0, sizeof(struct pictdb_header_ext));
+    memset(&db_file->list, 0, sizeof(struct list_cache));
+    memset(&db_file->ids, 0, sizeof(struct id_index));
+    memset(&db_file->scan, 0, sizeof(struct meta_scan));
+    db_file->sidecar = NULL;
+    db_file->verify_crc = 0;
+    db_file->live_bytes = 0;
+    db_file->live_version = 0;
 
     db_file->fpdb = fopen(db_filename, mode);
     if (db_file->fpdb == NULL) {
@@ -90,8 +370,19 @@ int do_open(const char* db_filename, const char* mode, struct pictdb_file* db_fi
         goto error;
     }
 
-    if(db_file->header.max_files >= MAX_MAX_FILES)
+    // Une base de taille fixe reste bornée par MAX_MAX_FILES
+    if (db_file->header.max_files > MAX_TOTAL_FILES
+        || (db_file->header.ext_offset == 0 && db_file->header.max_files > MAX_MAX_FILES)) {
+        err = ERR_MAX_FILES;
         goto error;
+    }
+
+    // Base extensible : lecture de l'extension et de la chaîne des pages
+    if (db_file->header.ext_offset != 0) {
+        err = read_pages(db_file);
+        if (err != ERR_NONE)
+            goto error;
+    }
 
     // Allocation et lecture des métadonnées
     db_file->metadata = calloc(db_file->header.max_files, sizeof(struct pict_metadata));
@@ -100,12 +391,21 @@ int do_open(const char* db_filename, const char* mode, struct pictdb_file* db_fi
         goto error;
     }
 
-    retval = fread(db_file->metadata, sizeof(struct pict_metadata), db_file->header.max_files, db_file->fpdb);
-    if (retval != db_file->header.max_files) {
-        err = ERR_IO;
-        goto error;
+    // Ouverture à la demande : aucun bloc n'est encore lu
+    if (lazy) {
+        db_file->loaded = calloc(db_file->header.max_files / METADATA_BLOCK + 1, sizeof(uint8_t));
+        if (db_file->loaded == NULL) {
+            err = ERR_OUT_OF_MEMORY;
+            goto error;
+        }
+
+        return ERR_NONE;
     }
 
+    err = load_range(db_file, 0, db_file->header.max_files);
+    if (err != ERR_NONE)
+        goto error;
+
     return ERR_NONE;
 
 error:
@@ -114,6 +414,26 @@ error:
     return err;
 }
 
+/********************************************************************/
+int do_open(const char* db_filename, const char* mode, struct pictdb_file* db_file)
+{
+    const uint64_t start = stats_now();
+    int err = open_db(db_filename, mode, db_file, 0);
+    stats_record(STAT_OPEN, start, err);
+
+    return err;
+}
+
+/********************************************************************/
+int do_open_lazy(const char* db_filename, const char* mode, struct pictdb_file* db_file)
+{
+    const uint64_t start = stats_now();
+    int err = open_db(db_filename, mode, db_file, 1);
+    stats_record(STAT_OPEN, start, err);
+
+    return err;
+}
+
 /********************************************************************/
 void do_close(struct pictdb_file* db_file)
 {
@@ -127,35 +447,270 @@ void do_close(struct pictdb_file* db_file)
         free(db_file->metadata);
 
     db_file->metadata = NULL;
+    pict_id_arena_free(db_file);
+
+    free(db_file->loaded);
+    db_file->loaded = NULL;
+
+    free(db_file->pages);
+    db_file->pages = NULL;
+
+    image_cache_free(db_file->cache);
+    db_file->cache = NULL;
+
+    free(db_file->list.json);
+    memset(&db_file->list, 0, sizeof(struct list_cache));
+
+    id_index_free(db_file);
+    meta_scan_free(db_file);
+
+    sidecar_close(db_file->sidecar);
+    db_file->sidecar = NULL;
+}
+
+/********************************************************************//**
+ * Écriture du header (et de son extension pour une base extensible)
+ */
+static int write_header(const struct pictdb_file* db_file)
+{
+    if (db_file->header.ext_offset != 0) {
+        if (fseek(db_file->fpdb, (long)db_file->header.ext_offset, SEEK_SET) != 0)
+            return ERR_IO;
+
+        if (fwrite(&db_file->ext, sizeof(struct pictdb_header_ext), 1, db_file->fpdb) != 1)
+            return ERR_IO;
+    }
+
+    if (fseek(db_file->fpdb, 0, SEEK_SET) != 0)
+        return ERR_IO;
+
+    if (fwrite(&db_file->header, sizeof(struct pictdb_header), 1, db_file->fpdb) != 1)
+        return ERR_IO;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Écriture du header et de toutes les metadatas (cf. do_write)
+ */
+static int write_db(const struct pictdb_file* db_file, size_t *items_written)
+{
+    if (db_file->fpdb == NULL)
+        return ERR_IO;
+
+    // Les metadatas pas encore lues seraient effacées
+    if (db_file->loaded != NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    // Ecriture du header
+    int err = write_header(db_file);
+    if (err != ERR_NONE)
+        return err;
+
+    if (items_written != NULL)
+        *items_written += 1;
+
+    // Ecriture des metadatas : table initiale puis chaque page
+    uint32_t initial_files = (db_file->header.ext_offset != 0) ? db_file->ext.initial_files : db_file->header.max_files;
+
+    for (uint32_t i = 0; i <= db_file->ext.nb_pages; i++) {
+        uint32_t first = (i == 0) ? 0 : initial_files + (i - 1) * db_file->ext.page_size;
+        uint32_t count = (i == 0) ? initial_files : db_file->ext.page_size;
+
+        if (fseek(db_file->fpdb, metadata_position(db_file, first), SEEK_SET) != 0)
+            return ERR_IO;
+
+        err = write_metadata(db_file, first, count);
+        if (err != ERR_NONE)
+            return err;
+
+        if (items_written != NULL)
+            *items_written += count;
+    }
+
+    return ERR_NONE;
 }
 
 /********************************************************************/
 int do_write(const struct pictdb_file* db_file, size_t *items_written)
+{
+    const uint64_t start = stats_now();
+    int err = write_db(db_file, items_written);
+    stats_record(STAT_WRITE, start, err);
+    trace_end("do_write", start, NULL);
+
+    return err;
+}
+
+/********************************************************************/
+int do_write_entry(const struct pictdb_file* db_file, uint32_t index)
 {
     if (db_file->fpdb == NULL)
         return ERR_IO;
 
-    size_t retval = 0;
+    if (index >= db_file->header.max_files)
+        return ERR_INVALID_ARGUMENT;
+
+    int err = write_header(db_file);
+    if (err != ERR_NONE)
+        return err;
 
-    retval = (size_t)fseek(db_file->fpdb, 0, SEEK_SET);
-    if (retval != 0)
+    if (fseek(db_file->fpdb, metadata_position(db_file, index), SEEK_SET) != 0)
         return ERR_IO;
 
-    // Ecriture du header
-    retval = fwrite(&db_file->header , sizeof(struct pictdb_header), 1, db_file->fpdb);
-    if (retval != 1)
+    struct pict_metadata_disk disk;
+    metadata_to_disk(&db_file->metadata[index], &disk);
+
+    if (fwrite(&disk, sizeof(struct pict_metadata_disk), 1, db_file->fpdb) != 1)
         return ERR_IO;
 
-    if (items_written != NULL)
-        *items_written += retval;
+    // Report de la modification dans le fichier d'index
+    sidecar_sync(db_file, index);
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int metadata_grow(struct pictdb_file* db_file)
+{
+    struct pictdb_header_ext *ext = &db_file->ext;
+    const uint32_t max_files = db_file->header.max_files;
 
-    // Ecriture des metadatas
-    retval = fwrite(db_file->metadata, sizeof(struct pict_metadata), db_file->header.max_files, db_file->fpdb);
-    if (retval != db_file->header.max_files)
+    if (db_file->fpdb == NULL)
         return ERR_IO;
 
-    if (items_written != NULL)
-        *items_written += retval;
+    if (db_file->header.ext_offset == 0 || ext->page_size == 0)
+        return ERR_FULL_DATABASE;
+
+    if (max_files > MAX_TOTAL_FILES - ext->page_size)
+        return ERR_FULL_DATABASE;
+
+    int err = metadata_load_all(db_file);
+    if (err != ERR_NONE)
+        return err;
+
+    // Agrandissement des metadatas en mémoire
+    struct pict_metadata *metadata = realloc(db_file->metadata, (max_files + ext->page_size) * sizeof(struct pict_metadata));
+    if (metadata == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    db_file->metadata = metadata;
+    memset(&metadata[max_files], 0, ext->page_size * sizeof(struct pict_metadata));
+
+    // Les entrées de l'index pointent dans l'ancien tableau
+    id_index_free(db_file);
+
+    uint64_t *pages = realloc(db_file->pages, (ext->nb_pages + 1) * sizeof(uint64_t));
+    if (pages == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    db_file->pages = pages;
+
+    // Écriture de la nouvelle page (vide) à la fin du fichier
+    if (fseek(db_file->fpdb, 0, SEEK_END) != 0)
+        return ERR_IO;
+
+    long offset = ftell(db_file->fpdb);
+    if (offset == -1)
+        return ERR_IO;
+
+    struct pict_metadata_page page;
+    memset(&page, 0, sizeof(struct pict_metadata_page));
+    page.count = ext->page_size;
+
+    if (fwrite(&page, sizeof(struct pict_metadata_page), 1, db_file->fpdb) != 1)
+        return ERR_IO;
+
+    err = write_metadata(db_file, max_files, ext->page_size);
+    if (err != ERR_NONE)
+        return err;
+
+    // Chaînage à la page précédente, puis mise à jour du header
+    if (ext->nb_pages > 0) {
+        uint64_t next = (uint64_t)offset;
+
+        if (fseek(db_file->fpdb, (long)ext->last_page, SEEK_SET) != 0)
+            return ERR_IO;
+
+        if (fwrite(&next, sizeof(uint64_t), 1, db_file->fpdb) != 1)
+            return ERR_IO;
+    } else {
+        ext->first_page = (uint64_t)offset;
+    }
+
+    ext->last_page = (uint64_t)offset;
+    pages[ext->nb_pages++] = (uint64_t)offset;
+    db_file->header.max_files += ext->page_size;
+
+    return write_header(db_file);
+}
+
+// Image stockée : position et taille dans le fichier
+struct image_extent {
+    uint64_t offset;
+    uint32_t size;
+};
+
+/********************************************************************//**
+ * Comparaison de deux images par position, pour qsort
+ */
+static int extent_cmp(const void* a, const void* b)
+{
+    const struct image_extent *first = a, *second = b;
+
+    return (first->offset > second->offset) - (first->offset < second->offset);
+}
+
+/********************************************************************/
+int do_live_bytes(struct pictdb_file* db_file, uint64_t* live)
+{
+    if (db_file->live_bytes != 0 && db_file->live_version == db_file->header.db_version) {
+        *live = db_file->live_bytes;
+        return ERR_NONE;
+    }
+
+    int err = metadata_load_all(db_file);
+    if (err != ERR_NONE)
+        return err;
+
+    struct image_extent *extents = calloc((size_t)db_file->header.num_files * NB_RES + 1, sizeof(struct image_extent));
+    if (extents == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    // Images de toutes les entrées valides, triées par position : les images
+    // partagées (dé-duplication) se suivent
+    size_t count = 0;
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < db_file->header.max_files && valid < db_file->header.num_files; i++) {
+        const struct pict_metadata *metadata = &db_file->metadata[i];
+
+        if (metadata->is_valid != NON_EMPTY)
+            continue;
+
+        valid++;
+
+        for (uint32_t res = 0; res < NB_RES; res++) {
+            if (metadata->offset[res] != 0 && metadata->size[res] != 0) {
+                extents[count].offset = metadata->offset[res];
+                extents[count].size = metadata->size[res];
+                count++;
+            }
+        }
+    }
+
+    qsort(extents, count, sizeof(struct image_extent), extent_cmp);
+
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || extents[i].offset != extents[i - 1].offset)
+            bytes += extents[i].size;
+    }
+
+    free(extents);
+
+    db_file->live_bytes = bytes;
+    db_file->live_version = db_file->header.db_version;
+    *live = bytes;
 
     return ERR_NONE;
 }
@@ -209,6 +764,7 @@ const char* create_name(const char* pict_id, uint32_t res)
 int read_disk_image(const char *filename, void **image, size_t *image_size)
 {
     int ret = ERR_NONE;
+    *image = NULL;
 
     FILE* file = fopen(filename, "rb");
     if (file == NULL) {
@@ -261,6 +817,8 @@ error:
     if (*image != NULL)
         free(*image);
 
+    *image = NULL;
+
     return ret;
 }
 
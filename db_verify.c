@@ -0,0 +1,533 @@
+/**
+ * @file db_verify.c
+ * @brief Vérification complète (fsck) d'une base : header, metadatas,
+ * positions des images et contenu de la zone de données
+ *
+ * Les contrôles du header et des metadatas sont faits en mémoire. Les
+ * blocs de données sont ensuite triés par position, ce qui permet de
+ * détecter les chevauchements, puis relus en parallèle : chaque thread
+ * reçoit une tranche contiguë (en octets) des blocs triés et la lit dans
+ * l'ordre du fichier, pour un accès séquentiel au disque.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour pread, sysconf
+
+#include <stdlib.h> // pour calloc, realloc, free, qsort
+#include <string.h> // pour memchr, memcmp, strcmp
+#include <stdarg.h> // pour va_list
+#include <inttypes.h> // pour PRIu32
+#include <pthread.h> // pour pthread_create, pthread_mutex_t
+#include <unistd.h> // pour pread, sysconf
+#include <openssl/sha.h> // pour SHA256
+
+#include "pictDB.h"
+#include "image_content.h"
+#include "dedup.h"
+
+#define VERIFY_MAX_THREADS 64
+#define VERIFY_HEADER UINT32_MAX // bloc réservé au header, à son extension ou à une page
+
+// Bloc de la zone de données (ou bloc réservé) occupé dans le fichier
+struct verify_extent {
+    uint64_t offset;
+    uint64_t size;
+    // Position de la metadata propriétaire, ou VERIFY_HEADER
+    uint32_t index;
+    uint32_t res;
+};
+
+// État partagé par les threads de vérification
+struct verify_state {
+    const struct pictdb_file* db_file;
+    int fd;
+    // Blocs à relire, triés par position
+    const struct verify_extent* jobs;
+    // Protège problems et l'affichage
+    pthread_mutex_t lock;
+    uint32_t problems;
+};
+
+// Tranche de blocs relue par un thread
+struct verify_worker {
+    pthread_t thread;
+    struct verify_state* state;
+    size_t first;
+    size_t last;
+    uint64_t bytes;
+};
+
+/********************************************************************//**
+ * Signale un problème, sur le header (index VERIFY_HEADER) ou une image
+ */
+static void verify_problem(struct verify_state* state, uint32_t index, uint32_t res, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+    pthread_mutex_lock(&state->lock);
+
+    if (index == VERIFY_HEADER) {
+        printf("VERIFY: header: ");
+    } else {
+        const char *pict_id = state->db_file->metadata[index].pict_id;
+
+        printf("VERIFY: picture %s (entry %" PRIu32 ", resolution %" PRIu32 "): ",
+               (pict_id != NULL) ? pict_id : "", index, res);
+    }
+
+    vprintf(format, args);
+    printf("\n");
+
+    state->problems++;
+
+    pthread_mutex_unlock(&state->lock);
+
+    va_end(args);
+}
+
+/********************************************************************//**
+ * Tri des blocs par position, puis par taille (blocs réservés d'abord)
+ */
+static int extent_compare(const void* a, const void* b)
+{
+    const struct verify_extent *x = a, *y = b;
+
+    if (x->offset != y->offset)
+        return (x->offset < y->offset) ? -1 : 1;
+
+    if (x->size != y->size)
+        return (x->size < y->size) ? -1 : 1;
+
+    if (x->index != y->index)
+        return (x->index == VERIFY_HEADER) ? -1 : (y->index == VERIFY_HEADER) ? 1 : 0;
+
+    return 0;
+}
+
+/********************************************************************//**
+ * Tri des identifiants (recherche des doublons)
+ */
+static int id_compare(const void* a, const void* b)
+{
+    return strcmp(((const struct id_index_entry*)a)->pict_id,
+                  ((const struct id_index_entry*)b)->pict_id);
+}
+
+/********************************************************************//**
+ * Invariants du header et de son extension
+ */
+static void verify_header(struct verify_state* state, uint64_t file_size)
+{
+    const struct pictdb_file *db_file = state->db_file;
+    const struct pictdb_header *header = &db_file->header;
+
+    if (memchr(header->db_name, '\0', MAX_DB_NAME + 1) == NULL)
+        verify_problem(state, VERIFY_HEADER, 0, "database name is not terminated");
+
+    if (header->num_files > header->max_files)
+        verify_problem(state, VERIFY_HEADER, 0, "%" PRIu32 " picture(s) for %" PRIu32 " entries",
+                       header->num_files, header->max_files);
+
+    if (header->res_resized[0] == 0 || header->res_resized[0] > MAX_THUMB_RES
+        || header->res_resized[1] == 0 || header->res_resized[1] > MAX_THUMB_RES
+        || header->res_resized[2] == 0 || header->res_resized[2] > MAX_SMALL_RES
+        || header->res_resized[3] == 0 || header->res_resized[3] > MAX_SMALL_RES)
+        verify_problem(state, VERIFY_HEADER, 0, "%s", ERROR_MESSAGES[ERR_RESOLUTIONS]);
+
+    if (header->ext_offset != 0 && header->ext_offset + sizeof(struct pictdb_header_ext) > file_size)
+        verify_problem(state, VERIFY_HEADER, 0, "header extension past the end of the file");
+
+    for (uint32_t i = 0; i < db_file->ext.nb_pages; i++) {
+        const uint64_t end = db_file->pages[i] + sizeof(struct pict_metadata_page)
+                             + (uint64_t)db_file->ext.page_size * sizeof(struct pict_metadata_disk);
+
+        if (end > file_size)
+            verify_problem(state, VERIFY_HEADER, 0, "metadata page %" PRIu32 " past the end of the file", i);
+    }
+}
+
+/********************************************************************//**
+ * Invariants des metadatas : identifiants, compte des images, tailles et
+ * positions. Ajoute à extents les blocs des images valides.
+ */
+static int verify_metadata(struct verify_state* state, uint64_t file_size,
+                           struct verify_extent* extents, size_t* count, uint32_t* images)
+{
+    const struct pictdb_file *db_file = state->db_file;
+    const uint32_t max_files = db_file->header.max_files;
+
+    struct id_index_entry *ids = calloc(max_files, sizeof(struct id_index_entry));
+    if (max_files > 0 && ids == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    uint32_t valid = 0;
+
+    for (uint32_t i = 0; i < max_files; i++) {
+        const struct pict_metadata *metadata = &db_file->metadata[i];
+
+        if (metadata->is_valid == EMPTY)
+            continue;
+
+        if (metadata->is_valid != NON_EMPTY)
+            verify_problem(state, i, RES_ORIG, "invalid is_valid value %" PRIu16, metadata->is_valid);
+
+        // Un identifiant non terminé dans le fichier est lu avec un octet de trop
+        if (metadata->pict_id == NULL || strlen(metadata->pict_id) > MAX_PIC_ID || metadata->pict_id[0] == '\0') {
+            verify_problem(state, i, RES_ORIG, "%s", ERROR_MESSAGES[ERR_INVALID_PICID]);
+        } else {
+            ids[valid].pict_id = metadata->pict_id;
+            ids[valid].index = i;
+            valid++;
+        }
+
+        if (metadata->offset[RES_ORIG] == 0 || metadata->size[RES_ORIG] == 0)
+            verify_problem(state, i, RES_ORIG, "no original image");
+
+        for (uint32_t res = 0; res < NB_RES; res++) {
+            const uint64_t offset = metadata->offset[res];
+            const uint64_t size = metadata->size[res];
+
+            if ((offset == 0) != (size == 0)) {
+                verify_problem(state, i, res, "offset %" PRIu64 " with size %" PRIu64, offset, size);
+                continue;
+            }
+
+            if (size == 0)
+                continue;
+
+            if (offset > file_size || size > file_size - offset) {
+                verify_problem(state, i, res, "data [%" PRIu64 ", %" PRIu64 ") past the end of the file (%" PRIu64 ")",
+                               offset, offset + size, file_size);
+                continue;
+            }
+
+            struct verify_extent *extent = &extents[(*count)++];
+            extent->offset = offset;
+            extent->size = size;
+            extent->index = i;
+            extent->res = res;
+        }
+
+        (*images)++;
+    }
+
+    if (*images != db_file->header.num_files)
+        verify_problem(state, VERIFY_HEADER, 0, "%" PRIu32 " picture(s) in the header, %" PRIu32 " in the metadata",
+                       db_file->header.num_files, *images);
+
+    // Identifiants en double
+    qsort(ids, valid, sizeof(struct id_index_entry), id_compare);
+
+    for (uint32_t i = 1; i < valid; i++) {
+        if (id_compare(&ids[i - 1], &ids[i]) == 0)
+            verify_problem(state, ids[i].index, RES_ORIG, "%s (entry %" PRIu32 ")",
+                           ERROR_MESSAGES[ERR_DUPLICATE_ID], ids[i - 1].index);
+    }
+
+    free(ids);
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ajoute les blocs réservés : header et table initiale, extension et pages
+ */
+static void reserved_extents(const struct pictdb_file* db_file, struct verify_extent* extents, size_t* count)
+{
+    const uint32_t initial_files = (db_file->header.ext_offset != 0) ? db_file->ext.initial_files : db_file->header.max_files;
+
+    struct verify_extent reserved = { 0, sizeof(struct pictdb_header) + (uint64_t)initial_files * sizeof(struct pict_metadata_disk),
+                                      VERIFY_HEADER, 0
+                                    };
+    extents[(*count)++] = reserved;
+
+    if (db_file->header.ext_offset != 0) {
+        reserved.offset = db_file->header.ext_offset;
+        reserved.size = sizeof(struct pictdb_header_ext);
+        extents[(*count)++] = reserved;
+    }
+
+    for (uint32_t i = 0; i < db_file->ext.nb_pages; i++) {
+        reserved.offset = db_file->pages[i];
+        reserved.size = sizeof(struct pict_metadata_page) + (uint64_t)db_file->ext.page_size * sizeof(struct pict_metadata_disk);
+        extents[(*count)++] = reserved;
+    }
+}
+
+/********************************************************************//**
+ * Recherche des chevauchements dans les blocs triés. Un bloc identique au
+ * précédent est partagé (cf. dedup) et n'est relu qu'une fois : seuls les
+ * blocs à relire sont gardés dans jobs.
+ */
+static size_t verify_overlaps(struct verify_state* state, const struct verify_extent* extents, size_t count,
+                              struct verify_extent* jobs)
+{
+    const struct pict_metadata *metadata = state->db_file->metadata;
+    const struct verify_extent *previous = NULL;
+    uint64_t end = 0;
+    size_t nb_jobs = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const struct verify_extent *extent = &extents[i];
+        const struct verify_extent *shared = (i > 0) ? &extents[i - 1] : NULL;
+
+        if (shared != NULL && shared->index != VERIFY_HEADER && extent->index != VERIFY_HEADER
+            && extent->offset == shared->offset && extent->size == shared->size) {
+            // Données partagées : même image (SHA, s'ils sont connus), à la même résolution
+            const struct pict_metadata *a = &metadata[extent->index], *b = &metadata[shared->index];
+
+            if (extent->res != shared->res
+                || (!sha_pending(a) && !sha_pending(b) && memcmp(a->SHA, b->SHA, SHA256_DIGEST_LENGTH) != 0))
+                verify_problem(state, extent->index, extent->res, "shares its data with a different image (entry %" PRIu32 ")",
+                               shared->index);
+            continue;
+        }
+
+        if (extent->offset < end) {
+            if (extent->index == VERIFY_HEADER)
+                verify_problem(state, previous->index, previous->res, "data overlaps the header or a metadata page");
+            else if (previous->index == VERIFY_HEADER)
+                verify_problem(state, extent->index, extent->res, "data overlaps the header or a metadata page");
+            else
+                verify_problem(state, extent->index, extent->res, "data overlaps entry %" PRIu32 " (resolution %" PRIu32 ")",
+                               previous->index, previous->res);
+        }
+
+        if (extent->offset + extent->size > end) {
+            end = extent->offset + extent->size;
+            previous = extent;
+        }
+
+        if (extent->index != VERIFY_HEADER)
+            jobs[nb_jobs++] = *extent;
+    }
+
+    return nb_jobs;
+}
+
+/********************************************************************//**
+ * Lecture complète de size octets à la position offset
+ */
+static int read_at(int fd, unsigned char* buf, uint64_t size, uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t n = pread(fd, buf, size, (off_t)offset);
+        if (n <= 0)
+            return ERR_IO;
+
+        buf += n;
+        size -= (uint64_t)n;
+        offset += (uint64_t)n;
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Décodage complet d'une image JPEG
+ */
+static int decode_jpeg(unsigned char* buf, size_t size)
+{
+    VipsImage *image = NULL;
+
+    if (vips_jpegload_buffer(buf, size, &image, "fail", TRUE, NULL) != 0 || image == NULL) {
+        vips_error_clear();
+        return ERR_VIPS;
+    }
+
+    // Le calcul de la moyenne force le décodage de tous les pixels
+    double average = 0.0;
+    int ret = vips_avg(image, &average, NULL);
+
+    g_object_unref(image);
+
+    if (ret != 0) {
+        vips_error_clear();
+        return ERR_VIPS;
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Relecture d'une tranche de blocs : CRC, SHA des originaux, décodage des
+ * petites images
+ */
+static void* verify_worker_run(void* arg)
+{
+    struct verify_worker *worker = arg;
+    struct verify_state *state = worker->state;
+    unsigned char *buf = NULL;
+    uint64_t capacity = 0;
+
+    for (size_t i = worker->first; i < worker->last; i++) {
+        const struct verify_extent *job = &state->jobs[i];
+        const struct pict_metadata *metadata = &state->db_file->metadata[job->index];
+
+        if (job->size > capacity) {
+            unsigned char *grown = realloc(buf, job->size);
+            if (grown == NULL) {
+                verify_problem(state, job->index, job->res, "%s", ERROR_MESSAGES[ERR_OUT_OF_MEMORY]);
+                continue;
+            }
+
+            buf = grown;
+            capacity = job->size;
+        }
+
+        if (read_at(state->fd, buf, job->size, job->offset) != ERR_NONE) {
+            verify_problem(state, job->index, job->res, "%s", ERROR_MESSAGES[ERR_IO]);
+            continue;
+        }
+
+        worker->bytes += job->size;
+
+        if (check_image_crc(metadata, job->res, buf, (uint32_t)job->size) != ERR_NONE)
+            verify_problem(state, job->index, job->res, "%s", ERROR_MESSAGES[ERR_CORRUPT]);
+
+        if (job->res == RES_ORIG) {
+            // SHA en attente : seul le CRC est vérifié
+            if (sha_pending(metadata))
+                continue;
+
+            unsigned char sha[SHA256_DIGEST_LENGTH];
+            SHA256(buf, job->size, sha);
+
+            if (memcmp(sha, metadata->SHA, SHA256_DIGEST_LENGTH) != 0)
+                verify_problem(state, job->index, job->res, "SHA-256 mismatch");
+        } else if (decode_jpeg(buf, job->size) != ERR_NONE) {
+            verify_problem(state, job->index, job->res, "%s (JPEG does not decode)", ERROR_MESSAGES[ERR_VIPS]);
+        }
+    }
+
+    free(buf);
+
+    return NULL;
+}
+
+/********************************************************************//**
+ * Relecture des blocs triés par nb_threads threads, chacun sur une
+ * tranche contiguë d'environ le même nombre d'octets
+ */
+static int verify_content(struct verify_state* state, size_t nb_jobs, uint32_t nb_threads, uint64_t* bytes)
+{
+    struct verify_worker workers[VERIFY_MAX_THREADS];
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < nb_jobs; i++)
+        total += state->jobs[i].size;
+
+    size_t next = 0;
+    uint64_t done = 0;
+    uint32_t started = 0;
+    int err = ERR_NONE;
+
+    for (uint32_t t = 0; t < nb_threads; t++) {
+        const uint64_t target = total / nb_threads * (t + 1) + ((t + 1 == nb_threads) ? total % nb_threads : 0);
+
+        workers[t].state = state;
+        workers[t].first = next;
+        workers[t].bytes = 0;
+
+        while (next < nb_jobs && (done < target || t + 1 == nb_threads))
+            done += state->jobs[next++].size;
+
+        workers[t].last = next;
+
+        if (pthread_create(&workers[t].thread, NULL, verify_worker_run, &workers[t]) != 0) {
+            err = ERR_INTERNAL;
+            break;
+        }
+
+        started++;
+    }
+
+    for (uint32_t t = 0; t < started; t++) {
+        pthread_join(workers[t].thread, NULL);
+        *bytes += workers[t].bytes;
+    }
+
+    return err;
+}
+
+/********************************************************************/
+int do_verify(const struct pictdb_file* db_file, uint32_t nb_threads, struct verify_report* report)
+{
+    memset(report, 0, sizeof(struct verify_report));
+
+    if (db_file->fpdb == NULL)
+        return ERR_IO;
+
+    // Un thread par cœur par défaut
+    if (nb_threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        nb_threads = (cores > 0) ? (uint32_t)cores : 1;
+    }
+
+    if (nb_threads > VERIFY_MAX_THREADS)
+        nb_threads = VERIFY_MAX_THREADS;
+
+    if (fseek(db_file->fpdb, 0, SEEK_END) != 0)
+        return ERR_IO;
+
+    long file_size = ftell(db_file->fpdb);
+    if (file_size == -1)
+        return ERR_IO;
+
+    struct verify_state state;
+    state.db_file = db_file;
+    state.fd = fileno(db_file->fpdb);
+    state.jobs = NULL;
+    state.problems = 0;
+
+    // Blocs des images et blocs réservés
+    const size_t max_extents = (size_t)db_file->header.max_files * NB_RES + db_file->ext.nb_pages + 2;
+
+    struct verify_extent *extents = calloc(max_extents, sizeof(struct verify_extent));
+    struct verify_extent *jobs = calloc(max_extents, sizeof(struct verify_extent));
+    if (extents == NULL || jobs == NULL) {
+        free(extents);
+        free(jobs);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    if (pthread_mutex_init(&state.lock, NULL) != 0) {
+        free(extents);
+        free(jobs);
+        return ERR_INTERNAL;
+    }
+
+    verify_header(&state, (uint64_t)file_size);
+
+    size_t count = 0;
+    int err = verify_metadata(&state, (uint64_t)file_size, extents, &count, &report->images);
+    if (err != ERR_NONE)
+        goto error;
+
+    reserved_extents(db_file, extents, &count);
+    qsort(extents, count, sizeof(struct verify_extent), extent_compare);
+
+    size_t nb_jobs = verify_overlaps(&state, extents, count, jobs);
+    state.jobs = jobs;
+
+    if (nb_threads > nb_jobs)
+        nb_threads = (nb_jobs > 0) ? (uint32_t)nb_jobs : 1;
+
+    err = verify_content(&state, nb_jobs, nb_threads, &report->bytes);
+    if (err != ERR_NONE)
+        goto error;
+
+    report->extents = nb_jobs;
+    report->threads = nb_threads;
+    report->problems = state.problems;
+
+error:
+    pthread_mutex_destroy(&state.lock);
+    free(extents);
+    free(jobs);
+
+    return err;
+}
@@ -3,15 +3,24 @@
  * @brief Dé-duplication des images pour éviter qu'une même image (même contenu)
  * 		  soit présente plusieurs fois dans la base.
  *
+ * Les images sont d'abord comparées par leur empreinte : taille et CRC-32C
+ * de l'original, déjà présents dans les metadatas. Le SHA-256, bien plus
+ * coûteux, n'est calculé (pour l'image insérée comme pour l'image déjà
+ * stockée) que si les empreintes correspondent ; sinon il reste "en
+ * attente" jusqu'à ce qu'il soit calculé par fill_sha.
+ *
  * @author Dominique Roduit, Thierry Treyer
  * @date 29 Avr 2016
  */
 
 #include "pictDB.h"
 #include "dedup.h"
+#include "image_content.h"
+#include "buffer_pool.h"
 
 #include <stdlib.h> // pour calloc
-#include <string.h> // pour strcmp
+#include <string.h> // pour strcmp, memcpy
+#include <openssl/sha.h> // pour SHA256
 
 /********************************************************************/
 int shacmp(const unsigned char *sha1, const unsigned char *sha2)
@@ -27,26 +36,114 @@ int shacmp(const unsigned char *sha1, const unsigned char *sha2)
 }
 
 /********************************************************************/
-int do_name_and_content_dedup(struct pictdb_file* db_file, const uint32_t index)
+int sha_pending(const struct pict_metadata* metadata)
+{
+    for (size_t i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        if (metadata->SHA[i] != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/********************************************************************//**
+ * Calcule le SHA d'une image en relisant l'original depuis le fichier
+ */
+static int compute_sha(struct pictdb_file* db_file, const uint32_t index)
+{
+    void *image = NULL;
+
+    int retval = fetch_image(db_file, index, RES_ORIG, &image);
+    if (retval != ERR_NONE)
+        return retval;
+
+    SHA256(image, db_file->metadata[index].size[RES_ORIG], db_file->metadata[index].SHA);
+    buffer_release(image);
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int fill_sha(struct pictdb_file* db_file, const uint32_t index)
+{
+    if (index >= db_file->header.max_files)
+        return ERR_INVALID_ARGUMENT;
+
+    if (!sha_pending(&db_file->metadata[index]))
+        return ERR_NONE;
+
+    int retval = compute_sha(db_file, index);
+    if (retval != ERR_NONE)
+        return retval;
+
+    meta_scan_update(db_file, index, db_file->header.db_version);
+
+    return do_write_entry(db_file, index);
+}
+
+/********************************************************************//**
+ * Indique si une image peut avoir le même contenu qu'une image stockée de
+ * taille size et de CRC crc : même taille et même CRC (s'ils sont connus)
+ */
+static int same_fingerprint(const struct pict_metadata* metadata, uint32_t size, uint32_t crc)
+{
+    if (metadata->size[RES_ORIG] != size)
+        return 0;
+
+    return metadata->crc_orig == 0 || crc == 0 || metadata->crc_orig == crc;
+}
+
+/********************************************************************/
+int do_name_and_content_dedup(struct pictdb_file* db_file, const uint32_t index, const void* img)
 {
     if (index > db_file->header.max_files)
         return ERR_INVALID_ARGUMENT;
 
     struct pict_metadata *to_check = &db_file->metadata[index];
 
-    // Parcours des images...
-    uint32_t i = 0, num_files = 0;
-    while (i < db_file->header.max_files && num_files < db_file->header.num_files) {
-        struct pict_metadata *metadata = &db_file->metadata[i];
+    // Parcours de la représentation compacte : les metadatas complètes ne
+    // sont lues que pour les images candidates
+    int retval = meta_scan_build(db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    const struct meta_scan *scan = &db_file->scan;
+    const uint64_t id_hash = pict_id_hash(to_check->pict_id);
 
-        if (i++ == index || metadata->is_valid == EMPTY)
+    for (uint32_t i = meta_scan_next(scan, 0, 1); i < scan->count; i = meta_scan_next(scan, i + 1, 1)) {
+        if (i == index)
             continue;
 
-        num_files++;
+        const struct pict_metadata *metadata = &db_file->metadata[i];
 
-        if (!strcmp(to_check->pict_id, metadata->pict_id))
+        if (scan->id_hash[i] == id_hash && !strcmp(to_check->pict_id, metadata->pict_id))
             return ERR_DUPLICATE_ID;
 
+        // Empreintes différentes : contenus différents, sans calculer de SHA
+        if (!same_fingerprint(to_check, scan->size[i], scan->crc[i]))
+            continue;
+
+        // SHA connus des deux côtés : leurs débuts suffisent à les départager
+        uint64_t prefix = 0;
+        memcpy(&prefix, to_check->SHA, sizeof(uint64_t));
+
+        if (prefix != 0 && scan->sha_prefix[i] != 0 && prefix != scan->sha_prefix[i])
+            continue;
+
+        if (sha_pending(to_check)) {
+            if (img != NULL)
+                SHA256(img, to_check->size[RES_ORIG], to_check->SHA);
+            else
+                retval = compute_sha(db_file, index);
+
+            if (retval != ERR_NONE)
+                return retval;
+        }
+
+        retval = fill_sha(db_file, i);
+        if (retval != ERR_NONE)
+            return retval;
+
         // Gestion des duplicatas
         if (!shacmp(to_check->SHA, metadata->SHA)) {
             for (size_t res = 0; res < NB_RES; res++) {
@@ -54,6 +151,9 @@ int do_name_and_content_dedup(struct pictdb_file* db_file, const uint32_t index)
                 to_check->offset[res] = metadata->offset[res];
             }
 
+            to_check->crc_orig = metadata->crc_orig;
+            memcpy(to_check->crc_resized, metadata->crc_resized, sizeof(to_check->crc_resized));
+
             return ERR_NONE;
         }
     }
@@ -20,8 +20,28 @@
 int shacmp(const unsigned char *sha1, const unsigned char *sha2);
 
 /**
- * @brief Dé-duplication des images
+ * @brief Dé-duplication des images. L'image à la position index doit avoir
+ * sa taille et, si possible, son CRC (crc_orig) ; son SHA peut être en
+ * attente (nul), il est alors calculé si une image stockée a la même
+ * empreinte.
  * @param db_file Fichier pictDB précédemment ouvert
  * @param index Spécifie la position d'une image donnée dans le tableau metadata
+ * @param img Contenu de l'image (NULL : relu depuis le fichier, à
+ * offset[RES_ORIG], si son SHA doit être calculé)
  */
-int do_name_and_content_dedup(struct pictdb_file* db_file, const uint32_t index);
+int do_name_and_content_dedup(struct pictdb_file* db_file, const uint32_t index, const void* img);
+
+/**
+ * @brief Indique si le SHA d'une image est en attente (pas encore calculé)
+ * @param metadata Metadata de l'image
+ */
+int sha_pending(const struct pict_metadata* metadata);
+
+/**
+ * @brief Calcule et enregistre le SHA d'une image s'il est en attente, en
+ * relisant l'image originale depuis le fichier
+ * @param db_file Fichier pictDB ouvert en écriture
+ * @param index Position de l'image dans le tableau metadata
+ * @return Code d'erreur approprié
+ */
+int fill_sha(struct pictdb_file* db_file, const uint32_t index);
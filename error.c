@@ -27,6 +27,8 @@ const char * const ERROR_MESSAGES[] = {
     "Unable to start listener",
     "Internal error",
     "Invalid or missing parameter",
-    "Debug"
+    "Debug",
+    "Corrupted image (checksum mismatch)",
+    "Inconsistent database (see verify report)"
 };
 
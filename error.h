@@ -32,7 +32,9 @@ enum error_codes {
     ERR_BIND,
     ERR_INTERNAL,
     ERR_INVALID_PARAM,
-    ERR_DEBUG
+    ERR_DEBUG,
+    ERR_CORRUPT,
+    ERR_INCONSISTENT
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,363 @@
+/**
+ * @file image_cache.c
+ * @brief Cache LRU partitionné des images les plus lues
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdlib.h> // pour calloc
+#include <string.h> // pour memcpy
+#include <pthread.h>
+
+#include "image_cache.h"
+
+#define CACHE_INITIAL_BUCKETS 256 // nombre initial de listes par partition
+#define CACHE_MAX_ENTRY_RATIO 4 // une image occupe au plus 1/4 d'une partition
+
+// Une image présente dans le cache
+struct cache_entry {
+    // Clé de l'entrée
+    uint32_t index;
+    uint32_t res;
+    uint64_t offset;
+    uint64_t generation;
+    // Contenu de l'image
+    uint32_t size;
+    void *data;
+    // Liste LRU (head = plus récemment utilisée)
+    struct cache_entry *prev, *next;
+    // Liste de la table de hachage
+    struct cache_entry *hnext;
+};
+
+// Une partition du cache, avec son verrou et sa part du budget
+struct cache_shard {
+    pthread_mutex_t lock;
+    struct cache_entry **buckets;
+    size_t nb_buckets;
+    size_t nb_entries;
+    struct cache_entry *head, *tail;
+    size_t used;
+    size_t budget;
+    // Compteurs
+    uint64_t hits, misses, insertions, evictions;
+};
+
+struct image_cache {
+    struct cache_shard shards[CACHE_SHARDS];
+    uint64_t generation;
+};
+
+/********************************************************************//**
+ * Mélange des champs de la clé (finaliseur de splitmix64)
+ */
+static uint64_t hash_key(uint32_t index, uint32_t res, uint64_t offset, uint64_t generation)
+{
+    uint64_t h = offset ^ ((uint64_t)index << 32 | res) ^ (generation * 0x9E3779B97F4A7C15ULL);
+
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+
+    return h ^ (h >> 31);
+}
+
+/********************************************************************//**
+ * Place l'entrée en tête de la liste LRU
+ */
+static void lru_push_front(struct cache_shard* shard, struct cache_entry* entry)
+{
+    entry->prev = NULL;
+    entry->next = shard->head;
+
+    if (shard->head != NULL)
+        shard->head->prev = entry;
+    shard->head = entry;
+
+    if (shard->tail == NULL)
+        shard->tail = entry;
+}
+
+/********************************************************************//**
+ * Retire l'entrée de la liste LRU
+ */
+static void lru_unlink(struct cache_shard* shard, struct cache_entry* entry)
+{
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        shard->head = entry->next;
+
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        shard->tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+/********************************************************************//**
+ * Retire et libère l'entrée (liste LRU et table de hachage)
+ */
+static void shard_remove(struct cache_shard* shard, struct cache_entry* entry, uint64_t hash)
+{
+    struct cache_entry **link = &shard->buckets[hash % shard->nb_buckets];
+
+    while (*link != NULL && *link != entry)
+        link = &(*link)->hnext;
+
+    if (*link != NULL)
+        *link = entry->hnext;
+
+    lru_unlink(shard, entry);
+
+    shard->used -= sizeof(struct cache_entry) + entry->size;
+    shard->nb_entries--;
+
+    free(entry->data);
+    free(entry);
+}
+
+/********************************************************************//**
+ * Double la taille de la table de hachage de la partition
+ */
+static void shard_grow(struct cache_shard* shard)
+{
+    size_t nb_buckets = shard->nb_buckets * 2;
+    struct cache_entry **buckets = calloc(nb_buckets, sizeof(struct cache_entry*));
+
+    // Pas assez de mémoire : on garde des listes plus longues
+    if (buckets == NULL)
+        return;
+
+    for (size_t i = 0; i < shard->nb_buckets; i++) {
+        struct cache_entry *entry = shard->buckets[i];
+
+        while (entry != NULL) {
+            struct cache_entry *next = entry->hnext;
+            size_t b = (hash_key(entry->index, entry->res, entry->offset, entry->generation) / CACHE_SHARDS) % nb_buckets;
+
+            entry->hnext = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->nb_buckets = nb_buckets;
+}
+
+/********************************************************************//**
+ * Recherche une entrée (verrou de la partition déjà pris)
+ */
+static struct cache_entry* shard_find(struct cache_shard* shard, uint32_t index, uint32_t res,
+                                      uint64_t offset, uint64_t generation, uint64_t hash)
+{
+    struct cache_entry *entry = shard->buckets[hash % shard->nb_buckets];
+
+    while (entry != NULL) {
+        if (entry->index == index && entry->res == res
+            && entry->offset == offset && entry->generation == generation)
+            return entry;
+
+        entry = entry->hnext;
+    }
+
+    return NULL;
+}
+
+/********************************************************************/
+int image_cache_init(struct image_cache** cache, size_t budget)
+{
+    if (cache == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    *cache = calloc(1, sizeof(struct image_cache));
+    if (*cache == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        struct cache_shard *shard = &(*cache)->shards[i];
+
+        shard->budget = budget / CACHE_SHARDS;
+        shard->nb_buckets = CACHE_INITIAL_BUCKETS;
+        shard->buckets = calloc(shard->nb_buckets, sizeof(struct cache_entry*));
+
+        if (shard->buckets == NULL || pthread_mutex_init(&shard->lock, NULL) != 0) {
+            free(shard->buckets);
+            shard->buckets = NULL;
+
+            // Libération des partitions déjà initialisées
+            for (size_t j = 0; j < i; j++) {
+                pthread_mutex_destroy(&(*cache)->shards[j].lock);
+                free((*cache)->shards[j].buckets);
+            }
+
+            free(*cache);
+            *cache = NULL;
+
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+void image_cache_free(struct image_cache* cache)
+{
+    if (cache == NULL)
+        return;
+
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        struct cache_shard *shard = &cache->shards[i];
+        struct cache_entry *entry = shard->head;
+
+        while (entry != NULL) {
+            struct cache_entry *next = entry->next;
+            free(entry->data);
+            free(entry);
+            entry = next;
+        }
+
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(cache);
+}
+
+/********************************************************************/
+int image_cache_get(struct image_cache* cache, uint32_t index, uint32_t res, uint64_t offset,
+                    uint32_t from, uint32_t length, void* buf)
+{
+    if (cache == NULL)
+        return 0;
+
+    const uint64_t generation = __atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE);
+    const uint64_t hash = hash_key(index, res, offset, generation);
+    struct cache_shard *shard = &cache->shards[hash % CACHE_SHARDS];
+    int found = 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    struct cache_entry *entry = shard_find(shard, index, res, offset, generation, hash / CACHE_SHARDS);
+    if (entry != NULL && from <= entry->size && length <= entry->size - from) {
+        memcpy(buf, (const char*)entry->data + from, length);
+
+        // Image utilisée : elle passe en tête de la liste LRU
+        lru_unlink(shard, entry);
+        lru_push_front(shard, entry);
+
+        shard->hits++;
+        found = 1;
+    } else {
+        shard->misses++;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return found;
+}
+
+/********************************************************************/
+void image_cache_put(struct image_cache* cache, uint32_t index, uint32_t res, uint64_t offset,
+                     const void* buf, uint32_t size)
+{
+    if (cache == NULL || buf == NULL || size == 0)
+        return;
+
+    const uint64_t generation = __atomic_load_n(&cache->generation, __ATOMIC_ACQUIRE);
+    const uint64_t hash = hash_key(index, res, offset, generation);
+    struct cache_shard *shard = &cache->shards[hash % CACHE_SHARDS];
+    const size_t cost = sizeof(struct cache_entry) + size;
+
+    if (cost > shard->budget / CACHE_MAX_ENTRY_RATIO)
+        return;
+
+    // Copie faite hors verrou
+    struct cache_entry *entry = calloc(1, sizeof(struct cache_entry));
+    void *data = malloc(size);
+    if (entry == NULL || data == NULL) {
+        free(entry);
+        free(data);
+        return;
+    }
+
+    memcpy(data, buf, size);
+
+    entry->index = index;
+    entry->res = res;
+    entry->offset = offset;
+    entry->generation = generation;
+    entry->size = size;
+    entry->data = data;
+
+    pthread_mutex_lock(&shard->lock);
+
+    // Déjà ajoutée entre temps
+    if (shard_find(shard, index, res, offset, generation, hash / CACHE_SHARDS) != NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        free(data);
+        free(entry);
+        return;
+    }
+
+    // Éviction des images les moins récemment utilisées
+    while (shard->tail != NULL && shard->used + cost > shard->budget) {
+        struct cache_entry *victim = shard->tail;
+        uint64_t victim_hash = hash_key(victim->index, victim->res, victim->offset, victim->generation);
+
+        shard_remove(shard, victim, victim_hash / CACHE_SHARDS);
+        shard->evictions++;
+    }
+
+    if (shard->nb_entries >= shard->nb_buckets)
+        shard_grow(shard);
+
+    const size_t b = (hash / CACHE_SHARDS) % shard->nb_buckets;
+    entry->hnext = shard->buckets[b];
+    shard->buckets[b] = entry;
+    lru_push_front(shard, entry);
+
+    shard->used += cost;
+    shard->nb_entries++;
+    shard->insertions++;
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/********************************************************************/
+void image_cache_invalidate(struct image_cache* cache)
+{
+    if (cache == NULL)
+        return;
+
+    __atomic_add_fetch(&cache->generation, 1, __ATOMIC_RELEASE);
+}
+
+/********************************************************************/
+void image_cache_get_stats(struct image_cache* cache, struct image_cache_stats* stats)
+{
+    memset(stats, 0, sizeof(struct image_cache_stats));
+
+    if (cache == NULL)
+        return;
+
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        struct cache_shard *shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->insertions += shard->insertions;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->nb_entries;
+        stats->used += shard->used;
+        stats->budget += shard->budget;
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * @file image_cache.h
+ * @brief Cache LRU en mémoire des images les plus lues, placé devant
+ *        fetch_image pour éviter de relire le fichier à chaque lecture.
+ *
+ * Le cache est découpé en plusieurs partitions (shards) indépendantes,
+ * chacune protégée par son propre verrou et disposant d'une part égale
+ * du budget mémoire. Une entrée est identifiée par la position de l'image
+ * dans les metadatas, sa résolution, sa position dans le fichier et la
+ * génération du cache : le fichier n'étant modifié que par ajouts, une
+ * position désigne toujours le même contenu, et image_cache_invalidate()
+ * rend toutes les entrées existantes obsolètes en temps constant.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_IMAGE_CACHE_H
+#define PICTDBPRJ_IMAGE_CACHE_H
+
+#include <stddef.h> // pour size_t
+#include <stdint.h> // pour uint32_t, uint64_t
+
+#include "error.h"
+
+#define CACHE_SHARDS 16 // nombre de partitions du cache
+#define CACHE_DEFAULT_SIZE (64 * 1024 * 1024) // budget mémoire par défaut (octets)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct image_cache;
+
+// Compteurs du cache, cumulés sur toutes les partitions
+struct image_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    // Nombre d'images et mémoire occupée actuellement
+    uint64_t entries;
+    uint64_t used;
+    // Budget mémoire total
+    uint64_t budget;
+};
+
+/**
+ * @brief Créé un cache d'images
+ * @param cache Adresse à laquelle stocker le cache créé
+ * @param budget Mémoire maximale (en octets) occupée par les images du cache
+ * @return Code d'erreur approprié
+ */
+int image_cache_init(struct image_cache** cache, size_t budget);
+
+/**
+ * @brief Libère le cache et toutes ses images
+ * @param cache Le cache à libérer (peut être NULL)
+ */
+void image_cache_free(struct image_cache* cache);
+
+/**
+ * @brief Recherche une image dans le cache et en copie une fenêtre dans buf
+ * @param cache Le cache (si NULL, la recherche échoue toujours)
+ * @param index Position de l'image dans les metadatas
+ * @param res Résolution de l'image
+ * @param offset Position de l'image dans le fichier
+ * @param from Position du premier octet à copier
+ * @param length Nombre d'octets à copier
+ * @param buf Buffer (déjà alloué) recevant la copie
+ * @return 1 si l'image était présente, 0 sinon
+ */
+int image_cache_get(struct image_cache* cache, uint32_t index, uint32_t res, uint64_t offset,
+                    uint32_t from, uint32_t length, void* buf);
+
+/**
+ * @brief Ajoute une copie de l'image au cache, en évinçant les images les
+ * moins récemment utilisées si nécessaire. Les images trop grosses pour
+ * le cache sont ignorées.
+ * @param cache Le cache (si NULL, ne fait rien)
+ * @param index Position de l'image dans les metadatas
+ * @param res Résolution de l'image
+ * @param offset Position de l'image dans le fichier
+ * @param buf Contenu de l'image
+ * @param size Taille de l'image
+ */
+void image_cache_put(struct image_cache* cache, uint32_t index, uint32_t res, uint64_t offset,
+                     const void* buf, uint32_t size);
+
+/**
+ * @brief Rend obsolètes toutes les images du cache (p.ex. après que le
+ * fichier de base de donnée a été remplacé). Les entrées obsolètes sont
+ * évincées au fil des insertions.
+ * @param cache Le cache (si NULL, ne fait rien)
+ */
+void image_cache_invalidate(struct image_cache* cache);
+
+/**
+ * @brief Récupère les compteurs du cache
+ * @param cache Le cache
+ * @param stats Structure recevant les compteurs
+ */
+void image_cache_get_stats(struct image_cache* cache, struct image_cache_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -8,9 +8,32 @@
 
 #include "pictDB.h"
 #include "image_content.h"
+#include "image_cache.h"
+#include "needle.h"
+#include "crc32c.h"
+#include "buffer_pool.h"
+#include "stats.h"
+#include "trace.h"
+#include "probes.h"
+
+#include <inttypes.h> // pour PRIu32
+
+// Marqueurs JPEG utilisés pour lire la résolution sans décoder l'image
+#define JPEG_SOI   0xD8
+#define JPEG_EOI   0xD9
+#define JPEG_SOS   0xDA
+#define JPEG_SOF0  0xC0
+#define JPEG_SOF15 0xCF
+#define JPEG_DHT   0xC4
+#define JPEG_JPG   0xC8
+#define JPEG_DAC   0xCC
+#define JPEG_SOF_LENGTH 9 // marqueur, longueur, précision, hauteur, largeur
 
 // ---------------------------------------------------------------------
-int lazily_resize(struct pictdb_file* db_file, const size_t index, const uint32_t res)
+/**
+ * Création de la variante res d'une image (cf. lazily_resize)
+ */
+static int resize_variant(struct pictdb_file* db_file, const size_t index, const uint32_t res)
 {
     // Contrôle des arguments
     int err = check_image_exists(db_file, index, RES_ORIG);
@@ -23,66 +46,87 @@ int lazily_resize(struct pictdb_file* db_file, const size_t index, const uint32_
     if (db_file->metadata[index].offset[res] > 0)
         return ERR_NONE;
 
-    // Init des ressources qui doivent être libérée en cas d'erreur
+    // Récupération des données de l'image originelle
     void *buf_orig = NULL, *buf_resized = NULL;
-    VipsImage *image_orig = NULL, *image_resized = NULL;
+    size_t len_resized = 0;
 
-    // Récupération des données de l'image originelle
     err = fetch_image(db_file, index, RES_ORIG, &buf_orig);
     if (err != ERR_NONE)
-        goto error;
+        return err;
+
+    err = resize_image(db_file, res, buf_orig, db_file->metadata[index].size[RES_ORIG], &buf_resized, &len_resized);
+    buffer_release(buf_orig);
+    if (err != ERR_NONE)
+        return err;
+
+    // Écriture du résultat
+    err = store_image(db_file, index, res, buf_resized, (uint32_t)len_resized);
+    g_free(buf_resized);
+
+    return err;
+}
+
+// ---------------------------------------------------------------------
+int lazily_resize(struct pictdb_file* db_file, const size_t index, const uint32_t res)
+{
+    PROBE_RESIZE_ENTRY(PROBE_PICT_ID(db_file, index), res);
+    int err = resize_variant(db_file, index, res);
+    PROBE_RESIZE_RETURN(PROBE_PICT_ID(db_file, index), res,
+                        (err == ERR_NONE && res < NB_RES) ? db_file->metadata[index].size[res] : 0, err);
+
+    return err;
+}
+
+// ---------------------------------------------------------------------
+int resize_image(const struct pictdb_file* db_file, const uint32_t res, const void* buf, const size_t len,
+                 void** resized, size_t* resized_len)
+{
+    // Init des ressources qui doivent être libérée en cas d'erreur
+    VipsImage *image_orig = NULL, *image_resized = NULL;
+    int err = ERR_NONE;
 
     // Image originelle passée à VIPS
-    image_orig = vips_image_new_from_buffer(buf_orig, db_file->metadata[index].size[RES_ORIG], NULL, NULL);
-    if (image_orig == NULL) {
-        err = ERR_VIPS;
-        goto error;
-    }
+    uint64_t start = trace_begin();
+    image_orig = vips_image_new_from_buffer(buf, len, NULL, NULL);
+    trace_end("vips.load", start, "%zu bytes", len);
+    if (image_orig == NULL)
+        return ERR_VIPS;
 
     // Calcul du ratio de redimensionnement
     double ratio = resize_ratio(image_orig, db_file->header.res_resized[2 * res], db_file->header.res_resized[2 * res + 1]);
 
     // Redimensionnement
+    start = trace_begin();
     err = vips_resize(image_orig, &image_resized, ratio, NULL);
+    trace_end("vips.resize", start, "res %" PRIu32, res);
     if (err != ERR_NONE) {
         err = ERR_VIPS;
         goto error;
     }
 
     // Export du resultat en JPEG
-    size_t len_resized = 0;
-    err = vips_jpegsave_buffer(image_resized, &buf_resized, &len_resized, NULL);
+    *resized = NULL;
+    start = trace_begin();
+    err = vips_jpegsave_buffer(image_resized, resized, resized_len, NULL);
+    trace_end("vips.save", start, "res %" PRIu32, res);
     if (err != ERR_NONE) {
         err = ERR_VIPS;
         goto error;
     }
 
-    // Écriture du résultat
-    err = store_image(db_file, index, res, buf_resized, (uint32_t)len_resized);
-    if (err != ERR_NONE)
-        goto error;
-
     // Libération des ressources
-    g_free(buf_resized);
     g_object_unref(image_resized);
     g_object_unref(image_orig);
-    free(buf_orig);
 
     return ERR_NONE;
 
 error:
-    if (buf_orig != NULL)
-        free(buf_orig);
-
     if (image_orig != NULL)
         g_object_unref(image_orig);
 
     if (image_resized != NULL)
         g_object_unref(image_resized);
 
-    if (buf_resized != NULL)
-        g_free(buf_resized);
-
     return err;
 }
 
@@ -102,30 +146,102 @@ int fetch_image(const struct pictdb_file* db_file, const size_t index, const uin
     if (error != ERR_NONE)
         return error;
 
-    const struct pict_metadata *file = &db_file->metadata[index];
+    return fetch_image_range(db_file, index, res, 0, db_file->metadata[index].size[res], buf);
+}
+
+// ---------------------------------------------------------------------
+/**
+ * Vérifie que la fenêtre demandée est non vide et comprise dans l'image
+ */
+static int check_image_range(const struct pictdb_file* db_file, const size_t index, const uint32_t res,
+                             const uint32_t from, const uint32_t length)
+{
+    int error = check_image_exists(db_file, index, res);
+    if (error != ERR_NONE)
+        return error;
+
+    const uint32_t size = db_file->metadata[index].size[res];
+
+    if (length == 0 || from >= size || length > size - from)
+        return ERR_INVALID_ARGUMENT;
+
+    return ERR_NONE;
+}
+
+// ---------------------------------------------------------------------
+int fetch_image_range(const struct pictdb_file* db_file, const size_t index, const uint32_t res,
+                      const uint32_t from, const uint32_t length, void **buf)
+{
+    int error = check_image_range(db_file, index, res, from, length);
+    if (error != ERR_NONE)
+        return error;
 
-    // Lecture de l'image depuis le fichier
-    *buf = calloc(1, file->size[res]);
+    *buf = buffer_acquire(length);
     if (*buf == NULL)
         return ERR_OUT_OF_MEMORY;
 
-    long retval = fseek(db_file->fpdb, (long)file->offset[res], SEEK_SET);
-    if (retval != 0) {
-        free(*buf);
-        return ERR_IO;
+    error = fetch_image_into(db_file, index, res, from, length, *buf);
+    if (error != ERR_NONE) {
+        buffer_release(*buf);
+        *buf = NULL;
     }
 
-    retval = (long)fread(*buf, file->size[res], 1, db_file->fpdb);
-    if (retval != 1) {
-        free(*buf);
+    return error;
+}
+
+// ---------------------------------------------------------------------
+/**
+ * Lecture d'une fenêtre d'image, depuis le cache ou le fichier
+ */
+static int read_image_into(const struct pictdb_file* db_file, const size_t index, const uint32_t res,
+                           const uint32_t from, const uint32_t length, void *buf)
+{
+    int error = check_image_range(db_file, index, res, from, length);
+    if (error != ERR_NONE)
+        return error;
+
+    const struct pict_metadata *file = &db_file->metadata[index];
+
+    // Image déjà en cache : pas d'accès au fichier
+    if (image_cache_get(db_file->cache, (uint32_t)index, res, file->offset[res], from, length, buf))
+        return ERR_NONE;
+
+    // Lecture de la fenêtre depuis le fichier
+    if (fseek(db_file->fpdb, (long)(file->offset[res] + from), SEEK_SET) != 0
+        || fread(buf, length, 1, db_file->fpdb) != 1)
         return ERR_IO;
+
+    stats_add(STAT_BYTES_READ, length);
+
+    // Seules les images lues en entier sont vérifiées et gardées en cache
+    if (from == 0 && length == file->size[res]) {
+        if (db_file->verify_crc && check_image_crc(file, res, buf, length) != ERR_NONE)
+            return ERR_CORRUPT;
+
+        image_cache_put(db_file->cache, (uint32_t)index, res, file->offset[res], buf, length);
     }
 
     return ERR_NONE;
 }
 
 // ---------------------------------------------------------------------
-int store_image(struct pictdb_file* db_file, const size_t index, const uint32_t res, const void *buf, const uint32_t len)
+int fetch_image_into(const struct pictdb_file* db_file, const size_t index, const uint32_t res,
+                     const uint32_t from, const uint32_t length, void *buf)
+{
+    const uint64_t start = trace_begin();
+    PROBE_FETCH_ENTRY(PROBE_PICT_ID(db_file, index), res, length);
+    int error = read_image_into(db_file, index, res, from, length, buf);
+    PROBE_FETCH_RETURN(PROBE_PICT_ID(db_file, index), res, length, error);
+    trace_end("fetch_image", start, "index %zu res %" PRIu32 " %" PRIu32 " bytes", index, res, length);
+
+    return error;
+}
+
+// ---------------------------------------------------------------------
+/**
+ * Écriture d'une image à la fin du fichier et de son entrée
+ */
+static int write_image(struct pictdb_file* db_file, const size_t index, const uint32_t res, const void *buf, const uint32_t len)
 {
     int error = ERR_NONE;
     if (res != RES_ORIG) {
@@ -146,21 +262,112 @@ int store_image(struct pictdb_file* db_file, const size_t index, const uint32_t
     if (offset == -1)
         return ERR_IO;
 
+    const uint32_t crc = crc32c(0, buf, len);
+
+    // Needle devant l'image, si la base en utilise
+    if (needle_enabled(db_file)) {
+        const char *pict_id = db_file->metadata[index].pict_id;
+
+        error = needle_write(db_file->fpdb, pict_id, res, 0, len, crc, 0);
+        if (error != ERR_NONE)
+            return error;
+
+        offset += (long)needle_size(pict_id);
+    }
+
     // Écriture de l'image et des metadatas
     error = (int)fwrite(buf, len, 1, db_file->fpdb);
     if (error != 1)
         return ERR_IO;
 
+    stats_add(STAT_BYTES_WRITTEN, len);
+
     db_file->metadata[index].size[res] = len;
     db_file->metadata[index].offset[res] = (uint64_t)offset;
 
-    error = do_write(db_file, NULL);
+    // Nouvelle variante d'une image existante : la version ne change pas
+    if (res != RES_ORIG && db_file->live_bytes != 0 && db_file->live_version == db_file->header.db_version)
+        db_file->live_bytes += len;
+    set_image_crc(&db_file->metadata[index], res, crc);
+
+    error = do_write_entry(db_file, (uint32_t)index);
     if (error != ERR_NONE)
         return error;
 
     return ERR_NONE;
 }
 
+// ---------------------------------------------------------------------
+int store_image(struct pictdb_file* db_file, const size_t index, const uint32_t res, const void *buf, const uint32_t len)
+{
+    const uint64_t start = trace_begin();
+    PROBE_STORE_ENTRY(PROBE_PICT_ID(db_file, index), res, len);
+    int error = write_image(db_file, index, res, buf, len);
+    PROBE_STORE_RETURN(PROBE_PICT_ID(db_file, index), res, len, error);
+    trace_end("store_image", start, "index %zu res %" PRIu32 " %" PRIu32 " bytes", index, res, len);
+
+    return error;
+}
+
+// ---------------------------------------------------------------------
+void set_image_crc(struct pict_metadata* metadata, const uint32_t res, const uint32_t crc)
+{
+    // Un CRC nul est remplacé par 1 : 0 signifie "pas calculé"
+    if (res == RES_ORIG) {
+        metadata->crc_orig = (crc != 0) ? crc : 1;
+    } else {
+        uint16_t folded = (uint16_t)(crc ^ (crc >> 16));
+        metadata->crc_resized[res] = (folded != 0) ? folded : 1;
+    }
+}
+
+// ---------------------------------------------------------------------
+int check_image_crc(const struct pict_metadata* metadata, const uint32_t res, const void* buf, const uint32_t len)
+{
+    const uint32_t stored = (res == RES_ORIG) ? metadata->crc_orig : metadata->crc_resized[res];
+
+    // Image stockée avant l'ajout des CRC : rien à vérifier
+    if (stored == 0)
+        return ERR_NONE;
+
+    struct pict_metadata expected;
+    set_image_crc(&expected, res, crc32c(0, buf, len));
+
+    const uint32_t computed = (res == RES_ORIG) ? expected.crc_orig : expected.crc_resized[res];
+
+    return (computed == stored) ? ERR_NONE : ERR_CORRUPT;
+}
+
+// ---------------------------------------------------------------------
+int verify_image(const struct pictdb_file* db_file, const size_t index, const uint32_t res)
+{
+    int error = check_image_exists(db_file, index, res);
+    if (error != ERR_NONE)
+        return error;
+
+    const struct pict_metadata *metadata = &db_file->metadata[index];
+    if (metadata->size[res] == 0)
+        return ERR_NONE;
+
+    // Lecture depuis le fichier (jamais depuis le cache)
+    void *buf = buffer_acquire(metadata->size[res]);
+    if (buf == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    if (fseek(db_file->fpdb, (long)metadata->offset[res], SEEK_SET) != 0
+        || fread(buf, metadata->size[res], 1, db_file->fpdb) != 1) {
+        buffer_release(buf);
+        return ERR_IO;
+    }
+
+    stats_add(STAT_BYTES_READ, metadata->size[res]);
+
+    error = check_image_crc(metadata, res, buf, metadata->size[res]);
+    buffer_release(buf);
+
+    return error;
+}
+
 // ---------------------------------------------------------------------
 int check_image_exists(const struct pictdb_file* db_file, const size_t index, const uint32_t res)
 {
@@ -202,3 +409,61 @@ int get_resolution(uint32_t* height, uint32_t* width, const char* image_buffer,
 
     return ERR_NONE;
 }
+
+// ---------------------------------------------------------------------
+int get_resolution_from_file(uint32_t* height, uint32_t* width, FILE* file, uint64_t offset, uint64_t size)
+{
+    unsigned char marker[JPEG_SOF_LENGTH] = { 0 };
+    uint64_t position = 0;
+
+    if (file == NULL || size < 2)
+        return ERR_VIPS;
+
+    // Début d'image (SOI)
+    if (fseek(file, (long)offset, SEEK_SET) != 0 || fread(marker, 2, 1, file) != 1)
+        return ERR_IO;
+
+    if (marker[0] != 0xFF || marker[1] != JPEG_SOI)
+        return ERR_VIPS;
+
+    position = 2;
+
+    // Parcours des segments jusqu'au début de trame (SOFn)
+    while (position + 4 <= size) {
+        if (fseek(file, (long)(offset + position), SEEK_SET) != 0 || fread(marker, 4, 1, file) != 1)
+            return ERR_IO;
+
+        if (marker[0] != 0xFF)
+            return ERR_VIPS;
+
+        // Remplissage : on avance d'un octet
+        if (marker[1] == 0xFF) {
+            position++;
+            continue;
+        }
+
+        const uint16_t length = (uint16_t)(marker[2] << 8 | marker[3]);
+
+        if (marker[1] >= JPEG_SOF0 && marker[1] <= JPEG_SOF15
+            && marker[1] != JPEG_DHT && marker[1] != JPEG_JPG && marker[1] != JPEG_DAC) {
+            if (position + JPEG_SOF_LENGTH > size || length < JPEG_SOF_LENGTH - 2)
+                return ERR_VIPS;
+
+            if (fread(&marker[4], JPEG_SOF_LENGTH - 4, 1, file) != 1)
+                return ERR_IO;
+
+            *height = (uint32_t)(marker[5] << 8 | marker[6]);
+            *width  = (uint32_t)(marker[7] << 8 | marker[8]);
+
+            return (*height == 0 || *width == 0) ? ERR_VIPS : ERR_NONE;
+        }
+
+        // Début des données compressées sans trame : image invalide
+        if (marker[1] == JPEG_SOS || marker[1] == JPEG_EOI || length < 2)
+            return ERR_VIPS;
+
+        position += 2 + (uint64_t)length;
+    }
+
+    return ERR_VIPS;
+}
@@ -8,6 +8,7 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h> // pour FILE
 #include <vips/vips.h>
 
 #include "error.h"
@@ -30,6 +31,20 @@
  */
 int lazily_resize(struct pictdb_file* db_file, const size_t index, const uint32_t res);
 
+/**
+ * @brief Redimensionne une image JPEG à la résolution res de la base (cf.
+ * header.res_resized), sans rien écrire dans la base
+ * @param db_file Base dont la résolution est reprise
+ * @param res Code de la résolution (RES_THUMB, RES_SMALL)
+ * @param buf Image originale
+ * @param len Taille de l'image originale
+ * @param resized Image redimensionnée (JPEG), à libérer avec g_free
+ * @param resized_len Taille de l'image redimensionnée
+ * @return ERR_NONE, ou ERR_VIPS si l'image ne peut être décodée
+ */
+int resize_image(const struct pictdb_file* db_file, const uint32_t res, const void* buf, const size_t len,
+                 void** resized, size_t* resized_len);
+
 /**
  * @brief Computes the shrinking factor (keeping aspect ratio)
  * @param image The image to be resized.
@@ -43,10 +58,34 @@ double resize_ratio(const VipsImage *image, const uint16_t max_width, const uint
  * @param db_file Structure sur laquelle on travaille
  * @param index Position de l'image à récupérer
  * @param res Résolution de l'image
- * @param buf Buffer dans lequel on met l'image
+ * @param buf Buffer dans lequel on met l'image, à rendre avec buffer_release
+ * @return ERR_CORRUPT si db_file->verify_crc est activé et que l'image lue
+ * ne correspond pas à son CRC
  **/
 int fetch_image(const struct pictdb_file* db_file, const size_t index, const uint32_t res, void **buf);
 
+/**
+ * @brief Lis une fenêtre de l'image à la résolution donnée res dans le fichier
+ * de base de donnée, sans lire le reste de l'image.
+ * @param db_file Structure sur laquelle on travaille
+ * @param index Position de l'image à récupérer
+ * @param res Résolution de l'image
+ * @param from Position du premier octet à lire dans l'image
+ * @param length Nombre d'octets à lire
+ * @param buf Buffer dans lequel on met la portion d'image, à rendre avec
+ * buffer_release
+ **/
+int fetch_image_range(const struct pictdb_file* db_file, const size_t index, const uint32_t res,
+                      const uint32_t from, const uint32_t length, void **buf);
+
+/**
+ * @brief Comme fetch_image_range, mais lit la portion d'image dans un buffer
+ * fourni par l'appelant
+ * @param buf Buffer d'au moins length octets
+ **/
+int fetch_image_into(const struct pictdb_file* db_file, const size_t index, const uint32_t res,
+                     const uint32_t from, const uint32_t length, void *buf);
+
 /**
  * @brief Stock le contenu du buffer contenant l'image dans le fichier de base de donnée
  * @param db_file Structure sur laquelle on travaille
@@ -57,6 +96,35 @@ int fetch_image(const struct pictdb_file* db_file, const size_t index, const uin
  */
 int store_image(struct pictdb_file* db_file, const size_t index, const uint32_t res, const void *buf, const uint32_t len);
 
+/**
+ * @brief Enregistre dans la metadata le CRC-32C d'une image (replié sur 16
+ * bits pour les petites images)
+ * @param metadata Metadata de l'image
+ * @param res Résolution de l'image
+ * @param crc CRC-32C de l'image (cf. crc32c)
+ */
+void set_image_crc(struct pict_metadata* metadata, const uint32_t res, const uint32_t crc);
+
+/**
+ * @brief Vérifie le CRC d'une image lue
+ * @param metadata Metadata de l'image
+ * @param res Résolution de l'image
+ * @param buf Contenu de l'image
+ * @param len Taille de l'image
+ * @return ERR_NONE (aussi si aucun CRC n'est connu) ou ERR_CORRUPT
+ */
+int check_image_crc(const struct pict_metadata* metadata, const uint32_t res, const void* buf, const uint32_t len);
+
+/**
+ * @brief Relit une image depuis le fichier (sans passer par le cache) et
+ * vérifie son CRC
+ * @param db_file Structure avec laquelle on travaille
+ * @param index Position de l'image
+ * @param res Résolution de l'image
+ * @return ERR_NONE, ERR_CORRUPT ou code d'erreur de lecture
+ */
+int verify_image(const struct pictdb_file* db_file, const size_t index, const uint32_t res);
+
 /**
  * @brief Vérifie qu'une image à une résolution donnée existe dans le fichier de base de donnée
  * @param db_file Structure avec laquelle on travaille
@@ -74,3 +142,15 @@ int check_image_exists(const struct pictdb_file* db_file, const size_t index, co
  * @return Code d'erreur : 0 ou ERR_VIPS en cas d'erreur de VIPS
  */
 int get_resolution(uint32_t* height, uint32_t* width, const char* image_buffer, size_t image_size);
+
+/**
+ * @brief Récupère la résolution d'une image JPEG stockée dans le fichier de
+ * base de donnée, en ne lisant que ses en-têtes (marqueurs JPEG).
+ * @param height Longueur (Hauteur) de l'image
+ * @param width Largeur de l'image
+ * @param file Fichier de base de donnée
+ * @param offset Position de l'image dans le fichier
+ * @param size Taille de l'image
+ * @return Code d'erreur : 0 ou ERR_VIPS si l'image n'est pas un JPEG valide
+ */
+int get_resolution_from_file(uint32_t* height, uint32_t* width, FILE* file, uint64_t offset, uint64_t size);
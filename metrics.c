@@ -0,0 +1,182 @@
+/**
+ * @file metrics.c
+ * @brief Export des compteurs du serveur au format texte de Prometheus.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdarg.h> // pour va_list
+#include <stdio.h> // pour vsnprintf
+#include <string.h> // pour strncmp
+#include <inttypes.h> // pour PRIu64
+
+#include "metrics.h"
+#include "stats.h"
+
+#define METRICS_FIXED_LINES 48 // lignes hors opérations et volumes
+#define METRICS_OP_LINES 9 // lignes par opération
+#define METRICS_VOLUME_LINES 5 // lignes par volume
+#define NANOSECONDS 1e9
+
+// Document en cours d'écriture
+struct metrics_text {
+    char* text;
+    size_t length;
+    size_t capacity;
+};
+
+/********************************************************************//**
+ * Ajoute une ligne (ou plusieurs) au document ; le texte au-delà de la
+ * capacité est tronqué
+ */
+static void emit(struct metrics_text* out, const char* format, ...)
+{
+    if (out->length >= out->capacity)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(&out->text[out->length], out->capacity - out->length, format, args);
+    va_end(args);
+
+    if (written > 0)
+        out->length += ((size_t)written < out->capacity - out->length) ? (size_t)written : out->capacity - out->length - 1;
+}
+
+/********************************************************************//**
+ * En-têtes HELP et TYPE d'une métrique
+ */
+static void emit_header(struct metrics_text* out, const char* name, const char* type, const char* help)
+{
+    emit(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/********************************************************************//**
+ * Latences (résumé avec quantiles) et erreurs des opérations de first à
+ * last exclu, sous le nom prefix et avec l'étiquette label. Le préfixe
+ * "http." des noms de requêtes est retiré.
+ */
+static void emit_operations(struct metrics_text* out, const char* prefix, const char* label,
+                            enum stat_op first, enum stat_op last)
+{
+    static const char http[] = "http.";
+    const size_t http_length = strlen(http);
+
+    emit(out, "# HELP %s_duration_seconds Latency, in seconds.\n# TYPE %s_duration_seconds summary\n",
+         prefix, prefix);
+
+    for (uint32_t op = first; op < last; op++) {
+        struct stat_summary summary;
+        stats_summary((enum stat_op)op, &summary);
+
+        const char *name = STAT_NAMES[op];
+        if (!strncmp(name, http, http_length))
+            name += http_length;
+
+        emit(out, "%s_duration_seconds{%s=\"%s\",quantile=\"0.5\"} %.9f\n", prefix, label, name, (double)summary.p50 / NANOSECONDS);
+        emit(out, "%s_duration_seconds{%s=\"%s\",quantile=\"0.9\"} %.9f\n", prefix, label, name, (double)summary.p90 / NANOSECONDS);
+        emit(out, "%s_duration_seconds{%s=\"%s\",quantile=\"0.99\"} %.9f\n", prefix, label, name, (double)summary.p99 / NANOSECONDS);
+        emit(out, "%s_duration_seconds{%s=\"%s\",quantile=\"0.999\"} %.9f\n", prefix, label, name, (double)summary.p999 / NANOSECONDS);
+        emit(out, "%s_duration_seconds_sum{%s=\"%s\"} %.9f\n", prefix, label, name, (double)summary.total / NANOSECONDS);
+        emit(out, "%s_duration_seconds_count{%s=\"%s\"} %" PRIu64 "\n", prefix, label, name, summary.count);
+    }
+
+    emit(out, "# HELP %s_errors_total Calls that returned an error.\n# TYPE %s_errors_total counter\n",
+         prefix, prefix);
+
+    for (uint32_t op = first; op < last; op++) {
+        struct stat_summary summary;
+        stats_summary((enum stat_op)op, &summary);
+
+        const char *name = STAT_NAMES[op];
+        if (!strncmp(name, http, http_length))
+            name += http_length;
+
+        emit(out, "%s_errors_total{%s=\"%s\"} %" PRIu64 "\n", prefix, label, name, summary.errors);
+    }
+}
+
+/********************************************************************/
+const char* metrics_prometheus (struct volume_set* set, struct request_arena* arena, size_t* length)
+{
+    struct metrics_text out;
+
+    out.capacity = (METRICS_FIXED_LINES + NB_STATS * METRICS_OP_LINES
+                    + (size_t)set->count * METRICS_VOLUME_LINES * 2) * METRICS_LINE_SIZE;
+    out.length = 0;
+    out.text = request_arena_alloc(arena, out.capacity);
+    if (out.text == NULL)
+        return NULL;
+
+    out.text[0] = '\0';
+
+    // Requêtes HTTP, par handler, puis opérations de la base
+    emit_operations(&out, "pictdb_http_request", "handler", STAT_HTTP_FIRST, NB_STATS);
+    emit_operations(&out, "pictdb_operation", "operation", STAT_OPEN, STAT_HTTP_FIRST);
+
+    // Caches d'images
+    struct image_cache_stats cache;
+    volume_cache_stats(set, &cache);
+
+    const uint64_t lookups = cache.hits + cache.misses;
+
+    emit_header(&out, "pictdb_cache_hits_total", "counter", "Image cache hits.");
+    emit(&out, "pictdb_cache_hits_total %" PRIu64 "\n", cache.hits);
+    emit_header(&out, "pictdb_cache_misses_total", "counter", "Image cache misses.");
+    emit(&out, "pictdb_cache_misses_total %" PRIu64 "\n", cache.misses);
+    emit_header(&out, "pictdb_cache_hit_ratio", "gauge", "Image cache hits over lookups since start.");
+    emit(&out, "pictdb_cache_hit_ratio %.6f\n", (lookups > 0) ? (double)cache.hits / (double)lookups : 0.0);
+    emit_header(&out, "pictdb_cache_evictions_total", "counter", "Images evicted from the image cache.");
+    emit(&out, "pictdb_cache_evictions_total %" PRIu64 "\n", cache.evictions);
+    emit_header(&out, "pictdb_cache_used_bytes", "gauge", "Memory used by cached images.");
+    emit(&out, "pictdb_cache_used_bytes %" PRIu64 "\n", cache.used);
+    emit_header(&out, "pictdb_cache_budget_bytes", "gauge", "Memory budget of the image cache.");
+    emit(&out, "pictdb_cache_budget_bytes %" PRIu64 "\n", cache.budget);
+
+    // Redimensionnements et octets lus/écrits
+    emit_header(&out, "pictdb_resize_queue_depth", "gauge", "Resizes in progress (resizes are done on read).");
+    emit(&out, "pictdb_resize_queue_depth %" PRId64 "\n", stats_gauge(STAT_RESIZE_PENDING));
+    emit_header(&out, "pictdb_read_bytes_total", "counter", "Image bytes read from the database files.");
+    emit(&out, "pictdb_read_bytes_total %" PRIu64 "\n", stats_counter(STAT_BYTES_READ));
+    emit_header(&out, "pictdb_written_bytes_total", "counter", "Image bytes written to the database files.");
+    emit(&out, "pictdb_written_bytes_total %" PRIu64 "\n", stats_counter(STAT_BYTES_WRITTEN));
+
+    // Volumes : remplissage et espace récupérable par gc
+    emit_header(&out, "pictdb_num_files", "gauge", "Pictures stored in the volume.");
+    for (uint32_t i = 0; i < set->count; i++)
+        emit(&out, "pictdb_num_files{volume=\"%" PRIu32 "\"} %" PRIu32 "\n", i, set->volumes[i]->header.num_files);
+
+    emit_header(&out, "pictdb_max_files", "gauge", "Metadata slots of the volume.");
+    for (uint32_t i = 0; i < set->count; i++)
+        emit(&out, "pictdb_max_files{volume=\"%" PRIu32 "\"} %" PRIu32 "\n", i, set->volumes[i]->header.max_files);
+
+    emit_header(&out, "pictdb_utilization_ratio", "gauge", "num_files over max_files.");
+    for (uint32_t i = 0; i < set->count; i++) {
+        const struct pictdb_header *header = &set->volumes[i]->header;
+
+        emit(&out, "pictdb_utilization_ratio{volume=\"%" PRIu32 "\"} %.6f\n", i,
+             (header->max_files > 0) ? (double)header->num_files / (double)header->max_files : 0.0);
+    }
+
+    emit_header(&out, "pictdb_file_size_bytes", "gauge", "Size of the volume file.");
+    for (uint32_t i = 0; i < set->count; i++) {
+        FILE *file = set->volumes[i]->fpdb;
+        long size = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+
+        if (size >= 0)
+            emit(&out, "pictdb_file_size_bytes{volume=\"%" PRIu32 "\"} %ld\n", i, size);
+    }
+
+    emit_header(&out, "pictdb_live_bytes", "gauge", "Bytes of the images still referenced in the volume.");
+    for (uint32_t i = 0; i < set->count; i++) {
+        uint64_t live = 0;
+
+        if (do_live_bytes(set->volumes[i], &live) == ERR_NONE)
+            emit(&out, "pictdb_live_bytes{volume=\"%" PRIu32 "\"} %" PRIu64 "\n", i, live);
+    }
+
+    *length = out.length;
+
+    return out.text;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file metrics.h
+ * @brief Export des compteurs du serveur au format texte de Prometheus.
+ *
+ * Le document reprend les compteurs et latences des opérations et des
+ * requêtes HTTP (cf. stats.h), les compteurs des caches d'images et, pour
+ * chaque volume, le remplissage de la table des metadatas et la taille du
+ * fichier comparée aux octets encore référencés. Les compteurs sont lus
+ * sans verrou : produire le document ne bloque aucune requête.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_METRICS_H
+#define PICTDBPRJ_METRICS_H
+
+#include <stddef.h> // pour size_t
+
+#include "volume.h"
+#include "request_arena.h"
+
+#define METRICS_LINE_SIZE 160 // taille max d'une ligne du document
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Produit le document /metrics
+ * @param set Volumes servis
+ * @param arena Zone de la requête, dans laquelle le document est alloué
+ * @param length Longueur du document
+ * @return Le document, ou NULL si la mémoire manque
+ */
+const char* metrics_prometheus(struct volume_set* set, struct request_arena* arena, size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
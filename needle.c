@@ -0,0 +1,100 @@
+/**
+ * @file needle.c
+ * @brief Écriture et lecture des needles de la zone de données
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <string.h> // pour strlen, memset
+
+#include "needle.h"
+
+/********************************************************************/
+int needle_enabled(const struct pictdb_file* db_file)
+{
+    return db_file->header.ext_offset != 0 && db_file->ext.format_version >= PICTDB_FORMAT_NEEDLES;
+}
+
+/********************************************************************/
+size_t needle_size(const char* pict_id)
+{
+    return sizeof(struct pict_needle) + strlen(pict_id);
+}
+
+/********************************************************************/
+int needle_write(FILE* file, const char* pict_id, uint32_t res, uint32_t flags,
+                 uint32_t size, uint32_t crc, uint64_t link)
+{
+    const size_t id_length = strlen(pict_id);
+    if (id_length == 0 || id_length > MAX_PIC_ID)
+        return ERR_INVALID_PICID;
+
+    struct pict_needle needle;
+    memset(&needle, 0, sizeof(struct pict_needle));
+
+    needle.magic = NEEDLE_MAGIC;
+    needle.res = (uint8_t)res;
+    needle.flags = (uint8_t)flags;
+    needle.id_length = (uint16_t)id_length;
+    needle.size = size;
+    needle.crc = crc;
+    needle.hash = pict_id_hash(pict_id);
+    needle.link = link;
+
+    if (fwrite(&needle, sizeof(struct pict_needle), 1, file) != 1)
+        return ERR_IO;
+
+    if (fwrite(pict_id, id_length, 1, file) != 1)
+        return ERR_IO;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int needle_append_delete(const struct pictdb_file* db_file, const char* pict_id)
+{
+    if (!needle_enabled(db_file))
+        return ERR_NONE;
+
+    if (fseek(db_file->fpdb, 0, SEEK_END) != 0)
+        return ERR_IO;
+
+    return needle_write(db_file->fpdb, pict_id, RES_ORIG, NEEDLE_DELETE, 0, 0, 0);
+}
+
+/********************************************************************/
+int needle_read(FILE* file, uint64_t offset, uint64_t end, struct pict_needle* needle, char* pict_id)
+{
+    if (offset + sizeof(struct pict_needle) > end)
+        return ERR_IO;
+
+    if (fseek(file, (long)offset, SEEK_SET) != 0)
+        return ERR_IO;
+
+    if (fread(needle, sizeof(struct pict_needle), 1, file) != 1)
+        return ERR_IO;
+
+    if (needle->magic != NEEDLE_MAGIC || needle->res >= NB_RES
+        || (needle->flags & ~(NEEDLE_LINK | NEEDLE_DELETE)) != 0
+        || needle->id_length == 0 || needle->id_length > MAX_PIC_ID)
+        return ERR_IO;
+
+    // Les données (sauf partagées ou supprimées) suivent l'identifiant
+    uint64_t size = sizeof(struct pict_needle) + needle->id_length;
+    if (needle->flags == 0)
+        size += needle->size;
+
+    if (offset + size > end)
+        return ERR_IO;
+
+    if (fread(pict_id, needle->id_length, 1, file) != 1)
+        return ERR_IO;
+
+    pict_id[needle->id_length] = '\0';
+
+    if (strlen(pict_id) != needle->id_length || pict_id_hash(pict_id) != needle->hash)
+        return ERR_IO;
+
+    return ERR_NONE;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file needle.h
+ * @brief En-têtes (needles) placés devant chaque image stockée.
+ *
+ * Dans une base au format PICTDB_FORMAT_NEEDLES, chaque écriture dans la
+ * zone de données est précédée d'un needle : un petit en-tête suivi de
+ * l'identifiant de l'image, puis des données elles-mêmes. Les metadatas
+ * pointent toujours sur les données, si bien que la lecture des images
+ * ignore les needles. La zone de données peut en revanche être parcourue
+ * sans la table des metadatas, pour reconstruire celle-ci (do_recover) ou
+ * pour en extraire les images :
+ *
+ *   [needle][pict_id][données] [needle][pict_id][données] ...
+ *
+ * Une image identique à une image déjà stockée (cf. dedup) est décrite par
+ * un needle NEEDLE_LINK sans données, qui désigne les données partagées ;
+ * une suppression laisse un needle NEEDLE_DELETE, sans données non plus.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_NEEDLE_H
+#define PICTDBPRJ_NEEDLE_H
+
+#include <stddef.h> // pour size_t
+#include <stdint.h> // pour uint32_t, uint64_t
+#include <stdio.h> // pour FILE
+
+#include "pictDB.h"
+
+#define NEEDLE_MAGIC 0x4C44454EU // "NEDL" (little endian)
+
+// Valeurs de pict_needle.flags
+#define NEEDLE_LINK   0x1 // pas de données : image partagée, en needle.link
+#define NEEDLE_DELETE 0x2 // pas de données : suppression de l'image
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// En-tête d'une écriture dans la zone de données (32 octets)
+struct pict_needle {
+    // NEEDLE_MAGIC
+    uint32_t magic;
+    // Résolution des données (RES_THUMB, RES_SMALL, RES_ORIG)
+    uint8_t res;
+    // NEEDLE_LINK, NEEDLE_DELETE ou 0
+    uint8_t flags;
+    // Longueur de l'identifiant qui suit le needle (sans '\0')
+    uint16_t id_length;
+    // Taille et CRC-32C des données de l'image
+    uint32_t size;
+    uint32_t crc;
+    // Hash de l'identifiant (cf. pict_id_hash)
+    uint64_t hash;
+    // Position des données partagées (NEEDLE_LINK), sinon 0
+    uint64_t link;
+};
+
+/**
+ * @brief Indique si les images de la base sont précédées de needles
+ * @param db_file Base ouverte
+ */
+int needle_enabled(const struct pictdb_file* db_file);
+
+/**
+ * @brief Taille du needle et de l'identifiant placés devant les données
+ * @param pict_id Identifiant de l'image
+ */
+size_t needle_size(const char* pict_id);
+
+/**
+ * @brief Écrit, à la position courante du fichier, un needle suivi de
+ * l'identifiant. Les données (sauf pour NEEDLE_LINK et NEEDLE_DELETE)
+ * doivent être écrites juste après par l'appelant.
+ * @param file Fichier de la base
+ * @param pict_id Identifiant de l'image
+ * @param res Résolution des données
+ * @param flags NEEDLE_LINK, NEEDLE_DELETE ou 0
+ * @param size Taille des données
+ * @param crc CRC-32C des données (cf. crc32c)
+ * @param link Position des données partagées (NEEDLE_LINK), sinon 0
+ * @return Code d'erreur approprié
+ */
+int needle_write(FILE* file, const char* pict_id, uint32_t res, uint32_t flags,
+                 uint32_t size, uint32_t crc, uint64_t link);
+
+/**
+ * @brief Ajoute à la fin du fichier un needle NEEDLE_DELETE pour pict_id
+ * (rien si la base n'utilise pas les needles)
+ * @param db_file Base ouverte en écriture
+ * @param pict_id Identifiant de l'image supprimée
+ * @return Code d'erreur approprié
+ */
+int needle_append_delete(const struct pictdb_file* db_file, const char* pict_id);
+
+/**
+ * @brief Lit et vérifie le needle situé à la position offset : marque,
+ * résolution, longueur et hash de l'identifiant, taille dans le fichier.
+ * Le CRC des données n'est pas vérifié.
+ * @param file Fichier de la base
+ * @param offset Position du needle
+ * @param end Taille du fichier
+ * @param needle Reçoit le needle
+ * @param pict_id Reçoit l'identifiant (MAX_PIC_ID + 1 octets)
+ * @return ERR_NONE si le needle est valide, ERR_IO sinon
+ */
+int needle_read(FILE* file, uint64_t offset, uint64_t end, struct pict_needle* needle, char* pict_id);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
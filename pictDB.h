@@ -11,6 +11,17 @@
  * sous forme de données brutes à la fin du fichier et addressé par le
  * champ offset de la structure metadata.
  *
+ * Une base extensible (créée avec une taille de page) comporte en plus une
+ * extension du header, pointée par pictdb_header.ext_offset, qui chaîne des
+ * pages de metadatas ajoutées à la fin du fichier lorsque la base est pleine.
+ * Les metadatas sont alors numérotées à la suite : d'abord la table initiale,
+ * puis les pages dans l'ordre de la chaîne.
+ *
+ * À partir de la version PICTDB_FORMAT_NEEDLES de l'extension (qui peut aussi
+ * être présente dans une base de taille fixe, avec ext.page_size nul), chaque
+ * image est précédée d'un needle qui permet de reconstruire les metadatas
+ * depuis la zone de données (cf. needle.h et do_recover).
+ *
  * @author Mia Primorac, Dominique Roduit, Thierry Treyer
  * @date 2 Nov 2015
  */
@@ -31,7 +42,8 @@
 /* constraints */
 #define MAX_DB_NAME 31  // taille max d'un nom de PictDB
 #define MAX_PIC_ID 127  // taille max de l'id d'une image
-#define MAX_MAX_FILES 100000
+#define MAX_MAX_FILES 100000 // taille max de la table initiale (et d'une page)
+#define MAX_TOTAL_FILES 50000000 // nombre max d'images d'une base extensible
 #define MAX_SMALL_RES 512
 #define MAX_THUMB_RES 128
 
@@ -45,6 +57,11 @@
 #define RES_ORIG  2
 #define NB_RES    3
 
+// Versions du format de l'extension du header
+#define PICTDB_FORMAT_PAGES   1 // pages de metadatas
+#define PICTDB_FORMAT_NEEDLES 2 // idem, et needle devant chaque image (cf. needle.h)
+#define PICTDB_FORMAT_VERSION PICTDB_FORMAT_NEEDLES // dernière version connue
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -68,11 +85,41 @@ struct pictdb_header {
 
     // Prévu pour des évolutions futures ou des informations temporaires
     uint32_t unused_32;
+    // Position de l'extension du header (0 : base de taille fixe)
+    uint64_t ext_offset;
+};
+
+// Extension du header d'une base extensible
+struct pictdb_header_ext {
+    // Version du format (PICTDB_FORMAT_VERSION)
+    uint32_t format_version;
+    // Nombre de metadatas de la table initiale, qui suit le header
+    uint32_t initial_files;
+    // Nombre de metadatas par page ajoutée
+    uint32_t page_size;
+    // Nombre de pages ajoutées
+    uint32_t nb_pages;
+    // Positions de la première et de la dernière page (0 : aucune)
+    uint64_t first_page;
+    uint64_t last_page;
+
+    // Prévu pour des évolutions futures
     uint64_t unused_64;
 };
 
-// Métadonnées d'une image
-struct pict_metadata {
+// En-tête d'une page de metadatas, suivi de count metadatas
+struct pict_metadata_page {
+    // Position de la page suivante (0 : dernière page)
+    uint64_t next;
+    // Nombre de metadatas dans la page
+    uint32_t count;
+
+    // Prévu pour des évolutions futures
+    uint32_t unused_32;
+};
+
+// Métadonnées d'une image, telles qu'écrites dans le fichier
+struct pict_metadata_disk {
     // Identificateur unique (nom) de l'image
     char pict_id[MAX_PIC_ID + 1];
     // Hash code de l'image
@@ -81,6 +128,8 @@ struct pict_metadata {
     uint32_t res_orig[2];
     // Tailles mémoire (en octets) des images aux différentes résolutions
     uint32_t size[NB_RES];
+    // CRC-32C de l'image originale (0 : pas calculé)
+    uint32_t crc_orig;
     // positions dans le fichier des images aux différentes résolutions
     uint64_t offset[NB_RES];
     // Indique si l'image est encore utilisée (NON_EMPTY) ou effacée (EMPTY)
@@ -88,6 +137,180 @@ struct pict_metadata {
 
     // Prévu pour des évolutions futures ou informations temporaires
     uint16_t unused_16;
+
+    // CRC-32C des petites images (RES_THUMB, RES_SMALL) replié sur 16 bits
+    // (0 : pas calculé). Les CRC occupent les octets d'alignement de la
+    // structure, dont la taille (216 octets) ne change pas.
+    uint16_t crc_resized[NB_RES - 1];
+};
+
+// Métadonnées d'une image en mémoire : comme pict_metadata_disk, mais
+// l'identifiant est rangé dans la zone des identifiants de la base (cf.
+// pict_id_intern) ; 96 octets au lieu de 216
+struct pict_metadata {
+    // Identificateur unique (nom) de l'image (NULL si la metadata est vide)
+    const char* pict_id;
+    // Hash code de l'image
+    unsigned char SHA[SHA256_DIGEST_LENGTH];
+    // Résolution de l'image d'origine
+    uint32_t res_orig[2];
+    // Tailles mémoire (en octets) des images aux différentes résolutions
+    uint32_t size[NB_RES];
+    // CRC-32C de l'image originale (0 : pas calculé)
+    uint32_t crc_orig;
+    // positions dans le fichier des images aux différentes résolutions
+    uint64_t offset[NB_RES];
+    // Indique si l'image est encore utilisée (NON_EMPTY) ou effacée (EMPTY)
+    uint16_t is_valid;
+
+    // Prévu pour des évolutions futures ou informations temporaires
+    uint16_t unused_16;
+
+    // CRC-32C des petites images (RES_THUMB, RES_SMALL) replié sur 16 bits
+    // (0 : pas calculé)
+    uint16_t crc_resized[NB_RES - 1];
+};
+
+// État d'une insertion en flux (image reçue morceau par morceau)
+struct insert_stream {
+    // Base d'images dans laquelle l'image est insérée
+    struct pictdb_file* db_file;
+    // Identificateur de l'image en cours d'insertion
+    char pict_id[MAX_PIC_ID + 1];
+    // Fichier temporaire recevant l'image jusqu'à do_insert_end
+    FILE* staging;
+    // Position dans la base du premier octet de l'image (cf. do_insert_end)
+    uint64_t offset;
+    // Nombre d'octets déjà reçus
+    uint64_t size;
+    // Taille du needle qui précède l'image (0 si la base n'en a pas)
+    uint64_t needle;
+    // CRC-32C calculé au fur et à mesure de la réception
+    uint32_t crc;
+};
+
+struct image_cache; // cf. image_cache.h
+struct sidecar; // cf. sidecar.h
+struct id_block; // cf. db_arena.c
+
+// Liste JSON des images déjà sérialisée, valable pour une version de la base
+struct list_cache {
+    // Document JSON (NULL si la liste n'a pas encore été construite)
+    char* json;
+    // Longueur du document et taille du buffer alloué
+    size_t length;
+    size_t capacity;
+    // Nombre d'images dans la liste
+    uint32_t count;
+    // Position dans la base de la dernière image de la liste, plus un
+    uint32_t end;
+    // Version de la base (header.db_version) pour laquelle la liste est valable
+    uint32_t version;
+};
+
+// Entrée de l'index trié des identifiants d'images
+struct id_index_entry {
+    // Identifiant (pointe dans les metadatas de la base)
+    const char* pict_id;
+    // Position de l'image dans les metadatas
+    uint32_t index;
+};
+
+// Index des images trié par identifiant, valable pour une version de la base
+struct id_index {
+    // Entrées triées par pict_id (NULL si l'index n'a pas été construit)
+    struct id_index_entry* entries;
+    uint32_t count;
+    uint32_t capacity;
+    // Version de la base (header.db_version) pour laquelle l'index est valable
+    uint32_t version;
+};
+
+// Champs des metadatas lus par les parcours complets, un tableau par champ
+// (cf. db_scan.c), valables pour une version de la base
+struct meta_scan {
+    // Bitmap des positions occupées (NULL si pas construite) ; les autres
+    // tableaux suivent dans le même bloc et ne sont valables que pour les
+    // positions occupées
+    uint64_t* valid;
+    // Hash des identifiants (cf. pict_id_hash)
+    uint64_t* id_hash;
+    // 8 premiers octets des SHA (nuls si le SHA est en attente)
+    uint64_t* sha_prefix;
+    // Taille et CRC (crc_orig) des originaux
+    uint32_t* size;
+    uint32_t* crc;
+    // Nombre de positions (header.max_files)
+    uint32_t count;
+    // Version de la base (header.db_version) pour laquelle elle est valable
+    uint32_t version;
+};
+
+// Champs optionnels d'une liste paginée
+#define LIST_FIELD_SIZES      0x1 // tailles des différentes résolutions
+#define LIST_FIELD_RESOLUTION 0x2 // dimensions de l'image originale
+#define LIST_FIELD_VARIANTS   0x4 // résolutions déjà présentes dans la base
+
+// Paramètres d'une liste paginée et filtrée
+struct list_query {
+    // Curseur : seules les images d'identifiant strictement supérieur sont listées (NULL : début)
+    const char* after;
+    // Seules les images dont l'identifiant commence par prefix sont listées (NULL : toutes)
+    const char* prefix;
+    // Nombre maximal d'images listées (0 : pas de limite)
+    uint32_t limit;
+    // Champs optionnels (LIST_FIELD_*) ajoutés à chaque image en mode JSON
+    uint32_t fields;
+};
+
+// Bilan de la vérification d'une base (cf. do_verify)
+struct verify_report {
+    // Images valides
+    uint32_t images;
+    // Threads utilisés pour relire les données
+    uint32_t threads;
+    // Blocs de données (distincts) relus et leur taille totale
+    uint64_t extents;
+    uint64_t bytes;
+    // Problèmes détectés, signalés sur stdout
+    uint32_t problems;
+};
+
+// Loi de la taille des images d'une base synthétique (cf. do_gen)
+enum gen_size_dist {
+    GEN_SIZE_FIXED, // toutes de la taille moyenne
+    GEN_SIZE_UNIFORM, // uniforme entre la moitié et une fois et demie la moyenne
+    GEN_SIZE_EXP // exponentielle : beaucoup de petites images, quelques grandes
+};
+
+// Paramètres d'une base synthétique (cf. do_gen) ; les ratios sont en %
+struct gen_params {
+    // Images écrites (y compris celles ensuite effacées)
+    uint32_t count;
+    // Taille moyenne des originaux (au moins celle de l'image de base) et sa loi
+    uint32_t size;
+    enum gen_size_dist size_dist;
+    // Images identiques à une image précédente (partageant ses données)
+    uint32_t dup_ratio;
+    // Images dont les variantes (thumb et small) sont déjà écrites
+    uint32_t variant_ratio;
+    // Images effacées après leur écriture (positions libres, données à récupérer par gc)
+    uint32_t deleted_ratio;
+    // Graine du générateur pseudo-aléatoire (même graine : même base)
+    uint64_t seed;
+};
+
+// Bilan d'une base synthétique (cf. do_gen)
+struct gen_report {
+    // Images valides à la fin
+    uint32_t pictures;
+    // Duplicatas et images avec variantes écrits (y compris ceux ensuite effacés)
+    uint32_t duplicates;
+    uint32_t variants;
+    // Images effacées
+    uint32_t deleted;
+    // Octets écrits dans la zone de données
+    uint64_t bytes;
 };
 
 struct pictdb_file {
@@ -95,8 +318,33 @@ struct pictdb_file {
     FILE* fpdb;
     // Informations générales de la base d'images
     struct pictdb_header header;
-    // Métadata des images dans la base
+    // Extension du header (si header.ext_offset != 0)
+    struct pictdb_header_ext ext;
+    // Métadata des images dans la base (table initiale puis pages)
     struct pict_metadata* metadata;
+    // Zone des identifiants pointés par les metadatas (cf. pict_id_intern)
+    struct id_block* id_blocks;
+    // Blocs de metadatas déjà lus d'une base ouverte par do_open_lazy (NULL
+    // si toutes les metadatas sont lues)
+    uint8_t* loaded;
+    // Positions dans le fichier des pages de metadatas (ext.nb_pages)
+    uint64_t* pages;
+    // Cache des images lues (NULL si désactivé), libéré par do_close
+    struct image_cache* cache;
+    // Liste JSON des images, reconstruite seulement si la base a changé
+    struct list_cache list;
+    // Index trié des identifiants (construit à la demande par id_index_build)
+    struct id_index ids;
+    // Champs des metadatas pour les parcours (construits par meta_scan_build)
+    struct meta_scan scan;
+    // Fichier d'index projeté en mémoire (NULL si non ouvert), cf. sidecar.h
+    struct sidecar* sidecar;
+    // Vérifie le CRC des images lues depuis le fichier (cf. fetch_image)
+    int verify_crc;
+    // Octets occupés par les images référencées (cf. do_live_bytes), valables
+    // tant que la base est à la version live_version
+    uint64_t live_bytes;
+    uint32_t live_version;
 };
 
 /**
@@ -114,17 +362,168 @@ void print_header (const struct pictdb_header* header);
 void print_metadata (const struct pict_metadata* metadata);
 
 /**
- * @brief Affiche (sur stdout) les informations de la pictDB.
+ * @brief Affiche (sur stdout) les informations de la pictDB, ou retourne la
+ * liste des images au format JSON (cf. do_list_json).
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param mode STDOUT ou JSON
+ * @return La liste JSON en mode JSON, NULL sinon
+ */
+const char* do_list (struct pictdb_file* db_file, enum do_list_mode mode);
+
+/**
+ * @brief Retourne la liste des images au format JSON. La liste est gardée en
+ * cache dans db_file et n'est reconstruite que si header.db_version a changé
+ * depuis sa dernière construction ; les insertions la complètent directement.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param length Si non NULL, reçoit la longueur du document
+ * @return Le document JSON, appartenant à db_file et valable jusqu'à la
+ *         prochaine modification de la base ou à do_close ; NULL en cas d'erreur
+ */
+const char* do_list_json (struct pictdb_file* db_file, size_t* length);
+
+/**
+ * @brief Ajoute une image à la liste JSON en cache, si celle-ci était à jour
+ * avant l'insertion et que l'image est placée après toutes celles de la
+ * liste. Sinon la liste sera reconstruite lors de sa prochaine lecture : la
+ * liste suit toujours l'ordre des images dans la base.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param index Position de l'image insérée
+ * @param previous_version Version de la base avant l'insertion
+ */
+void list_cache_add (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version);
+
+/**
+ * @brief Liste une page d'images, dans l'ordre des identifiants, à partir
+ * de l'index trié (construit si nécessaire).
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param mode STDOUT (affichage des metadatas) ou JSON
+ * @param query Pagination, filtre et champs optionnels
+ * @return En mode JSON, un document { "Pictures": [...], "next": curseur }
+ *         alloué dynamiquement (à libérer par l'appelant) ; "next" n'est
+ *         présent que s'il reste des images. NULL sinon ou en cas d'erreur.
+ */
+const char* do_list_page (struct pictdb_file* db_file, enum do_list_mode mode, const struct list_query* query);
+
+/**
+ * @brief Comme do_list_page, pour l'ensemble des images de plusieurs bases
+ * (fusion de leurs index triés).
+ *
+ * @param db_files Tableau des bases
+ * @param count Nombre de bases
+ * @param mode STDOUT (affichage des metadatas) ou JSON
+ * @param query Pagination, filtre et champs optionnels
+ * @return cf. do_list_page
+ */
+const char* do_list_page_multi (struct pictdb_file* const* db_files, uint32_t count, enum do_list_mode mode, const struct list_query* query);
+
+/**
+ * @brief Construit (si nécessaire) l'index des images trié par identifiant.
+ * L'index est ensuite mis à jour par les insertions et suppressions.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @return Code d'erreur approprié
+ */
+int id_index_build (struct pictdb_file* db_file);
+
+/**
+ * @brief Hash (FNV-1a 64 bits) d'un identifiant d'image
+ *
+ * @param pict_id Identifiant de l'image
+ * @return Hash de l'identifiant
+ */
+uint64_t pict_id_hash (const char* pict_id);
+
+/**
+ * @brief Recherche une image par son identifiant, dans le fichier d'index
+ * ou par dichotomie dans l'index trié s'ils sont à jour, sinon en
+ * parcourant les metadatas.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param pict_id Identifiant recherché
+ * @param index Reçoit la position de l'image dans les metadatas
+ * @return ERR_NONE ou ERR_FILE_NOT_FOUND
+ */
+int find_pict_id (struct pictdb_file* db_file, const char* pict_id, uint32_t* index);
+
+/**
+ * @brief Ajoute une image à l'index trié, si celui-ci était à jour avant
+ * l'insertion (header.db_version déjà incrémenté).
  *
  * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param index Position de l'image insérée dans les metadatas
+ * @param previous_version Version de la base avant l'insertion
  */
-const char* do_list (const struct pictdb_file* db_file, enum do_list_mode mode);
+void id_index_add (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version);
+
+/**
+ * @brief Retire une image de l'index trié, si celui-ci était à jour avant
+ * la suppression. Doit être appelée avant l'effacement de la metadata.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param index Position de l'image supprimée dans les metadatas
+ * @param previous_version Version de la base avant la suppression
+ */
+void id_index_remove (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version);
+
+/**
+ * @brief Position, dans l'index trié (à jour), de la première image de la
+ * page décrite par query (après le curseur et au début du préfixe).
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param query Pagination et filtre
+ * @return Position dans db_file->ids.entries
+ */
+uint32_t id_index_page_start (const struct pictdb_file* db_file, const struct list_query* query);
+
+/**
+ * @brief Construit (si nécessaire) la représentation compacte des metadatas
+ * utilisée par les parcours complets. Elle est ensuite mise à jour par
+ * meta_scan_update.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @return Code d'erreur approprié
+ */
+int meta_scan_build (struct pictdb_file* db_file);
+
+/**
+ * @brief Recopie une metadata modifiée dans la représentation compacte, si
+ * celle-ci était à jour avant la modification.
+ *
+ * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param index Position de la metadata modifiée
+ * @param previous_version Version de la base avant la modification (la
+ *        version courante si elle n'a pas changé)
+ */
+void meta_scan_update (struct pictdb_file* db_file, uint32_t index, uint32_t previous_version);
+
+/**
+ * @brief Position suivante occupée (ou libre) dans la représentation compacte
+ *
+ * @param scan Représentation compacte construite
+ * @param from Première position examinée
+ * @param valid 1 pour chercher une position occupée, 0 une position libre
+ * @return Position trouvée, ou scan->count s'il n'y en a pas
+ */
+uint32_t meta_scan_next (const struct meta_scan* scan, uint32_t from, int valid);
+
+/**
+ * @brief Libère la représentation compacte des metadatas
+ * @param db_file Structure la contenant
+ */
+void meta_scan_free (struct pictdb_file* db_file);
 
 /**
  * @brief Crée une base de données nommée filename. Écrit l'en-tête et
  *        pré-alloue un tableau de metadatas vide dans le fichier.
  *
- * @param db_file Structure contenant l'en-tête et les metadatas.
+ * @param db_file Structure contenant l'en-tête et les metadatas. Si
+ *        ext.page_size n'est pas nul, la base est extensible par pages de
+ *        ext.page_size metadatas. Si ext.format_version vaut
+ *        PICTDB_FORMAT_NEEDLES, les images sont précédées de needles.
  */
 int do_create(const char* filename, struct pictdb_file* db_file);
 
@@ -137,6 +536,37 @@ int do_create(const char* filename, struct pictdb_file* db_file);
  */
 int do_open(const char* db_filename, const char* mode, struct pictdb_file* db_file);
 
+/**
+ * @brief Comme do_open, mais les metadatas ne sont lues qu'à la demande,
+ * par blocs (cf. metadata_load) : une image est retrouvée par le fichier
+ * d'index (cf. sidecar.h) sans lire toute la table. Les fonctions qui
+ * parcourent toutes les metadatas pour les modifier (index, insertion, gc)
+ * les lisent d'abord toutes ; do_list, do_verify et do_write demandent une
+ * base ouverte par do_open.
+ * @param db_filename Nom de fichier de la base d'image
+ * @param mode Mode d'ouverture du fichier
+ * @param db_file Structure dans laquelle stocker les données lues
+ * @return 0 si pas d'erreur, sinon le code d'erreur approprié (cf. error.h)
+ */
+int do_open_lazy(const char* db_filename, const char* mode, struct pictdb_file* db_file);
+
+/**
+ * @brief Lit (si nécessaire) le bloc de metadatas contenant index, pour une
+ * base ouverte par do_open_lazy
+ * @param db_file Base ouverte
+ * @param index Position de la metadata
+ * @return Code d'erreur approprié
+ */
+int metadata_load(struct pictdb_file* db_file, uint32_t index);
+
+/**
+ * @brief Lit toutes les metadatas pas encore lues ; la base se comporte
+ * ensuite comme si elle avait été ouverte par do_open
+ * @param db_file Base ouverte
+ * @return Code d'erreur approprié
+ */
+int metadata_load_all(struct pictdb_file* db_file);
+
 /**
  * @brief Ferme le fichier contenu par la structure db_file
  * @param db_file Structure contenant le fichier à fermer
@@ -149,6 +579,58 @@ void do_close(struct pictdb_file* db_file);
  */
 int do_write(const struct pictdb_file* db_file, size_t *items_written);
 
+/**
+ * @brief Écrit le header et une seule metadata sur le disque
+ * @param db_file Structure contenant le header et les metadatas
+ * @param index Position de la metadata à écrire
+ * @return Code d'erreur approprié
+ */
+int do_write_entry(const struct pictdb_file* db_file, uint32_t index);
+
+/**
+ * @brief Ajoute une page de ext.page_size metadatas vides à la fin du
+ * fichier et la chaîne aux précédentes. Les pointeurs sur les metadatas
+ * sont invalidés (réallocation).
+ * @param db_file Base extensible
+ * @return ERR_FULL_DATABASE si la base n'est pas extensible ou a atteint
+ *         MAX_TOTAL_FILES, sinon code d'erreur approprié
+ */
+int metadata_grow(struct pictdb_file* db_file);
+
+/**
+ * @brief Octets occupés dans le fichier par les images encore référencées
+ * (toutes résolutions, une image partagée par plusieurs identifiants n'étant
+ * comptée qu'une fois). Le résultat est gardé jusqu'à la prochaine
+ * modification de la base ; les images redimensionnées entre temps y sont
+ * ajoutées par store_image.
+ * @param db_file Base ouverte
+ * @param live Octets référencés
+ * @return Code d'erreur approprié
+ */
+int do_live_bytes(struct pictdb_file* db_file, uint64_t* live);
+
+/**
+ * @brief Copie un identifiant d'image dans la zone des identifiants de la
+ * base, où il ne change plus de place jusqu'à do_close
+ * @param db_file Base à laquelle appartient l'identifiant
+ * @param pict_id Identifiant (pas forcément terminé par '\0')
+ * @param length Longueur de l'identifiant
+ * @return Copie de l'identifiant, ou NULL si la mémoire manque
+ */
+const char* pict_id_intern (struct pictdb_file* db_file, const char* pict_id, size_t length);
+
+/**
+ * @brief Libère la zone des identifiants d'une base
+ * @param db_file Base dont les metadatas ne sont plus utilisées
+ */
+void pict_id_arena_free (struct pictdb_file* db_file);
+
+/**
+ * @brief Libère l'index trié des identifiants (reconstruit à la demande)
+ * @param db_file Structure contenant l'index
+ */
+void id_index_free(struct pictdb_file* db_file);
+
 /**
  * @brief Supprime l'image spécifiée par son identifiant id dans db_file
  * @param id Identifiant de l'image à supprimer
@@ -165,11 +647,22 @@ int do_delete(const char* id, struct pictdb_file* db_file);
  */
 int resolution_atoi(const char* res);
 
+/**
+ * @brief Prépare la lecture d'une image : recherche son entrée dans les
+ * metadatas et créé si nécessaire la résolution demandée.
+ * @param pict_id Identifiant d'image
+ * @param res Code d'une résolution d'image
+ * @param index Position de l'image dans le tableau de metadatas
+ * @param db_file Structure de laquelle on lira l'image
+ * @return Code d'erreur approprié
+ */
+int do_read_prepare(const char* pict_id, uint32_t res, uint32_t* index, struct pictdb_file* db_file);
+
 /**
  * @brief Lis une image dans la pictDB
  * @param pict_id Identifiant d'image
  * @param res Code d'une résolution d'image
- * @param image_buffer Adresse de l'image en mémoire
+ * @param image_buffer Adresse de l'image en mémoire, à rendre avec buffer_release
  * @param image_size Taille de l'image
  * @param db_file Structure de laquelle on lira l'image
  * @return Code d'erreur approprié
@@ -186,6 +679,54 @@ int do_read(const char* pict_id, uint32_t res, char** image_buffer, uint32_t* im
  */
 int do_insert(const char* img, size_t size, const char* pict_id, struct pictdb_file* db_file);
 
+/**
+ * @brief Comme do_insert, avec le SHA-256 de l'image déjà calculé (p.ex.
+ * par sha256_batch, ou repris de la base nettoyée par do_gbcollect)
+ * @param sha SHA-256 de img (NULL : calculé seulement si la dé-duplication
+ * trouve une image de même empreinte, sinon laissé en attente, cf. fill_sha)
+ * @return Code d'erreur approprié
+ */
+int do_insert_hashed(const char* img, size_t size, const char* pict_id, const unsigned char* sha,
+                     struct pictdb_file* db_file);
+
+/**
+ * @brief Débute l'insertion en flux d'une image dont le contenu sera reçu
+ * morceau par morceau. Les morceaux sont écrits dans un fichier temporaire
+ * et leur CRC calculé au fur et à mesure : la mémoire utilisée ne dépend
+ * pas de la taille de l'image, et plusieurs insertions peuvent être en
+ * cours sur la même base.
+ * @param pict_id Identifiant d'image
+ * @param db_file Structure dans laquelle on ajoutera l'image
+ * @param stream État de l'insertion à initialiser
+ * @return Code d'erreur approprié
+ */
+int do_insert_begin(const char* pict_id, struct pictdb_file* db_file, struct insert_stream* stream);
+
+/**
+ * @brief Ajoute un morceau du contenu de l'image en cours d'insertion
+ * @param stream État de l'insertion
+ * @param data Morceau de l'image
+ * @param len Taille du morceau
+ * @return Code d'erreur approprié
+ */
+int do_insert_append(struct insert_stream* stream, const void* data, size_t len);
+
+/**
+ * @brief Termine l'insertion en flux : recopie l'image d'un seul tenant à la
+ * fin de la base, la dé-duplique (son SHA n'est calculé, en la relisant, que
+ * si une image de même empreinte existe) et écrit ses metadatas.
+ * @param stream État de l'insertion
+ * @return Code d'erreur approprié
+ */
+int do_insert_end(struct insert_stream* stream);
+
+/**
+ * @brief Abandonne une insertion en flux : les octets reçus, qui n'ont pas
+ * été écrits dans la base, sont libérés avec le fichier temporaire.
+ * @param stream État de l'insertion
+ */
+void do_insert_abort(struct insert_stream* stream);
+
 /**
  * @brief Nettoye la base d'images en collectant l'espace libre d'une pictDB.
  * @param src  La structure pictdb_file source
@@ -195,6 +736,50 @@ int do_insert(const char* img, size_t size, const char* pict_id, struct pictdb_f
  */
 int do_gbcollect(struct pictdb_file* src, const char* src_name, const char* tmp_name);
 
+/**
+ * @brief Reconstruit les metadatas d'une base au format PICTDB_FORMAT_NEEDLES
+ * en parcourant séquentiellement sa zone de données. Le header et son
+ * extension doivent être intacts ; les pages de metadatas existantes sont
+ * abandonnées (et récupérées par le garbage collecting), de nouvelles pages
+ * étant ajoutées au besoin.
+ * @param filename Nom du fichier de la base
+ * @param db_file Reçoit la base reconstruite, ouverte en écriture
+ * @return Code d'erreur approprié
+ */
+int do_recover(const char* filename, struct pictdb_file* db_file);
+
+/**
+ * @brief Vérifie une base ouverte : invariants du header, identifiants et
+ * positions des images (bornes du fichier, chevauchements), puis relit en
+ * parallèle toutes les données, dans l'ordre du fichier, pour vérifier
+ * leur CRC, le SHA des originaux et le décodage des petites images.
+ * Chaque problème est signalé sur stdout.
+ * @param db_file Base ouverte (en lecture suffit)
+ * @param nb_threads Nombre de threads de lecture (0 : un par cœur)
+ * @param report Reçoit le bilan de la vérification
+ * @return Code d'erreur approprié (ERR_NONE même si des problèmes ont été
+ *         détectés, cf. report->problems)
+ */
+int do_verify(const struct pictdb_file* db_file, uint32_t nb_threads, struct verify_report* report);
+
+/**
+ * @brief Crée une base synthétique de params->count images, dérivées de
+ * l'image JPEG seed : chaque original est seed suivie d'octets qui lui sont
+ * propres (ignorés par les décodeurs), jusqu'à la taille tirée. Les données
+ * sont écrites séquentiellement, sans relecture, et les metadatas une seule
+ * fois à la fin. Les identifiants sont "pic" suivi du numéro de l'image.
+ * @param filename Nom du fichier de la base (remplacé s'il existe)
+ * @param db_file Header à utiliser (comme pour do_create), puis base créée,
+ *        ouverte en écriture
+ * @param seed_data Image JPEG de base
+ * @param seed_size Taille de l'image de base
+ * @param params Paramètres de la base
+ * @param report Reçoit le bilan de la génération
+ * @return Code d'erreur approprié
+ */
+int do_gen(const char* filename, struct pictdb_file* db_file, const void* seed_data, size_t seed_size,
+           const struct gen_params* params, struct gen_report* report);
+
 /**
  * @brief Créé un nom suivant les conventions de nommages
  * original_prefix + resolution_suffix + '.jpg'
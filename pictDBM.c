@@ -14,6 +14,14 @@
 
 #include "pictDB.h"
 #include "pictDBM_tools.h"
+#include "volume.h"
+#include "sha256.h"
+#include "buffer_pool.h"
+#include "stats.h"
+#include "trace.h"
+
+#define INSERT_BATCH 64 // images lues et hachées ensemble par la commande insert
+#define GEN_DEFAULT_COUNT 1000 // images d'une base synthétique
 
 #define LAST_COMMAND_MAPPING(cmd) \
     (cmd.name == NULL || cmd.function == NULL)
@@ -25,6 +33,9 @@ int do_delete_cmd (int argc, char* argv[]);
 int do_insert_cmd (int argc, char* argv[]);
 int do_read_cmd (int argc, char* argv[]);
 int do_gc_cmd (int argc, char *argv[]);
+int do_recover_cmd (int argc, char *argv[]);
+int do_verify_cmd (int argc, char *argv[]);
+int do_gen_cmd (int argc, char *argv[]);
 
 typedef int (*command)(int argc, char* argv[]);
 
@@ -45,6 +56,9 @@ const command_mapping commands[] = {
     { "insert", do_insert_cmd },
     { "read", do_read_cmd },
     { "gc", do_gc_cmd },
+    { "recover", do_recover_cmd },
+    { "verify", do_verify_cmd },
+    { "gen", do_gen_cmd },
     { NULL, NULL }
 };
 
@@ -58,7 +72,29 @@ int main (int argc, char* argv[])
     if (VIPS_INIT(argv[0]))
         vips_error_exit("unable to start VIPS");
 
-    if (argc < 2) {
+    // Options globales : compteurs et latences affichés, étapes tracées
+    // écrites après la commande
+    int print_stats = 0;
+    const char *trace_file = NULL;
+    while (argc >= 2 && ret == ERR_NONE) {
+        if (!strcmp(argv[1], "-stats")) {
+            print_stats = 1;
+        } else if (!strcmp(argv[1], "-trace") && argc >= 3) {
+            trace_file = argv[2];
+            ret = trace_enable(TRACE_DEFAULT_EVENTS);
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+
+        argc--;
+        argv++;
+    }
+
+    if (ret != ERR_NONE) {
+        // Traces impossibles à activer
+    } else if (argc < 2) {
         ret = ERR_NOT_ENOUGH_ARGUMENTS;
     } else {
         argc--;
@@ -86,13 +122,22 @@ int main (int argc, char* argv[])
         (void)help(argc, argv);
     }
 
+    if (print_stats)
+        stats_print(stderr);
+
+    if (trace_file != NULL && trace_dump(trace_file) != ERR_NONE)
+        fprintf(stderr, "ERROR: cannot write trace to %s\n", trace_file);
+
+    trace_free();
+    buffer_pool_flush();
     vips_shutdown();
 
     return ret;
 }
 
 /********************************************************************//**
- * Ouvre le fichier pictDB et appel la commande do_list.
+ * Ouvre le fichier pictDB et appel la commande do_list (ou do_list_page
+ * si une pagination ou un filtre est demandé).
  ********************************************************************** */
 int do_list_cmd (int argc, char* argv[])
 {
@@ -100,15 +145,56 @@ int do_list_cmd (int argc, char* argv[])
         return ERR_NOT_ENOUGH_ARGUMENTS;
 
     const char* filename = argv[1];
-    struct pictdb_file myfile;
 
-    int retval = do_open(filename, "rb", &myfile);
+    struct list_query query = { NULL, NULL, 0, 0 };
+    int paged = 0;
+    enum do_list_mode mode = STDOUT;
+
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-json")) {
+            mode = JSON;
+            query.fields = LIST_FIELD_SIZES | LIST_FIELD_RESOLUTION | LIST_FIELD_VARIANTS;
+        } else if (i + 1 >= argc) {
+            return ERR_NOT_ENOUGH_ARGUMENTS;
+        } else if (!strcmp(argv[i], "-limit")) {
+            query.limit = atouint32(argv[++i]);
+
+            if (query.limit == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(argv[i], "-after")) {
+            query.after = argv[++i];
+        } else if (!strcmp(argv[i], "-prefix")) {
+            query.prefix = argv[++i];
+        } else {
+            return ERR_INVALID_ARGUMENT;
+        }
+
+        paged = 1;
+    }
+
+    struct volume_set volumes;
+
+    int retval = volume_open(filename, "rb", &volumes);
     if (retval != ERR_NONE)
         return retval;
 
-    do_list(&myfile, STDOUT);
+    if (!paged) {
+        for (uint32_t i = 0; i < volumes.count; i++)
+            do_list(volumes.volumes[i], STDOUT);
+    } else {
+        const char *page = volume_list_page(&volumes, mode, &query);
 
-    do_close(&myfile);
+        if (mode == JSON) {
+            if (page != NULL)
+                puts(page);
+            else
+                retval = ERR_OUT_OF_MEMORY;
+        }
+
+        free((char*)page);
+    }
+
+    volume_close(&volumes);
 
     return retval;
 }
@@ -125,6 +211,9 @@ int do_create_cmd (int argc, char* argv[])
 
     // Valeurs par défaut
     uint32_t max_files = 10;
+    uint32_t page_size = 0; // base de taille fixe
+    uint32_t format_version = PICTDB_FORMAT_PAGES; // sans needles
+    int volumes = 0;
     uint16_t thumb_res[2] = { 64, 64 };
     uint16_t small_res[2] = { 256, 256 };
 
@@ -141,6 +230,22 @@ int do_create_cmd (int argc, char* argv[])
                 return ERR_MAX_FILES;
 
             i = mfi;
+        } else if (!strcmp(argv[i], "-page_size")) {
+            int psi = i + 1; // Page Size Index
+
+            if (psi >= argc)
+                return ERR_NOT_ENOUGH_ARGUMENTS;
+
+            page_size = atouint32(argv[psi]);
+
+            if (page_size <= 0 || page_size > MAX_MAX_FILES)
+                return ERR_MAX_FILES;
+
+            i = psi;
+        } else if (!strcmp(argv[i], "-volumes")) {
+            volumes = 1;
+        } else if (!strcmp(argv[i], "-needles")) {
+            format_version = PICTDB_FORMAT_NEEDLES;
         } else if (!strcmp(argv[i], "-small_res")) {
             int sxri = i + 1, syri = i + 2; // Small X/Y Res Index
 
@@ -180,13 +285,15 @@ int do_create_cmd (int argc, char* argv[])
 
     struct pictdb_file db_file;
     db_file.header.max_files = max_files;
+    db_file.ext.page_size = page_size;
+    db_file.ext.format_version = format_version;
 
     db_file.header.res_resized[0] = thumb_res[0];
     db_file.header.res_resized[1] = thumb_res[1];
     db_file.header.res_resized[2] = small_res[0];
     db_file.header.res_resized[3] = small_res[1];
 
-    int retval = do_create(filename, &db_file);
+    int retval = volumes ? volume_create(filename, &db_file) : do_create(filename, &db_file);
 
     if (retval == ERR_NONE) {
         print_header(&db_file.header);
@@ -202,14 +309,32 @@ int do_create_cmd (int argc, char* argv[])
  ********************************************************************** */
 int help (int argc, char* argv[])
 {
-    printf("pictDBM [COMMAND] [ARGUMENTS]\n");
+    printf("pictDBM [-stats] [-trace <file>] [COMMAND] [ARGUMENTS]\n");
+    printf("  -stats: print the count and latency of each database operation on stderr\n");
+    printf("          once the command is done.\n");
+    printf("  -trace <file>: write the steps of the command (lookup, fetch, VIPS\n");
+    printf("          load/resize/save, store, write) to file, in Chrome trace-event\n");
+    printf("          JSON (chrome://tracing, Perfetto), once the command is done.\n");
     printf("  help: displays this help.\n");
-    printf("  list <dbfilename>: list pictDB content.\n");
+    printf("  list <dbfilename> [options]: list pictDB content.\n");
+    printf("      options are:\n");
+    printf("          -limit <N>: list at most N pictures, sorted by pictID.\n");
+    printf("          -after <pictID>: list pictures after pictID (cursor of the previous page).\n");
+    printf("          -prefix <prefix>: list only pictures whose pictID starts with prefix.\n");
+    printf("          -json: output the page in JSON, with sizes, resolution and variants.\n");
+    printf("  <dbfilename> is either a pictDB file or a directory of pictDB volumes.\n");
     printf("  create <dbfilename> [options] : create a new pictDB.\n");
     printf("      options are:\n");
     printf("          -max_files <MAX_FILES>: maximum number of files.\n");
     printf("                                  default value is 10\n");
     printf("                                  maximum value is 100000\n");
+    printf("          -page_size <PAGE_SIZE>: make the pictDB growable, adding pages of\n");
+    printf("                                  PAGE_SIZE pictures when it is full.\n");
+    printf("                                  maximum value is 100000\n");
+    printf("          -volumes: create a directory of volumes; a new volume is added\n");
+    printf("                    with the same options whenever the last one is full.\n");
+    printf("          -needles: prefix every stored image with a needle header, so\n");
+    printf("                    that \"recover\" can rebuild the metadata from the data.\n");
     printf("          -thumb_res <X_RES> <Y_RES>: resolution for thumbnail images.\n");
     printf("                                  default value is 64x64\n");
     printf("                                  maximum value is 128x128\n");
@@ -219,9 +344,31 @@ int help (int argc, char* argv[])
     printf("  read    <dbfilename> <pictID> [original|orig|thumbnail|thumb|small]:\n");
     printf("      read an image from the pictDB and save it to a file.\n");
     printf("      default resolution is \"original\".\n");
-    printf("  insert <dbfilename> <pictID> <filename>: insert a new image in the pictDB.\n");
+    printf("  insert <dbfilename> <pictID> <filename> [<pictID> <filename> ...]:\n");
+    printf("      insert new images in the pictDB.\n");
     printf("  delete <dbfilename> <pictID> : delete picture pictID from pictDB.\n");
     printf("  gc <dbfilename> <tmp dbfilename>: performs garbage collecting on pictDB. Requires a temporary filename for copying the pictDB.\n");
+    printf("      the volumes of a directory are collected one after the other; the\n");
+    printf("      temporary filename is then optional.\n");
+    printf("  recover <dbfilename>: rebuild the metadata of a pictDB created with -needles\n");
+    printf("      from its stored images (the header must be intact).\n");
+    printf("  verify <dbfilename> [-threads <N>]: check the header, the metadata and the\n");
+    printf("      position, checksum, SHA and decoding of every stored image.\n");
+    printf("      the data is read in file order by N threads (default: one per core).\n");
+    printf("  gen <dbfilename> <jpeg> [options]: create a synthetic pictDB of copies of <jpeg>,\n");
+    printf("      each followed by its own bytes, written sequentially with a single\n");
+    printf("      metadata write. pictIDs are \"pic\" followed by the picture number.\n");
+    printf("      options are:\n");
+    printf("          -count <N>: pictures written (default %d, maximum 100000).\n", GEN_DEFAULT_COUNT);
+    printf("          -max_files <MAX_FILES>: metadata slots (default: count).\n");
+    printf("          -size <BYTES>: mean size of the originals (default: size of <jpeg>).\n");
+    printf("          -size_dist <fixed|uniform|exp>: size distribution (default fixed).\n");
+    printf("          -dup <PERCENT>: pictures sharing the data of an earlier one.\n");
+    printf("          -variants <PERCENT>: pictures stored with their thumb and small images.\n");
+    printf("          -deleted <PERCENT>: pictures deleted once written (free slots and\n");
+    printf("                              data left for gc).\n");
+    printf("          -needles: same as for create.\n");
+    printf("          -seed <N>: seed of the pseudo-random choices (same seed, same pictDB).\n");
     return ERR_NONE;
 }
 
@@ -240,67 +387,86 @@ int do_delete_cmd (int argc, char* argv[])
         return ERR_INVALID_PICID;
 
     int retval = ERR_NONE;
-    struct pictdb_file db_file;
+    struct volume_set volumes;
 
-    retval = do_open(filename, "r+b", &db_file);
+    retval = volume_open_lazy(filename, "r+b", &volumes);
     if (retval != ERR_NONE)
         return retval;
 
-    retval = do_delete(pictID, &db_file);
+    retval = volume_delete(&volumes, pictID);
 
-    do_close(&db_file);
+    volume_close(&volumes);
 
     return retval;
 }
 
 /********************************************************************//**
- * Insert une image dans la base de donnée.
+ * Insert une ou plusieurs images dans la base de donnée. Les images sont
+ * lues et hachées par lots de INSERT_BATCH (cf. sha256_batch), puis
+ * insérées dans l'ordre.
  */
 int do_insert_cmd (int argc, char* argv[])
 {
-    if (argc < 3)
+    if (argc < 4)
+        return ERR_NOT_ENOUGH_ARGUMENTS;
+
+    // Paires <pictID> <filename>
+    if ((argc - 2) % 2 != 0)
         return ERR_NOT_ENOUGH_ARGUMENTS;
 
     const char* dbfilename = argv[1];
-    const char* pictID     = argv[2];
-    const char* filename   = argv[3];
+    const int count = (argc - 2) / 2;
 
-    if (pictID == NULL || strlen(pictID) > MAX_PIC_ID)
-        return ERR_INVALID_PICID;
+    for (int i = 0; i < count; i++) {
+        if (strlen(argv[2 + 2 * i]) > MAX_PIC_ID)
+            return ERR_INVALID_PICID;
+    }
 
     // Variables utilisées ou libérées en cas d'erreur
     int retval = ERR_NONE;
-    void *image = NULL;
-    struct pictdb_file db_file;
+    void *images[INSERT_BATCH] = { NULL };
+    size_t sizes[INSERT_BATCH] = { 0 };
+    unsigned char digests[INSERT_BATCH * SHA256_DIGEST_LENGTH];
+    struct volume_set volumes;
 
-    retval = do_open(dbfilename, "r+b", &db_file);
+    retval = volume_open(dbfilename, "r+b", &volumes);
     if (retval != ERR_NONE)
-        goto error;
+        return retval;
 
-    if (db_file.header.num_files >= db_file.header.max_files) {
-        retval = ERR_FULL_DATABASE;
-        goto error;
-    }
+    for (int first = 0; first < count; first += INSERT_BATCH) {
+        const int batch = (count - first < INSERT_BATCH) ? count - first : INSERT_BATCH;
 
-    size_t image_size = 0;
-    retval = read_disk_image(filename, &image, &image_size);
-    if (retval != ERR_NONE)
-        goto error;
+        for (int i = 0; i < batch; i++) {
+            retval = read_disk_image(argv[3 + 2 * (first + i)], &images[i], &sizes[i]);
+            if (retval != ERR_NONE)
+                goto error;
+        }
 
-    retval = do_insert(image, image_size, pictID, &db_file);
-    if (retval != ERR_NONE)
-        goto error;
+        sha256_batch((const void* const*)images, sizes, (size_t)batch, digests);
 
-    free(image);
-    do_close(&db_file);
+        // Un volume plein est complété par un nouveau volume
+        for (int i = 0; i < batch; i++) {
+            retval = volume_insert_hashed(&volumes, images[i], sizes[i], argv[2 + 2 * (first + i)],
+                                          &digests[i * SHA256_DIGEST_LENGTH]);
+            if (retval != ERR_NONE)
+                goto error;
+        }
+
+        for (int i = 0; i < batch; i++) {
+            free(images[i]);
+            images[i] = NULL;
+        }
+    }
+
+    volume_close(&volumes);
 
     return ERR_NONE;
 
 error:
-    do_close(&db_file);
+    volume_close(&volumes);
 
-    if (image != NULL)
-        free(image);
+    for (int i = 0; i < INSERT_BATCH; i++)
+        free(images[i]);
 
     return retval;
 }
@@ -317,7 +483,7 @@ int do_read_cmd (int argc, char* argv[])
     int retval = ERR_NONE;
     const char *name = NULL;
     char *image_buffer = NULL;
-    struct pictdb_file db_file;
+    struct volume_set volumes;
 
     // Récupération des arguments
     const char* dbfilename = argv[1];
@@ -335,13 +501,16 @@ int do_read_cmd (int argc, char* argv[])
     }
 
     // Lecture de l'image depuis la DB
-    retval = do_open(dbfilename, "r+b", &db_file);
+    retval = volume_open_lazy(dbfilename, "r+b", &volumes);
     if (retval != ERR_NONE)
-        goto error;
+        return retval;
+
+    // Une image endommagée n'est pas écrite
+    volume_set_verify(&volumes, 1);
 
     uint32_t image_size = 0;
 
-    retval = do_read(pict_id, (uint32_t)res, &image_buffer, &image_size, &db_file);
+    retval = volume_read(&volumes, pict_id, (uint32_t)res, &image_buffer, &image_size);
     if (retval != ERR_NONE)
         goto error;
 
@@ -358,20 +527,20 @@ int do_read_cmd (int argc, char* argv[])
 
     // Nettoyage
     free((char*)name);
-    free(image_buffer);
+    buffer_release(image_buffer);
 
-    do_close(&db_file);
+    volume_close(&volumes);
 
     return ERR_NONE;
 
 error:
-    do_close(&db_file);
+    volume_close(&volumes);
 
     if (name != NULL)
         free((void*)name);
 
     if (image_buffer != NULL)
-        free(image_buffer);
+        buffer_release(image_buffer);
 
     return retval;
 }
@@ -381,17 +550,206 @@ error:
  ********************************************************************** */
 int do_gc_cmd (int argc, char *argv[])
 {
-    if (argc < 3)
+    if (argc < 2)
         return ERR_NOT_ENOUGH_ARGUMENTS;
 
     // Récupération des arguments
     const char* dbfilename = argv[1];
-    const char* tmpFilename = argv[2];
+    const char* tmpFilename = (argc > 2) ? argv[2] : NULL;
+
+    struct volume_set volumes;
+
+    int retval = volume_open(dbfilename, "r+b", &volumes);
+    if (retval != ERR_NONE)
+        return retval;
+
+    // Un simple fichier nécessite un nom de fichier temporaire
+    if (!volumes.directory && tmpFilename == NULL)
+        retval = ERR_NOT_ENOUGH_ARGUMENTS;
+
+    // Chaque volume est nettoyé indépendamment des autres
+    for (uint32_t i = 0; retval == ERR_NONE && i < volumes.count; i++)
+        retval = volume_gc(&volumes, i, tmpFilename);
+
+    volume_close(&volumes);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Reconstruit les metadatas d'une base à partir de ses needles
+ */
+int do_recover_cmd (int argc, char *argv[])
+{
+    if (argc < 2)
+        return ERR_NOT_ENOUGH_ARGUMENTS;
+
+    struct pictdb_file db_file;
+
+    int retval = do_recover(argv[1], &db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    print_header(&db_file.header);
+    do_close(&db_file);
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Vérifie chaque volume d'une base (cf. do_verify)
+ */
+int do_verify_cmd (int argc, char *argv[])
+{
+    if (argc < 2)
+        return ERR_NOT_ENOUGH_ARGUMENTS;
+
+    uint32_t nb_threads = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return ERR_NOT_ENOUGH_ARGUMENTS;
+        } else if (!strcmp(argv[i], "-threads")) {
+            nb_threads = atouint32(argv[++i]);
+
+            if (nb_threads == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else {
+            return ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    struct volume_set volumes;
+
+    int retval = volume_open(argv[1], "rb", &volumes);
+    if (retval != ERR_NONE)
+        return retval;
+
+    uint32_t problems = 0;
+
+    for (uint32_t i = 0; retval == ERR_NONE && i < volumes.count; i++) {
+        struct verify_report report;
+
+        retval = do_verify(volumes.volumes[i], nb_threads, &report);
+        if (retval != ERR_NONE)
+            break;
+
+        if (volumes.directory)
+            printf("volume %" PRIu32 ": ", i);
+
+        printf("%" PRIu32 " picture(s), %" PRIu64 " image(s) (%" PRIu64 " bytes) read by %" PRIu32 " thread(s), %" PRIu32 " problem(s)\n",
+               report.images, report.extents, report.bytes, report.threads, report.problems);
+
+        problems += report.problems;
+    }
+
+    volume_close(&volumes);
+
+    if (retval == ERR_NONE && problems > 0)
+        retval = ERR_INCONSISTENT;
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Crée une base synthétique (cf. do_gen)
+ */
+int do_gen_cmd (int argc, char *argv[])
+{
+    if (argc < 3)
+        return ERR_NOT_ENOUGH_ARGUMENTS;
+
+    const char* filename = argv[1];
+    uint32_t max_files = 0;
+    uint32_t format_version = PICTDB_FORMAT_PAGES;
+    struct gen_params params = { GEN_DEFAULT_COUNT, 0, GEN_SIZE_FIXED, 0, 0, 0, 1 };
+
+    for (int i = 3; i < argc; i++) {
+        if (!strcmp(argv[i], "-needles")) {
+            format_version = PICTDB_FORMAT_NEEDLES;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return ERR_NOT_ENOUGH_ARGUMENTS;
+
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (!strcmp(option, "-count")) {
+            params.count = atouint32(value);
+            if (params.count == 0 || params.count > MAX_MAX_FILES)
+                return ERR_MAX_FILES;
+        } else if (!strcmp(option, "-max_files")) {
+            max_files = atouint32(value);
+            if (max_files == 0 || max_files > MAX_MAX_FILES)
+                return ERR_MAX_FILES;
+        } else if (!strcmp(option, "-size")) {
+            params.size = atouint32(value);
+            if (params.size == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-size_dist")) {
+            if (!strcmp(value, "fixed"))
+                params.size_dist = GEN_SIZE_FIXED;
+            else if (!strcmp(value, "uniform"))
+                params.size_dist = GEN_SIZE_UNIFORM;
+            else if (!strcmp(value, "exp"))
+                params.size_dist = GEN_SIZE_EXP;
+            else
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-dup") || !strcmp(option, "-variants") || !strcmp(option, "-deleted")) {
+            uint32_t ratio = atouint32(value);
+            if (ratio > 100 || (ratio == 0 && strcmp(value, "0")))
+                return ERR_INVALID_ARGUMENT;
+
+            if (!strcmp(option, "-dup"))
+                params.dup_ratio = ratio;
+            else if (!strcmp(option, "-variants"))
+                params.variant_ratio = ratio;
+            else
+                params.deleted_ratio = ratio;
+        } else if (!strcmp(option, "-seed")) {
+            params.seed = atouint32(value);
+        } else {
+            return ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (max_files == 0)
+        max_files = params.count;
+
+    void *seed = NULL;
+    size_t seed_size = 0;
+
+    int retval = read_disk_image(argv[2], &seed, &seed_size);
+    if (retval != ERR_NONE)
+        return retval;
+
+    if (params.size == 0)
+        params.size = (uint32_t)seed_size;
 
     struct pictdb_file db_file;
+    db_file.header.max_files = max_files;
+    db_file.ext.page_size = 0;
+    db_file.ext.format_version = format_version;
+
+    db_file.header.res_resized[0] = 64;
+    db_file.header.res_resized[1] = 64;
+    db_file.header.res_resized[2] = 256;
+    db_file.header.res_resized[3] = 256;
+
+    struct gen_report report;
+
+    retval = do_gen(filename, &db_file, seed, seed_size, &params, &report);
+    free(seed);
+    if (retval != ERR_NONE)
+        return retval;
+
+    print_header(&db_file.header);
+    printf("%" PRIu32 " picture(s): %" PRIu32 " duplicate(s), %" PRIu32 " with variants, %" PRIu32
+           " deleted; %" PRIu64 " bytes of data\n", report.pictures, report.duplicates, report.variants,
+           report.deleted, report.bytes);
 
-    do_open(dbfilename, "r+b", &db_file);
-    do_gbcollect(&db_file, dbfilename, tmpFilename);
     do_close(&db_file);
 
     return ERR_NONE;
@@ -0,0 +1,638 @@
+/**
+ * @file pictDB_bench.c
+ * @brief Mesure des performances des fonctions critiques de la bibliothèque
+ *        (make bench).
+ *
+ * Une base synthétique de taille configurable est construite à partir d'une
+ * image JPEG : chaque image est une copie de celle-ci suivie d'octets qui lui
+ * sont propres (ignorés par les décodeurs JPEG), ce qui donne des contenus et
+ * des tailles tous différents. Chaque opération est ensuite répétée et
+ * chronométrée individuellement ; les résultats (opérations par seconde,
+ * médiane et 99e centile) sont écrits en JSON sur stdout, pour être comparés
+ * d'une version à l'autre. La progression est affichée sur stderr.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour dup, dup2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h> // pour PRIu32, PRIu64
+#include <unistd.h> // pour dup, dup2
+#include <vips/vips.h>
+
+#include "pictDB.h"
+#include "image_content.h"
+#include "dedup.h"
+#include "crc32c.h"
+#include "sidecar.h"
+#include "stats.h"
+#include "buffer_pool.h"
+#include "pictDBM_tools.h"
+
+#define BENCH_DEFAULT_FILES 10000 // images de la base synthétique
+#define BENCH_DEFAULT_OPS 1000 // répétitions de chaque opération
+#define BENCH_DEFAULT_IMAGE "steps/provided/week09/papillon.jpg"
+#define BENCH_DEFAULT_DIR "/tmp"
+#define BENCH_LIST_OPS 20 // listes JSON complètes construites
+#define BENCH_WRITE_OPS 20 // écritures complètes des metadatas
+#define BENCH_TRAILER_MAX 4096 // octets ajoutés au plus après l'image
+#define BENCH_ID_FORMAT "bench%08" PRIu32
+#define BENCH_MAX_RESULTS 16
+#define MAX_PATH_LENGTH 1023
+#define MAX_DIR_LENGTH 960
+
+// Paramètres de la mesure
+struct bench_config {
+    uint32_t files;
+    uint32_t ops;
+    const char* image;
+    const char* dir;
+    uint64_t seed;
+    uint32_t page_size;
+};
+
+// Durées (ns) des exécutions d'une opération
+struct bench_samples {
+    uint64_t* durations;
+    size_t count;
+    uint64_t total;
+};
+
+// Résultat d'une opération
+struct bench_result {
+    const char* name;
+    size_t count;
+    uint64_t total;
+    uint64_t p50;
+    uint64_t p99;
+};
+
+// Image de base et buffer dans lequel sont construites les images synthétiques
+struct bench_images {
+    const char* seed;
+    size_t seed_size;
+    char* buffer;
+};
+
+static struct bench_result results[BENCH_MAX_RESULTS];
+static size_t result_count = 0;
+
+/********************************************************************//**
+ * Générateur pseudo-aléatoire (xorshift64)
+ */
+static uint64_t bench_rand(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+/********************************************************************//**
+ * Construit l'image synthétique numéro n : l'image de base suivie de n et
+ * d'un nombre d'octets dérivé de n
+ */
+static const char* make_image(struct bench_images* images, uint32_t n, size_t* size)
+{
+    uint64_t state = UINT64_C(0x9E3779B97F4A7C15) ^ n;
+    const size_t trailer = sizeof(uint32_t) + bench_rand(&state) % (BENCH_TRAILER_MAX - sizeof(uint32_t));
+
+    memcpy(&images->buffer[images->seed_size], &n, sizeof(uint32_t));
+    for (size_t i = sizeof(uint32_t); i < trailer; i++)
+        images->buffer[images->seed_size + i] = (char)bench_rand(&state);
+
+    *size = images->seed_size + trailer;
+
+    return images->buffer;
+}
+
+/********************************************************************//**
+ * Identifiant de l'image synthétique numéro n
+ */
+static void make_id(uint32_t n, char* pict_id)
+{
+    snprintf(pict_id, MAX_PIC_ID + 1, BENCH_ID_FORMAT, n);
+}
+
+/********************************************************************//**
+ * Prépare count mesures
+ */
+static int samples_init(struct bench_samples* samples, size_t count)
+{
+    samples->durations = calloc(count + 1, sizeof(uint64_t));
+    samples->count = 0;
+    samples->total = 0;
+
+    return (samples->durations == NULL) ? ERR_OUT_OF_MEMORY : ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ajoute la durée d'une exécution commencée à start
+ */
+static void samples_add(struct bench_samples* samples, uint64_t start)
+{
+    const uint64_t duration = stats_now() - start;
+
+    samples->durations[samples->count++] = duration;
+    samples->total += duration;
+}
+
+/********************************************************************//**
+ * Comparaison de deux durées, pour qsort
+ */
+static int duration_cmp(const void* a, const void* b)
+{
+    const uint64_t first = *(const uint64_t*)a, second = *(const uint64_t*)b;
+
+    return (first > second) - (first < second);
+}
+
+/********************************************************************//**
+ * Résume les mesures d'une opération, puis les libère
+ */
+static void samples_done(struct bench_samples* samples, const char* name)
+{
+    if (result_count < BENCH_MAX_RESULTS && samples->count > 0) {
+        struct bench_result *result = &results[result_count++];
+
+        qsort(samples->durations, samples->count, sizeof(uint64_t), duration_cmp);
+
+        result->name = name;
+        result->count = samples->count;
+        result->total = samples->total;
+        result->p50 = samples->durations[(samples->count - 1) / 2];
+        result->p99 = samples->durations[(samples->count - 1) * 99 / 100];
+
+        fprintf(stderr, "%-14s %8zu ops %12.0f ops/s  p50 %10.1f us  p99 %10.1f us\n", name, result->count,
+                (double)result->count * 1e9 / (double)(result->total ? result->total : 1),
+                (double)result->p50 / 1000.0, (double)result->p99 / 1000.0);
+    }
+
+    free(samples->durations);
+    samples->durations = NULL;
+}
+
+/********************************************************************//**
+ * Remplit la base de config->files images
+ */
+static int bench_insert(struct pictdb_file* db_file, struct bench_images* images, const struct bench_config* config)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, config->files);
+    if (retval != ERR_NONE)
+        return retval;
+
+    char pict_id[MAX_PIC_ID + 1];
+
+    for (uint32_t n = 0; n < config->files && retval == ERR_NONE; n++) {
+        size_t size = 0;
+        const char *image = make_image(images, n, &size);
+        make_id(n, pict_id);
+
+        const uint64_t start = stats_now();
+        retval = do_insert(image, size, pict_id, db_file);
+        samples_add(&samples, start);
+    }
+
+    samples_done(&samples, "insert");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Recherche d'identifiants tirés au hasard
+ */
+static int bench_lookup(struct pictdb_file* db_file, const struct bench_config* config, uint64_t* state)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, config->ops);
+    if (retval != ERR_NONE)
+        return retval;
+
+    char pict_id[MAX_PIC_ID + 1];
+
+    for (uint32_t i = 0; i < config->ops && retval == ERR_NONE; i++) {
+        uint32_t index = 0;
+        make_id((uint32_t)(bench_rand(state) % config->files), pict_id);
+
+        const uint64_t start = stats_now();
+        retval = find_pict_id(db_file, pict_id, &index);
+        samples_add(&samples, start);
+    }
+
+    samples_done(&samples, "lookup");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Dé-duplication d'images nouvelles, comme lors d'une insertion : une
+ * position libre est remplie, vérifiée, puis vidée
+ */
+static int bench_dedup(struct pictdb_file* db_file, struct bench_images* images, const struct bench_config* config)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, config->ops);
+    if (retval != ERR_NONE)
+        return retval;
+
+    char pict_id[MAX_PIC_ID + 1];
+
+    for (uint32_t i = 0; i < config->ops && retval == ERR_NONE; i++) {
+        retval = meta_scan_build(db_file);
+        if (retval != ERR_NONE)
+            break;
+
+        const uint32_t slot = meta_scan_next(&db_file->scan, 0, 0);
+        if (slot >= db_file->header.max_files) {
+            retval = ERR_FULL_DATABASE;
+            break;
+        }
+
+        size_t size = 0;
+        const uint32_t n = config->files + i;
+        const char *image = make_image(images, n, &size);
+        make_id(n, pict_id);
+
+        struct pict_metadata *metadata = &db_file->metadata[slot];
+        metadata->pict_id = pict_id_intern(db_file, pict_id, strlen(pict_id));
+        metadata->size[RES_ORIG] = (uint32_t)size;
+        metadata->is_valid = NON_EMPTY;
+        set_image_crc(metadata, RES_ORIG, crc32c(0, image, size));
+
+        const uint64_t start = stats_now();
+        retval = do_name_and_content_dedup(db_file, slot, image);
+        samples_add(&samples, start);
+
+        memset(metadata, 0, sizeof(struct pict_metadata));
+        meta_scan_update(db_file, slot, db_file->header.db_version);
+    }
+
+    samples_done(&samples, "dedup");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Lecture d'originaux tirés au hasard (sans cache)
+ */
+static int bench_fetch(struct pictdb_file* db_file, const struct bench_config* config, uint64_t* state)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, config->ops);
+    if (retval != ERR_NONE)
+        return retval;
+
+    for (uint32_t i = 0; i < config->ops && retval == ERR_NONE; i++) {
+        void *image = NULL;
+        const uint32_t index = (uint32_t)(bench_rand(state) % config->files);
+
+        const uint64_t start = stats_now();
+        retval = fetch_image(db_file, index, RES_ORIG, &image);
+        buffer_release(image);
+        samples_add(&samples, start);
+    }
+
+    samples_done(&samples, "fetch_image");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Création de la résolution res pour des images qui ne l'ont pas encore
+ */
+static int bench_resize(struct pictdb_file* db_file, const struct bench_config* config, uint32_t res, const char* name)
+{
+    const uint32_t count = (config->ops < config->files) ? config->ops : config->files;
+
+    struct bench_samples samples;
+    int retval = samples_init(&samples, count);
+    if (retval != ERR_NONE)
+        return retval;
+
+    for (uint32_t index = 0; index < count && retval == ERR_NONE; index++) {
+        const uint64_t start = stats_now();
+        retval = lazily_resize(db_file, index, res);
+        samples_add(&samples, start);
+    }
+
+    samples_done(&samples, name);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Construction de la liste JSON complète (sans le cache de do_list_json)
+ */
+static int bench_list(struct pictdb_file* db_file)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, BENCH_LIST_OPS);
+    if (retval != ERR_NONE)
+        return retval;
+
+    const struct list_query query = { NULL, NULL, 0, 0 };
+
+    for (uint32_t i = 0; i < BENCH_LIST_OPS && retval == ERR_NONE; i++) {
+        const uint64_t start = stats_now();
+        char *json = (char*)do_list_page(db_file, JSON, &query);
+        samples_add(&samples, start);
+
+        if (json == NULL)
+            retval = ERR_INTERNAL;
+
+        free(json);
+    }
+
+    samples_done(&samples, "list_json");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Écriture complète du header et des metadatas
+ */
+static int bench_write(struct pictdb_file* db_file)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, BENCH_WRITE_OPS);
+    if (retval != ERR_NONE)
+        return retval;
+
+    for (uint32_t i = 0; i < BENCH_WRITE_OPS && retval == ERR_NONE; i++) {
+        const uint64_t start = stats_now();
+        retval = do_write(db_file, NULL);
+        samples_add(&samples, start);
+    }
+
+    samples_done(&samples, "do_write");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Suppression d'images réparties dans toute la base
+ */
+static int bench_delete(struct pictdb_file* db_file, const struct bench_config* config)
+{
+    const uint32_t count = (config->ops < config->files) ? config->ops : config->files;
+    const uint32_t stride = config->files / count;
+
+    struct bench_samples samples;
+    int retval = samples_init(&samples, count);
+    if (retval != ERR_NONE)
+        return retval;
+
+    char pict_id[MAX_PIC_ID + 1];
+
+    for (uint32_t i = 0; i < count && retval == ERR_NONE; i++) {
+        make_id(i * stride, pict_id);
+
+        const uint64_t start = stats_now();
+        retval = do_delete(pict_id, db_file);
+        samples_add(&samples, start);
+    }
+
+    samples_done(&samples, "delete");
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Garbage collection de la base (une seule exécution), puis vérification
+ * que la base nettoyée se rouvre avec toutes ses images
+ */
+static int bench_gc(struct pictdb_file* db_file, const char* path, const char* tmp_path)
+{
+    struct bench_samples samples;
+    int retval = samples_init(&samples, 1);
+    if (retval != ERR_NONE)
+        return retval;
+
+    const uint32_t num_files = db_file->header.num_files;
+
+    const uint64_t start = stats_now();
+    retval = do_gbcollect(db_file, path, tmp_path);
+    samples_add(&samples, start);
+
+    samples_done(&samples, "gc");
+
+    if (retval != ERR_NONE)
+        return retval;
+
+    struct pictdb_file check;
+    retval = do_open(path, "rb", &check);
+    if (retval != ERR_NONE)
+        return retval;
+
+    if (check.header.num_files != num_files)
+        retval = ERR_CORRUPT;
+
+    do_close(&check);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Écrit les résultats en JSON sur stdout
+ */
+static void print_results(const struct bench_config* config)
+{
+    printf("{ \"files\": %" PRIu32 ", \"ops\": %" PRIu32 ", \"results\": [", config->files, config->ops);
+
+    for (size_t i = 0; i < result_count; i++) {
+        const struct bench_result *result = &results[i];
+
+        printf("%s\n    { \"name\": \"%s\", \"count\": %zu, \"ops_per_sec\": %.1f, \"p50_ns\": %" PRIu64
+               ", \"p99_ns\": %" PRIu64 " }", (i == 0) ? "" : ",", result->name, result->count,
+               (double)result->count * 1e9 / (double)(result->total ? result->total : 1), result->p50, result->p99);
+    }
+
+    printf("\n] }\n");
+}
+
+/********************************************************************//**
+ * Lecture des options
+ */
+static int parse_options(int argc, char* argv[], struct bench_config* config)
+{
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            return ERR_NOT_ENOUGH_ARGUMENTS;
+
+        if (!strcmp(argv[i], "-files")) {
+            config->files = atouint32(argv[++i]);
+            if (config->files == 0)
+                return ERR_MAX_FILES;
+        } else if (!strcmp(argv[i], "-ops")) {
+            config->ops = atouint32(argv[++i]);
+            if (config->ops == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(argv[i], "-image")) {
+            config->image = argv[++i];
+        } else if (!strcmp(argv[i], "-dir")) {
+            config->dir = argv[++i];
+            if (strlen(config->dir) > MAX_DIR_LENGTH)
+                return ERR_INVALID_FILENAME;
+        } else if (!strcmp(argv[i], "-seed")) {
+            config->seed = atouint32(argv[++i]);
+        } else if (!strcmp(argv[i], "-page_size")) {
+            config->page_size = atouint32(argv[++i]);
+            if (config->page_size == 0 || config->page_size > MAX_MAX_FILES)
+                return ERR_MAX_FILES;
+        } else {
+            return ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    // La base a une position libre par dé-duplication mesurée ; seule une
+    // base extensible dépasse MAX_MAX_FILES
+    if ((uint64_t)config->files + config->ops > (config->page_size != 0 ? MAX_TOTAL_FILES : MAX_MAX_FILES))
+        return ERR_MAX_FILES;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Toutes les mesures, sur une base créée dans path
+ */
+static int run(const struct bench_config* config, struct bench_images* images, const char* path, const char* tmp_path)
+{
+    struct pictdb_file db_file;
+    memset(&db_file, 0, sizeof(struct pictdb_file));
+
+    db_file.header.max_files = config->files + config->ops;
+    if (db_file.header.max_files > MAX_MAX_FILES)
+        db_file.header.max_files = MAX_MAX_FILES;
+    db_file.header.res_resized[0] = 64;
+    db_file.header.res_resized[1] = 64;
+    db_file.header.res_resized[2] = 256;
+    db_file.header.res_resized[3] = 256;
+    db_file.ext.page_size = config->page_size;
+    db_file.ext.format_version = PICTDB_FORMAT_PAGES;
+
+    int retval = do_create(path, &db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    do_close(&db_file);
+
+    retval = do_open(path, "r+b", &db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    uint64_t state = config->seed | 1;
+
+    retval = bench_insert(&db_file, images, config);
+    if (retval == ERR_NONE)
+        retval = bench_lookup(&db_file, config, &state);
+    // Base extensible remplie par les insertions : une page de plus pour
+    // les positions libres de la dé-duplication
+    if (retval == ERR_NONE && db_file.header.num_files == db_file.header.max_files)
+        retval = metadata_grow(&db_file);
+    if (retval == ERR_NONE)
+        retval = bench_dedup(&db_file, images, config);
+    if (retval == ERR_NONE)
+        retval = bench_fetch(&db_file, config, &state);
+    if (retval == ERR_NONE)
+        retval = bench_resize(&db_file, config, RES_THUMB, "resize_thumb");
+    if (retval == ERR_NONE)
+        retval = bench_resize(&db_file, config, RES_SMALL, "resize_small");
+    if (retval == ERR_NONE)
+        retval = bench_list(&db_file);
+    if (retval == ERR_NONE)
+        retval = bench_write(&db_file);
+    if (retval == ERR_NONE)
+        retval = bench_delete(&db_file, config);
+    if (retval == ERR_NONE)
+        retval = bench_gc(&db_file, path, tmp_path);
+
+    do_close(&db_file);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * MAIN
+ */
+int main (int argc, char* argv[])
+{
+    struct bench_config config = { BENCH_DEFAULT_FILES, BENCH_DEFAULT_OPS, BENCH_DEFAULT_IMAGE, BENCH_DEFAULT_DIR, 1, 0 };
+    struct bench_images images = { NULL, 0, NULL };
+    char path[MAX_PATH_LENGTH + 1], tmp_path[MAX_PATH_LENGTH + 1], idx_path[MAX_PATH_LENGTH + sizeof(SIDECAR_SUFFIX)];
+    void *seed = NULL;
+
+    if (VIPS_INIT(argv[0]))
+        vips_error_exit("unable to start VIPS");
+
+    int retval = parse_options(argc, argv, &config);
+    if (retval != ERR_NONE)
+        goto error;
+
+    retval = read_disk_image(config.image, &seed, &images.seed_size);
+    if (retval != ERR_NONE)
+        goto error;
+
+    images.seed = seed;
+    images.buffer = malloc(images.seed_size + BENCH_TRAILER_MAX);
+    if (images.buffer == NULL) {
+        retval = ERR_OUT_OF_MEMORY;
+        goto error;
+    }
+
+    memcpy(images.buffer, images.seed, images.seed_size);
+
+    snprintf(path, sizeof(path), "%s/pictdb_bench.pictdb", config.dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/pictdb_bench.tmp", config.dir);
+    snprintf(idx_path, sizeof(idx_path), "%s%s", path, SIDECAR_SUFFIX);
+
+    // Les messages de la bibliothèque (p.ex. do_create) vont sur stderr :
+    // stdout ne reçoit que les résultats
+    fflush(stdout);
+    const int out = dup(STDOUT_FILENO);
+    if (out < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    retval = run(&config, &images, path, tmp_path);
+
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(out);
+
+    remove(path);
+    remove(tmp_path);
+    remove(idx_path);
+
+    if (retval != ERR_NONE)
+        goto error;
+
+    print_results(&config);
+
+    free(images.buffer);
+    free(seed);
+    buffer_pool_flush();
+    vips_shutdown();
+
+    return ERR_NONE;
+
+error:
+    fprintf(stderr, "ERROR: %s\n", ERROR_MESSAGES[retval]);
+    fprintf(stderr, "pictDB_bench [-files <N>] [-ops <N>] [-image <jpeg>] [-dir <directory>] [-seed <N>]\n"
+            "             [-page_size <N>]\n");
+
+    free(images.buffer);
+    free(seed);
+    buffer_pool_flush();
+    vips_shutdown();
+
+    return retval;
+}
@@ -0,0 +1,1050 @@
+/**
+ * @file pictDB_load.c
+ * @brief Générateur de charge HTTP pour pictDB_server (make load).
+ *
+ * Des clients concurrents (un thread et une connexion chacun) envoient au
+ * serveur local un mélange configurable de lectures, de listes et
+ * d'insertions. Les identifiants lus sont ceux de la liste du serveur,
+ * choisis selon une loi de Zipf (quelques images très demandées, beaucoup
+ * rarement) ; les images insérées sont des copies d'une image JPEG rendues
+ * uniques par quelques octets ajoutés à la fin. Les connexions sont
+ * réutilisées (keep-alive) ou ouvertes pour chaque requête.
+ *
+ * Un journal de requêtes peut aussi être rejoué (-replay) : une requête par
+ * ligne, soit "METHODE URI", soit un objet JSON avec les champs "uri" (ou
+ * "url", "path"), "method" et, pour une insertion, "file" (image envoyée) et
+ * "pict_id". Les autres lignes sont ignorées.
+ *
+ * Les latences, mesurées côté client, sont rangées dans les histogrammes des
+ * requêtes HTTP (cf. stats.h). Le débit et les centiles sont affichés sur
+ * stderr et écrits en JSON sur stdout.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour getaddrinfo, strdup, strncasecmp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // pour strncasecmp
+#include <inttypes.h> // pour PRIu64
+#include <math.h> // pour pow
+#include <time.h> // pour time
+#include <pthread.h>
+#include <unistd.h> // pour close
+#include <netdb.h> // pour getaddrinfo
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // pour TCP_NODELAY
+
+#include "error.h"
+#include "stats.h"
+#include "pictDBM_tools.h"
+
+#define LOAD_DEFAULT_HOST "127.0.0.1"
+#define LOAD_DEFAULT_PORT "8000" // cf. LISTEN_PORT du serveur
+#define LOAD_DEFAULT_CLIENTS 8
+#define LOAD_DEFAULT_REQUESTS 10000
+#define LOAD_DEFAULT_ZIPF 0.99
+#define LOAD_DEFAULT_IMAGE "steps/provided/week09/papillon.jpg"
+#define LOAD_MAX_CLIENTS 1024
+#define LOAD_BUFFER_SIZE 65536 // buffer de réception de chaque client
+#define LOAD_MAX_ID 127 // cf. MAX_PIC_ID
+#define LOAD_MAX_URI 1023
+#define LOAD_MAX_METHOD 15
+#define LOAD_MAX_LINE 4095 // taille max d'une ligne du journal rejoué
+#define LOAD_MAX_HEADERS 511
+#define LOAD_BOUNDARY "pictDBload7MA4YWxkTrZu0gW"
+
+// Requêtes du mélange
+enum load_kind {
+    LOAD_READ,
+    LOAD_LIST,
+    LOAD_INSERT,
+    NB_LOAD_KINDS
+};
+
+// Requête d'un journal rejoué
+struct replay_request {
+    char method[LOAD_MAX_METHOD + 1];
+    char* uri;
+    // Image envoyée et identifiant (insertion), NULL sinon
+    char* file;
+    char* pict_id;
+    // Histogramme de la requête (NB_STATS si aucun)
+    enum stat_op stat;
+};
+
+// Paramètres de la charge
+struct load_config {
+    const char* host;
+    const char* port;
+    uint32_t clients;
+    uint32_t requests;
+    uint32_t mix[NB_LOAD_KINDS];
+    double zipf;
+    uint32_t keys;
+    const char* res;
+    int keep_alive;
+    const char* image;
+    const char* replay;
+    uint64_t seed;
+};
+
+// État partagé par les clients
+struct load_shared {
+    const struct load_config* config;
+    struct addrinfo* address;
+    // Identifiants lus et loi de leur popularité (fonction de répartition)
+    char** keys;
+    double* cdf;
+    uint32_t key_count;
+    // Journal rejoué
+    struct replay_request* replay;
+    uint32_t replay_count;
+    // Image insérée, suivie de 8 octets propres à chaque insertion
+    char* image;
+    size_t image_size;
+    char id_prefix[32];
+    // Prochaine requête à envoyer, et bilan (modifiés atomiquement)
+    uint64_t next;
+    uint64_t total;
+    uint64_t errors;
+    uint64_t bytes;
+};
+
+// Un client : une connexion (fd < 0 si fermée) et son générateur aléatoire
+struct load_client {
+    struct load_shared* shared;
+    pthread_t thread;
+    int fd;
+    uint64_t state;
+    char* buffer;
+};
+
+// Réponse HTTP (seuls les champs utiles à la mesure)
+struct http_response {
+    int status;
+    // La connexion est fermée par le serveur après la réponse
+    int close;
+    // Code d'erreur de pictDB (redirection vers /?error=N), ERR_NONE sinon
+    int error;
+    // Corps de la réponse (conservé seulement s'il est demandé)
+    char* body;
+    uint64_t length;
+};
+
+static const char* const RES_NAMES[] = { "thumb", "small", "orig" };
+
+/********************************************************************//**
+ * Générateur pseudo-aléatoire (xorshift64)
+ */
+static uint64_t load_rand(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+/********************************************************************//**
+ * Nombre pseudo-aléatoire dans [0, 1)
+ */
+static double load_uniform(uint64_t* state)
+{
+    return (double)(load_rand(state) >> 11) / (double)(UINT64_C(1) << 53);
+}
+
+/********************************************************************//**
+ * Lit un fichier entier
+ */
+static int read_file(const char* filename, char** data, size_t* size)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        return ERR_IO;
+
+    int retval = ERR_NONE;
+    long length = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+
+    if (length < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        retval = ERR_IO;
+    } else {
+        // Place pour les octets qui distinguent les insertions
+        *data = malloc((size_t)length + sizeof(uint64_t));
+        if (*data == NULL)
+            retval = ERR_OUT_OF_MEMORY;
+        else if (fread(*data, 1, (size_t)length, file) != (size_t)length)
+            retval = ERR_IO;
+
+        *size = (size_t)length;
+    }
+
+    fclose(file);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Envoie size octets
+ */
+static int send_all(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return ERR_IO;
+
+        data += sent;
+        size -= (size_t)sent;
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ouvre une connexion au serveur
+ */
+static int load_connect(const struct addrinfo* address)
+{
+    int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+/********************************************************************//**
+ * Analyse les en-têtes (terminés par "\r\n\r\n") d'une réponse
+ */
+static int parse_headers(const char* headers, struct http_response* response, int64_t* content_length)
+{
+    int minor = 0;
+
+    if (sscanf(headers, "HTTP/1.%d %d", &minor, &response->status) != 2)
+        return ERR_IO;
+
+    response->close = (minor == 0);
+    *content_length = -1;
+
+    for (const char *line = strstr(headers, "\r\n") + 2; strncmp(line, "\r\n", 2); line = strstr(line, "\r\n") + 2) {
+        if (!strncasecmp(line, "Content-Length:", strlen("Content-Length:"))) {
+            *content_length = strtoll(line + strlen("Content-Length:"), NULL, 10);
+        } else if (!strncasecmp(line, "Connection:", strlen("Connection:"))) {
+            const char *value = line + strlen("Connection:");
+            while (*value == ' ')
+                value++;
+
+            response->close = !strncasecmp(value, "close", strlen("close"));
+        } else if (!strncasecmp(line, "Location:", strlen("Location:"))) {
+            const char *error = strstr(line, "error=");
+            const char *end = strstr(line, "\r\n");
+
+            if (error != NULL && error < end)
+                response->error = atoi(error + strlen("error="));
+        }
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Lit une réponse ; le corps est conservé si keep_body est non nul (il doit
+ * alors avoir une longueur)
+ */
+static int read_response(int fd, char* buffer, struct http_response* response, int keep_body)
+{
+    size_t used = 0;
+    char *end = NULL;
+
+    memset(response, 0, sizeof(struct http_response));
+
+    // En-têtes
+    while (end == NULL) {
+        if (used >= LOAD_BUFFER_SIZE - 1)
+            return ERR_IO;
+
+        ssize_t got = recv(fd, &buffer[used], LOAD_BUFFER_SIZE - 1 - used, 0);
+        if (got <= 0)
+            return ERR_IO;
+
+        used += (size_t)got;
+        buffer[used] = '\0';
+        end = strstr(buffer, "\r\n\r\n");
+    }
+
+    int64_t content_length = -1;
+    int retval = parse_headers(buffer, response, &content_length);
+    if (retval != ERR_NONE)
+        return retval;
+
+    // Corps : sa longueur, ou jusqu'à la fermeture de la connexion
+    const size_t header_length = (size_t)(end - buffer) + 4;
+    size_t have = used - header_length;
+
+    if (keep_body) {
+        if (content_length < 0)
+            return ERR_IO;
+
+        response->body = malloc((size_t)content_length + 1);
+        if (response->body == NULL)
+            return ERR_OUT_OF_MEMORY;
+
+        if (have > (size_t)content_length)
+            have = (size_t)content_length;
+
+        memcpy(response->body, &buffer[header_length], have);
+    }
+
+    if (content_length < 0)
+        response->close = 1;
+
+    while (content_length < 0 || have < (uint64_t)content_length) {
+        size_t wanted = LOAD_BUFFER_SIZE;
+        char *target = buffer;
+
+        if (content_length >= 0 && (uint64_t)content_length - have < wanted)
+            wanted = (size_t)((uint64_t)content_length - have);
+
+        if (response->body != NULL)
+            target = &response->body[have];
+
+        ssize_t got = recv(fd, target, wanted, 0);
+        if (got == 0 && content_length < 0)
+            break;
+
+        if (got <= 0) {
+            free(response->body);
+            response->body = NULL;
+            return ERR_IO;
+        }
+
+        have += (size_t)got;
+    }
+
+    if (response->body != NULL)
+        response->body[have] = '\0';
+
+    response->length = have;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Envoie une requête sur la connexion du client (ouverte si besoin) et lit
+ * la réponse. Une connexion réutilisée que le serveur a fermée entre-temps
+ * est rouverte une fois.
+ */
+static int exchange(struct load_client* client, const char* headers, const char* body, size_t body_size,
+                    const char* trailer, struct http_response* response, int keep_body)
+{
+    const struct load_shared *shared = client->shared;
+    int retval = ERR_IO;
+
+    memset(response, 0, sizeof(struct http_response));
+
+    for (int attempt = 0; attempt < 2 && retval == ERR_IO; attempt++) {
+        const int reused = (client->fd >= 0);
+
+        if (client->fd < 0)
+            client->fd = load_connect(shared->address);
+        if (client->fd < 0)
+            return ERR_IO;
+
+        retval = send_all(client->fd, headers, strlen(headers));
+        if (retval == ERR_NONE && body != NULL)
+            retval = send_all(client->fd, body, body_size);
+        if (retval == ERR_NONE && trailer != NULL)
+            retval = send_all(client->fd, trailer, strlen(trailer));
+        if (retval == ERR_NONE)
+            retval = read_response(client->fd, client->buffer, response, keep_body);
+
+        if (retval != ERR_NONE || response->close || !shared->config->keep_alive) {
+            close(client->fd);
+            client->fd = -1;
+        }
+
+        if (!reused)
+            break;
+    }
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Envoie une requête GET (ou method) sans corps
+ */
+static int request_get(struct load_client* client, const char* method, const char* uri,
+                       struct http_response* response, int keep_body)
+{
+    const struct load_config *config = client->shared->config;
+    char headers[LOAD_MAX_URI + LOAD_MAX_HEADERS + 1];
+
+    snprintf(headers, sizeof(headers), "%s %s HTTP/1.1\r\nHost: %s:%s\r\n%s%s\r\n", method, uri, config->host,
+             config->port, strcmp(method, "GET") ? "Content-Length: 0\r\n" : "",
+             config->keep_alive ? "" : "Connection: close\r\n");
+
+    return exchange(client, headers, NULL, 0, NULL, response, keep_body);
+}
+
+/********************************************************************//**
+ * Insère une image (formulaire multipart, le nom du fichier est l'identifiant)
+ */
+static int request_insert(struct load_client* client, const char* pict_id, const char* image, size_t size,
+                          struct http_response* response)
+{
+    const struct load_config *config = client->shared->config;
+    char part[LOAD_MAX_HEADERS + 1], headers[2 * LOAD_MAX_HEADERS + 1];
+    static const char trailer[] = "\r\n--" LOAD_BOUNDARY "--\r\n";
+
+    const int part_length = snprintf(part, sizeof(part),
+                                     "--" LOAD_BOUNDARY "\r\n"
+                                     "Content-Disposition: form-data; name=\"up_file\"; filename=\"%s\"\r\n"
+                                     "Content-Type: image/jpeg\r\n\r\n", pict_id);
+
+    snprintf(headers, sizeof(headers), "POST /pictDB/insert HTTP/1.1\r\nHost: %s:%s\r\n"
+             "Content-Type: multipart/form-data; boundary=" LOAD_BOUNDARY "\r\n"
+             "Content-Length: %zu\r\n%s\r\n%s", config->host, config->port,
+             (size_t)part_length + size + strlen(trailer), config->keep_alive ? "" : "Connection: close\r\n", part);
+
+    return exchange(client, headers, image, size, trailer, response, 0);
+}
+
+/********************************************************************//**
+ * Code d'erreur d'une requête : échange raté, statut d'erreur ou
+ * redirection vers la page d'erreur
+ */
+static int response_error(int retval, const struct http_response* response)
+{
+    if (retval != ERR_NONE)
+        return retval;
+
+    if (response->error > ERR_NONE && response->error <= ERR_INCONSISTENT)
+        return response->error;
+
+    return (response->status >= 400) ? ERR_IO : ERR_NONE;
+}
+
+/********************************************************************//**
+ * Tire une position selon la loi de popularité des identifiants
+ */
+static uint32_t pick_key(const struct load_shared* shared, uint64_t* state)
+{
+    const double u = load_uniform(state);
+    uint32_t low = 0, high = shared->key_count - 1;
+
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+
+        if (shared->cdf[middle] <= u)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+/********************************************************************//**
+ * Requête number du mélange
+ */
+static int generated_request(struct load_client* client, uint64_t number, enum stat_op* stat, uint64_t* bytes)
+{
+    struct load_shared *shared = client->shared;
+    const struct load_config *config = shared->config;
+    struct http_response response;
+    char uri[LOAD_MAX_URI + 1];
+    int retval = ERR_NONE;
+
+    // Choix de la requête selon les poids du mélange
+    uint64_t weight = load_rand(&client->state) % (config->mix[LOAD_READ] + config->mix[LOAD_LIST] + config->mix[LOAD_INSERT]);
+    enum load_kind kind = LOAD_READ;
+
+    while (weight >= config->mix[kind]) {
+        weight -= config->mix[kind];
+        kind++;
+    }
+
+    switch (kind) {
+    case LOAD_READ: {
+        const char *res = config->res;
+        if (!strcmp(res, "mixed"))
+            res = RES_NAMES[load_rand(&client->state) % (sizeof(RES_NAMES) / sizeof(RES_NAMES[0]))];
+
+        snprintf(uri, sizeof(uri), "/pictDB/read?res=%s&pict_id=%s", res, shared->keys[pick_key(shared, &client->state)]);
+
+        *stat = STAT_HTTP_READ;
+        retval = request_get(client, "GET", uri, &response, 0);
+        break;
+    }
+
+    case LOAD_LIST:
+        *stat = STAT_HTTP_LIST;
+        retval = request_get(client, "GET", "/pictDB/list", &response, 0);
+        break;
+
+    default: {
+        char pict_id[LOAD_MAX_ID + 1];
+        snprintf(pict_id, sizeof(pict_id), "%s%" PRIu64, shared->id_prefix, number);
+
+        // Contenu propre à l'insertion : la dé-duplication ne le trouve pas
+        char *image = malloc(shared->image_size + sizeof(uint64_t));
+        if (image == NULL)
+            return ERR_OUT_OF_MEMORY;
+
+        memcpy(image, shared->image, shared->image_size);
+        memcpy(&image[shared->image_size], &number, sizeof(uint64_t));
+
+        *stat = STAT_HTTP_INSERT;
+        retval = request_insert(client, pict_id, image, shared->image_size + sizeof(uint64_t), &response);
+        free(image);
+        break;
+    }
+    }
+
+    *bytes = (retval == ERR_NONE) ? response.length : 0;
+
+    return response_error(retval, &response);
+}
+
+/********************************************************************//**
+ * Requête number du journal rejoué (qui est parcouru en boucle)
+ */
+static int replayed_request(struct load_client* client, uint64_t number, enum stat_op* stat, uint64_t* bytes)
+{
+    const struct load_shared *shared = client->shared;
+    const struct replay_request *request = &shared->replay[number % shared->replay_count];
+    struct http_response response;
+    int retval = ERR_NONE;
+
+    *stat = request->stat;
+
+    if (request->file != NULL) {
+        char *image = NULL;
+        size_t size = 0;
+
+        retval = read_file(request->file, &image, &size);
+        if (retval == ERR_NONE)
+            retval = request_insert(client, request->pict_id, image, size, &response);
+
+        free(image);
+    } else {
+        retval = request_get(client, request->method, request->uri, &response, 0);
+    }
+
+    *bytes = (retval == ERR_NONE) ? response.length : 0;
+
+    return response_error(retval, &response);
+}
+
+/********************************************************************//**
+ * Boucle d'un client : les requêtes sont réparties entre les clients au fur
+ * et à mesure
+ */
+static void* client_run(void* arg)
+{
+    struct load_client *client = (struct load_client*)arg;
+    struct load_shared *shared = client->shared;
+    uint64_t number = 0;
+
+    while ((number = __atomic_fetch_add(&shared->next, 1, __ATOMIC_RELAXED)) < shared->config->requests) {
+        enum stat_op stat = NB_STATS;
+        uint64_t bytes = 0;
+
+        const uint64_t start = stats_now();
+        const int retval = (shared->replay != NULL)
+                           ? replayed_request(client, number, &stat, &bytes)
+                           : generated_request(client, number, &stat, &bytes);
+        stats_record(stat, start, retval);
+
+        __atomic_fetch_add(&shared->total, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&shared->bytes, bytes, __ATOMIC_RELAXED);
+        if (retval != ERR_NONE)
+            __atomic_fetch_add(&shared->errors, 1, __ATOMIC_RELAXED);
+    }
+
+    if (client->fd >= 0)
+        close(client->fd);
+
+    return NULL;
+}
+
+/********************************************************************//**
+ * Copie la valeur (chaîne) du champ name d'un objet JSON d'une ligne
+ * @return 1 si le champ est trouvé, 0 sinon
+ */
+static int json_field(const char* line, const char* name, char* value, size_t size)
+{
+    char key[LOAD_MAX_METHOD + 3];
+    snprintf(key, sizeof(key), "\"%s\"", name);
+
+    const char *p = strstr(line, key);
+    if (p == NULL)
+        return 0;
+
+    p += strlen(key);
+    while (*p == ' ' || *p == '\t' || *p == ':')
+        p++;
+
+    if (*p++ != '"')
+        return 0;
+
+    size_t length = 0;
+    while (*p != '\0' && *p != '"' && length + 1 < size) {
+        if (*p == '\\' && p[1] != '\0')
+            p++;
+
+        value[length++] = *p++;
+    }
+
+    value[length] = '\0';
+
+    return 1;
+}
+
+/********************************************************************//**
+ * Histogramme d'une requête du journal, selon son chemin
+ */
+static enum stat_op uri_stat(const char* uri)
+{
+    static const struct {
+        const char* path;
+        enum stat_op stat;
+    } paths[] = {
+        { "/pictDB/list", STAT_HTTP_LIST },
+        { "/pictDB/read", STAT_HTTP_READ },
+        { "/pictDB/insert", STAT_HTTP_INSERT },
+        { "/pictDB/delete", STAT_HTTP_DELETE },
+        { "/pictDB/stats", STAT_HTTP_STATS },
+        { "/metrics", STAT_HTTP_METRICS },
+        { "/pictDB/trace", STAT_HTTP_TRACE }
+    };
+
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        const size_t length = strlen(paths[i].path);
+
+        if (!strncmp(uri, paths[i].path, length) && (uri[length] == '\0' || uri[length] == '?'))
+            return paths[i].stat;
+    }
+
+    return NB_STATS;
+}
+
+/********************************************************************//**
+ * Analyse une ligne du journal
+ * @return 1 si la ligne décrit une requête, 0 sinon
+ */
+static int parse_replay_line(const char* line, struct replay_request* request)
+{
+    char uri[LOAD_MAX_URI + 1] = "", file[LOAD_MAX_URI + 1] = "", pict_id[LOAD_MAX_ID + 1] = "";
+
+    strcpy(request->method, "GET");
+
+    if (line[0] == '{') {
+        if (!json_field(line, "uri", uri, sizeof(uri)) && !json_field(line, "url", uri, sizeof(uri))
+            && !json_field(line, "path", uri, sizeof(uri)))
+            return 0;
+
+        json_field(line, "method", request->method, sizeof(request->method));
+        json_field(line, "file", file, sizeof(file));
+        json_field(line, "pict_id", pict_id, sizeof(pict_id));
+    } else if (sscanf(line, "%15s %1023s", request->method, uri) != 2) {
+        return 0;
+    }
+
+    // URL complète : seul le chemin est gardé
+    const char *path = uri;
+    if (!strncmp(path, "http://", strlen("http://"))) {
+        path = strchr(path + strlen("http://"), '/');
+        if (path == NULL)
+            path = "/";
+    }
+
+    if (path[0] != '/')
+        return 0;
+
+    request->uri = strdup(path);
+    request->file = NULL;
+    request->pict_id = NULL;
+    request->stat = uri_stat(path);
+
+    // Insertion : l'identifiant est, par défaut, le nom du fichier
+    if (file[0] != '\0') {
+        const char *name = strrchr(file, '/');
+
+        request->file = strdup(file);
+        request->pict_id = strdup((pict_id[0] != '\0') ? pict_id : (name != NULL) ? name + 1 : file);
+    }
+
+    return 1;
+}
+
+/********************************************************************//**
+ * Lit le journal à rejouer
+ */
+static int load_replay(const char* filename, struct load_shared* shared)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+        return ERR_IO;
+
+    char line[LOAD_MAX_LINE + 1];
+    uint32_t capacity = 0, skipped = 0;
+    int retval = ERR_NONE;
+
+    while (retval == ERR_NONE && fgets(line, sizeof(line), file) != NULL) {
+        if (shared->replay_count == capacity) {
+            capacity = (capacity == 0) ? 256 : capacity * 2;
+
+            struct replay_request *replay = realloc(shared->replay, capacity * sizeof(struct replay_request));
+            if (replay == NULL) {
+                retval = ERR_OUT_OF_MEMORY;
+                break;
+            }
+
+            shared->replay = replay;
+        }
+
+        struct replay_request *request = &shared->replay[shared->replay_count];
+
+        if (!parse_replay_line(line, request)) {
+            skipped++;
+            continue;
+        }
+
+        shared->replay_count++;
+
+        if (request->uri == NULL || (request->file != NULL && request->pict_id == NULL))
+            retval = ERR_OUT_OF_MEMORY;
+    }
+
+    fclose(file);
+
+    if (retval == ERR_NONE && shared->replay_count == 0)
+        retval = ERR_INVALID_ARGUMENT;
+
+    fprintf(stderr, "replay: %" PRIu32 " request(s), %" PRIu32 " line(s) skipped\n", shared->replay_count, skipped);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Identifiants lus : ceux de la liste du serveur, avec la fonction de
+ * répartition de leur popularité (loi de Zipf d'exposant config->zipf)
+ */
+static int load_keys(struct load_client* client)
+{
+    struct load_shared *shared = client->shared;
+    const struct load_config *config = shared->config;
+    struct http_response response;
+
+    int retval = request_get(client, "GET", "/pictDB/list", &response, 1);
+    retval = response_error(retval, &response);
+    if (retval != ERR_NONE) {
+        free(response.body);
+        return retval;
+    }
+
+    // { "Pictures": [ "id1", "id2", ... ] }
+    uint32_t capacity = 0;
+    char *p = strchr(response.body, '[');
+
+    while (p != NULL && (config->keys == 0 || shared->key_count < config->keys)
+           && (p = strchr(p, '"')) != NULL) {
+        char pict_id[LOAD_MAX_ID + 1];
+        size_t length = 0;
+
+        for (p++; *p != '\0' && *p != '"'; p++) {
+            if (*p == '\\' && p[1] != '\0')
+                p++;
+            if (length < LOAD_MAX_ID)
+                pict_id[length++] = *p;
+        }
+
+        if (*p == '"')
+            p++;
+
+        pict_id[length] = '\0';
+
+        if (shared->key_count == capacity) {
+            capacity = (capacity == 0) ? 256 : capacity * 2;
+
+            char **keys = realloc(shared->keys, capacity * sizeof(char*));
+            if (keys == NULL) {
+                retval = ERR_OUT_OF_MEMORY;
+                break;
+            }
+
+            shared->keys = keys;
+        }
+
+        shared->keys[shared->key_count] = strdup(pict_id);
+        if (shared->keys[shared->key_count] == NULL) {
+            retval = ERR_OUT_OF_MEMORY;
+            break;
+        }
+
+        shared->key_count++;
+    }
+
+    free(response.body);
+
+    if (retval != ERR_NONE || shared->key_count == 0)
+        return (retval != ERR_NONE) ? retval : ERR_FILE_NOT_FOUND;
+
+    // Popularité du rang r proportionnelle à 1 / (r + 1)^s
+    shared->cdf = malloc(shared->key_count * sizeof(double));
+    if (shared->cdf == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < shared->key_count; i++) {
+        sum += 1.0 / pow((double)i + 1.0, config->zipf);
+        shared->cdf[i] = sum;
+    }
+
+    for (uint32_t i = 0; i < shared->key_count; i++)
+        shared->cdf[i] /= sum;
+
+    fprintf(stderr, "keys: %" PRIu32 " picture(s), zipf %.2f\n", shared->key_count, config->zipf);
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Lecture des options
+ */
+static int parse_options(int argc, char* argv[], struct load_config* config)
+{
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            return ERR_NOT_ENOUGH_ARGUMENTS;
+
+        const char *option = argv[i], *value = argv[++i];
+
+        if (!strcmp(option, "-host")) {
+            config->host = value;
+        } else if (!strcmp(option, "-port")) {
+            config->port = value;
+        } else if (!strcmp(option, "-clients")) {
+            config->clients = atouint32(value);
+            if (config->clients == 0 || config->clients > LOAD_MAX_CLIENTS)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-requests")) {
+            config->requests = atouint32(value);
+            if (config->requests == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-mix")) {
+            // lectures:listes:insertions
+            if (sscanf(value, "%" SCNu32 ":%" SCNu32 ":%" SCNu32, &config->mix[LOAD_READ],
+                       &config->mix[LOAD_LIST], &config->mix[LOAD_INSERT]) != NB_LOAD_KINDS
+                || config->mix[LOAD_READ] + config->mix[LOAD_LIST] + config->mix[LOAD_INSERT] == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-zipf")) {
+            char *end = NULL;
+            config->zipf = strtod(value, &end);
+            if (end == value || *end != '\0' || config->zipf < 0.0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-keys")) {
+            config->keys = atouint32(value);
+            if (config->keys == 0)
+                return ERR_INVALID_ARGUMENT;
+        } else if (!strcmp(option, "-res")) {
+            if (strcmp(value, "thumb") && strcmp(value, "small") && strcmp(value, "orig") && strcmp(value, "mixed"))
+                return ERR_RESOLUTIONS;
+            config->res = value;
+        } else if (!strcmp(option, "-keepalive")) {
+            if (strcmp(value, "on") && strcmp(value, "off"))
+                return ERR_INVALID_ARGUMENT;
+            config->keep_alive = !strcmp(value, "on");
+        } else if (!strcmp(option, "-image")) {
+            config->image = value;
+        } else if (!strcmp(option, "-replay")) {
+            config->replay = value;
+        } else if (!strcmp(option, "-seed")) {
+            config->seed = atouint32(value);
+        } else {
+            return ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Écrit le bilan en JSON sur stdout
+ */
+static void print_results(const struct load_shared* shared, double seconds)
+{
+    const struct load_config *config = shared->config;
+    int first = 1;
+
+    printf("{ \"clients\": %" PRIu32 ", \"keepalive\": %s, \"requests\": %" PRIu64 ", \"errors\": %" PRIu64
+           ", \"seconds\": %.3f, \"requests_per_sec\": %.1f, \"bytes\": %" PRIu64 ", \"endpoints\": {",
+           config->clients, config->keep_alive ? "true" : "false", shared->total, shared->errors, seconds,
+           (seconds > 0.0) ? (double)shared->total / seconds : 0.0, shared->bytes);
+
+    for (int op = STAT_HTTP_FIRST; op < NB_STATS; op++) {
+        struct stat_summary summary;
+        stats_summary((enum stat_op)op, &summary);
+
+        if (summary.count == 0)
+            continue;
+
+        printf("%s\n    \"%s\": { \"count\": %" PRIu64 ", \"errors\": %" PRIu64 ", \"requests_per_sec\": %.1f"
+               ", \"p50_ns\": %" PRIu64 ", \"p90_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %" PRIu64
+               ", \"max_ns\": %" PRIu64 " }", first ? "" : ",", STAT_NAMES[op], summary.count, summary.errors,
+               (seconds > 0.0) ? (double)summary.count / seconds : 0.0, summary.p50, summary.p90, summary.p99,
+               summary.p999, summary.max);
+        first = 0;
+    }
+
+    printf("\n} }\n");
+}
+
+/********************************************************************//**
+ * MAIN
+ */
+int main (int argc, char* argv[])
+{
+    struct load_config config = { LOAD_DEFAULT_HOST, LOAD_DEFAULT_PORT, LOAD_DEFAULT_CLIENTS, 0,
+        { 90, 5, 5 }, LOAD_DEFAULT_ZIPF, 0, "orig", 1, LOAD_DEFAULT_IMAGE, NULL, 0
+    };
+    struct load_shared shared;
+    struct load_client *clients = NULL;
+    uint32_t started = 0;
+
+    memset(&shared, 0, sizeof(struct load_shared));
+    shared.config = &config;
+    config.seed = (uint64_t)time(NULL);
+
+    int retval = parse_options(argc, argv, &config);
+    if (retval != ERR_NONE)
+        goto error;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(config.host, config.port, &hints, &shared.address) != 0) {
+        retval = ERR_IO;
+        goto error;
+    }
+
+    clients = calloc(config.clients, sizeof(struct load_client));
+    if (clients == NULL) {
+        retval = ERR_OUT_OF_MEMORY;
+        goto error;
+    }
+
+    for (uint32_t i = 0; i < config.clients; i++) {
+        clients[i].shared = &shared;
+        clients[i].fd = -1;
+        clients[i].state = (config.seed + i + 1) * UINT64_C(0x9E3779B97F4A7C15) | 1;
+        clients[i].buffer = malloc(LOAD_BUFFER_SIZE);
+
+        if (clients[i].buffer == NULL) {
+            retval = ERR_OUT_OF_MEMORY;
+            goto error;
+        }
+    }
+
+    if (config.replay != NULL) {
+        // Par défaut, le journal est rejoué une fois
+        retval = load_replay(config.replay, &shared);
+        if (retval != ERR_NONE)
+            goto error;
+
+        if (config.requests == 0)
+            config.requests = shared.replay_count;
+    } else {
+        if (config.requests == 0)
+            config.requests = LOAD_DEFAULT_REQUESTS;
+
+        if (config.mix[LOAD_READ] > 0) {
+            retval = load_keys(&clients[0]);
+            if (retval != ERR_NONE) {
+                fprintf(stderr, "no picture to read: insert some first, or use -mix 0:<list>:<insert>\n");
+                goto error;
+            }
+        }
+
+        if (config.mix[LOAD_INSERT] > 0) {
+            retval = read_file(config.image, &shared.image, &shared.image_size);
+            if (retval != ERR_NONE)
+                goto error;
+        }
+
+        snprintf(shared.id_prefix, sizeof(shared.id_prefix), "load%" PRIx64 "-", config.seed);
+    }
+
+    // Charge
+    const uint64_t start = stats_now();
+
+    for (started = 0; started < config.clients; started++) {
+        if (pthread_create(&clients[started].thread, NULL, client_run, &clients[started]) != 0) {
+            retval = ERR_INTERNAL;
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < started; i++)
+        pthread_join(clients[i].thread, NULL);
+
+    if (retval != ERR_NONE)
+        goto error;
+
+    const double seconds = (double)(stats_now() - start) / 1e9;
+
+    fprintf(stderr, "%" PRIu64 " request(s), %" PRIu64 " error(s) in %.3f s: %.1f requests/s, %.1f MB/s (%s)\n",
+            shared.total, shared.errors, seconds, (seconds > 0.0) ? (double)shared.total / seconds : 0.0,
+            (seconds > 0.0) ? (double)shared.bytes / seconds / (1024.0 * 1024.0) : 0.0,
+            config.keep_alive ? "keep-alive" : "one connection per request");
+    stats_print(stderr);
+    print_results(&shared, seconds);
+
+error:
+    if (retval != ERR_NONE) {
+        fprintf(stderr, "ERROR: %s\n", ERROR_MESSAGES[retval]);
+        fprintf(stderr, "pictDB_load [-host <addr>] [-port <port>] [-clients <N>] [-requests <N>]\n"
+                "            [-mix <read>:<list>:<insert>] [-zipf <s>] [-keys <N>] [-res <thumb|small|orig|mixed>]\n"
+                "            [-keepalive <on|off>] [-image <jpeg>] [-replay <log>] [-seed <N>]\n");
+    }
+
+    for (uint32_t i = 0; clients != NULL && i < config.clients; i++)
+        free(clients[i].buffer);
+
+    for (uint32_t i = 0; i < shared.key_count; i++)
+        free(shared.keys[i]);
+
+    for (uint32_t i = 0; i < shared.replay_count; i++) {
+        free(shared.replay[i].uri);
+        free(shared.replay[i].file);
+        free(shared.replay[i].pict_id);
+    }
+
+    free(clients);
+    free(shared.keys);
+    free(shared.cdf);
+    free(shared.replay);
+    free(shared.image);
+
+    if (shared.address != NULL)
+        freeaddrinfo(shared.address);
+
+    return retval;
+}
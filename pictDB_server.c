@@ -6,15 +6,40 @@
  */
 
 #include <signal.h>
+#include <ctype.h> // pour isdigit
+#include <inttypes.h> // pour PRIu32
 #include <vips/vips.h>
 
 #include "mongoose.h"
 #include "pictDB.h"
+#include "image_content.h"
+#include "image_cache.h"
+#include "pictDBM_tools.h"
+#include "volume.h"
+#include "scrub.h"
+#include "dedup.h"
+#include "crc32c.h"
+#include "buffer_pool.h"
+#include "request_arena.h"
+#include "stats.h"
+#include "metrics.h"
+#include "trace.h"
+#include "probes.h"
 
 #define LISTEN_ADDR "localhost"
 #define LISTEN_PORT "8000"
 #define MAX_QUERY_PARAM 5
 #define MAX_QUERY_LENGTH ((MAX_PIC_ID + 1) * MAX_QUERY_PARAM - 1)
+#define MAX_RANGE_LENGTH 63 // taille max de la valeur d'un en-tête Range
+#define ETAG_SHA_BYTES 8 // nombre d'octets du SHA repris dans l'ETag
+#define MAX_ETAG_LENGTH 63
+#define MAX_HEADERS_LENGTH 255
+#define MEGABYTE (1024 * 1024)
+#define MAX_LIST_FIELDS 63 // taille max du paramètre fields de /pictDB/list
+#define SCRUB_DEFAULT_RATE 8 // débit par défaut du scrubber (Mo/s)
+#define SCRUB_INTERVAL 100 // attente max entre deux étapes du scrubber (ms)
+#define SCRUB_PASS_INTERVAL 3600 // attente min entre deux parcours complets du scrubber (s)
+#define TRACE_DUMP_FILE "pictdb_trace.json" // fichier des traces écrit sur SIGUSR1
 
 #define LAST_HANDLE_MAPPING(cmd) \
     (cmd.uri == NULL || cmd.function == NULL)
@@ -31,6 +56,14 @@ int help (struct mg_connection *nc, struct http_message *hm);
  */
 void mg_error(struct mg_connection* nc, int error);
 
+/**
+ * @brief Indique si le client garde la connexion ouverte après la réponse
+ * (HTTP/1.1 sans en-tête "Connection: close")
+ * @param hm La requête reçue
+ * @return 1 si la connexion peut être réutilisée, 0 sinon
+ */
+int keep_alive (struct http_message *hm);
+
 /**
  * @brief Envoie la liste des images
  * @param nc La connexion demandant la liste des images
@@ -48,13 +81,31 @@ int handle_list_call (struct mg_connection *nc, struct http_message *hm);
 int handle_read_call (struct mg_connection *nc, struct http_message *hm);
 
 /**
- * @brief Insert l'image donnée
+ * @brief Insert l'image donnée. Les insertions multipart sont reçues en flux
+ * par handle_insert_part : cette fonction ne traite que les requêtes
+ * d'insertion qui ne contiennent pas d'image.
  * @param nc La connexion insérant une image
  * @param hm Le contenu de la requête insérant une image
  * @return ERR_NONE si tout s'est bien passé, sinon le code d'erreur approprié
  */
 int handle_insert_call (struct mg_connection *nc, struct http_message *hm);
 
+/**
+ * @brief Insert l'image reçue en flux, morceau par morceau, sans jamais
+ * garder la requête complète en mémoire.
+ * @param nc La connexion insérant une image
+ * @param ev Évènement multipart (MG_EV_HTTP_PART_BEGIN, _DATA ou _END)
+ * @param mp Partie du message multipart concernée
+ */
+void handle_insert_part (struct mg_connection *nc, int ev, struct mg_http_multipart_part *mp);
+
+/**
+ * @brief Abandonne l'insertion en flux encore en cours sur une connexion
+ * qui se ferme (client déconnecté, ou réponse d'erreur déjà envoyée)
+ * @param nc La connexion qui se ferme
+ */
+void handle_insert_close (struct mg_connection *nc);
+
 /**
  * @brief Supprime une image demandée
  * @param nc La connexion supprimant une image
@@ -63,6 +114,32 @@ int handle_insert_call (struct mg_connection *nc, struct http_message *hm);
  */
 int handle_delete_call (struct mg_connection *nc, struct http_message *hm);
 
+/**
+ * @brief Envoie les compteurs et latences des opérations (cf. stats.h), en JSON
+ * @param nc La connexion demandant les compteurs
+ * @param hm Le contenu de la requête
+ * @return ERR_NONE si tout s'est bien passé, sinon le code d'erreur approprié
+ */
+int handle_stats_call (struct mg_connection *nc, struct http_message *hm);
+
+/**
+ * @brief Envoie les compteurs du serveur au format texte de Prometheus
+ * (cf. metrics.h)
+ * @param nc La connexion demandant les compteurs
+ * @param hm Le contenu de la requête
+ * @return ERR_NONE si tout s'est bien passé, sinon le code d'erreur approprié
+ */
+int handle_metrics_call (struct mg_connection *nc, struct http_message *hm);
+
+/**
+ * @brief Envoie les dernières étapes tracées au format Chrome trace-event
+ * (cf. trace.h), à ouvrir dans chrome://tracing ou Perfetto
+ * @param nc La connexion demandant les traces
+ * @param hm Le contenu de la requête
+ * @return ERR_NONE si tout s'est bien passé, sinon le code d'erreur approprié
+ */
+int handle_trace_call (struct mg_connection *nc, struct http_message *hm);
+
 /**
  * @brief Sépare les paramètres de la query_string
  * @param result Nombre maximum de paramètre que nous accepterons
@@ -73,35 +150,99 @@ int handle_delete_call (struct mg_connection *nc, struct http_message *hm);
  */
 void split (char* result[], char* tmp, const char* src, const char* delim, size_t len);
 
+/**
+ * @brief Affiche les compteurs des caches d'images, cumulés sur tous les volumes
+ * @param volumes Les volumes servis
+ */
+void print_cache_stats (const struct volume_set* volumes);
+
+/**
+ * @brief Résultat de l'analyse d'un en-tête Range
+ */
+enum range_status {
+    RANGE_IGNORED, // En-tête absent, multiple ou invalide : on envoie toute l'image
+    RANGE_OK, // Un seul intervalle satisfiable
+    RANGE_UNSATISFIABLE // Intervalle en dehors de l'image
+};
+
+/**
+ * @brief Analyse la valeur d'un en-tête Range de la forme "bytes=debut-fin",
+ * "bytes=debut-" ou "bytes=-suffixe". Les requêtes à intervalles multiples
+ * sont ignorées (l'image complète est alors envoyée).
+ * @param range Valeur de l'en-tête Range
+ * @param total Taille de l'image demandée
+ * @param from Position du premier octet demandé
+ * @param length Nombre d'octets demandés
+ * @return RANGE_OK, RANGE_IGNORED ou RANGE_UNSATISFIABLE
+ */
+enum range_status parse_range (const struct mg_str* range, uint32_t total, uint32_t* from, uint32_t* length);
+
+/**
+ * @brief Construit l'ETag (fort) d'une image dans une résolution donnée
+ * @param metadata Metadata de l'image
+ * @param res Résolution de l'image
+ * @param etag Chaine de taille MAX_ETAG_LENGTH + 1 qui recevra l'ETag
+ */
+void make_etag (const struct pict_metadata* metadata, uint32_t res, char* etag);
+
 typedef int (*handle)(struct mg_connection *nc, struct http_message *hm);
 
+/**
+ * @brief État d'une insertion en flux, conservé entre les évènements multipart
+ */
+struct upload_state {
+    // Identifiant de l'image (le nom du fichier reçu)
+    char pict_id[MAX_PIC_ID + 1];
+    struct insert_stream stream;
+    int error;
+    // Début de la réception (cf. stats_now)
+    uint64_t start;
+};
+
 typedef struct handle_mapping {
     const char *uri;
     handle function;
+    // Compteurs et latences des requêtes traitées par ce handle
+    enum stat_op stat;
 } handle_mapping;
 
 // Tableau des handles disponibles
 static const handle_mapping handles[] = {
-    { "/pictDB/list", handle_list_call },
-    { "/pictDB/read", handle_read_call },
-    { "/pictDB/insert", handle_insert_call },
-    { "/pictDB/delete", handle_delete_call },
-    { NULL, NULL }
+    { "/pictDB/list", handle_list_call, STAT_HTTP_LIST },
+    { "/pictDB/read", handle_read_call, STAT_HTTP_READ },
+    { "/pictDB/insert", handle_insert_call, STAT_HTTP_INSERT },
+    { "/pictDB/delete", handle_delete_call, STAT_HTTP_DELETE },
+    { "/pictDB/stats", handle_stats_call, STAT_HTTP_STATS },
+    { "/metrics", handle_metrics_call, STAT_HTTP_METRICS },
+    { "/pictDB/trace", handle_trace_call, STAT_HTTP_TRACE },
+    { NULL, NULL, NB_STATS }
 };
 
 static int signal_received = 0;
+// Écriture des traces demandée par SIGUSR1
+static volatile sig_atomic_t trace_requested = 0;
 static struct mg_serve_http_opts http_server_opts;
 
+// Mémoire des handlers pour la requête en cours (un seul thread de
+// traitement), remise à zéro dès que la réponse est prête
+static struct request_arena request_arena;
+
 static void signal_handler (int signum)
 {
     signal(signum, signal_handler);
     signal_received = signum;
 }
 
+static void trace_signal_handler (int signum)
+{
+    signal(signum, trace_signal_handler);
+    trace_requested = 1;
+}
+
 static void pictdb_handler (struct mg_connection* nc, int ev, void *p)
 {
-    // On ne gère qu'un cas, pas besoin de switch/case
-    if (ev == MG_EV_HTTP_REQUEST) {
+    switch (ev) {
+    case MG_EV_HTTP_REQUEST: {
         int retval = ERR_NONE;
         int handle_defined = 0, i = 0;
         struct http_message *hm = (struct http_message*)p;
@@ -110,8 +251,14 @@ static void pictdb_handler (struct mg_connection* nc, int ev, void *p)
             handle_mapping handle = handles[i];
 
             if (!mg_vcmp(&hm->uri, handle.uri)) {
+                const uint64_t start = stats_now();
+
                 handle_defined = 1;
+                PROBE_HTTP_ENTRY(handle.uri, hm->query_string.p, hm->query_string.len);
                 retval = handle.function(nc, hm);
+                stats_record(handle.stat, start, retval);
+                PROBE_HTTP_RETURN(handle.uri, retval);
+                trace_end(handle.uri, start, "%.*s", (int)hm->query_string.len, hm->query_string.p);
                 break;
             }
 
@@ -123,17 +270,44 @@ static void pictdb_handler (struct mg_connection* nc, int ev, void *p)
         else if (!handle_defined)
             mg_serve_http(nc, hm, http_server_opts);
 
-        nc->flags |= MG_F_SEND_AND_CLOSE;
+        // La réponse a été copiée dans le buffer d'envoi de la connexion
+        request_arena_reset(&request_arena);
+
+        // Seules les réponses réussies de l'API (qui ont toutes une longueur)
+        // laissent la connexion ouverte pour les requêtes suivantes
+        if (!handle_defined || retval != ERR_NONE || !keep_alive(hm))
+            nc->flags |= MG_F_SEND_AND_CLOSE;
+        break;
     }
 
+    case MG_EV_HTTP_MULTIPART_REQUEST: {
+        // Seule l'insertion accepte un contenu multipart
+        struct http_message *hm = (struct http_message*)p;
+
+        if (mg_vcmp(&hm->uri, "/pictDB/insert")) {
+            mg_error(nc, ERR_INVALID_COMMAND);
+            nc->flags |= MG_F_SEND_AND_CLOSE;
+        }
+        break;
+    }
+
+    case MG_EV_HTTP_PART_BEGIN:
+    case MG_EV_HTTP_PART_DATA:
+    case MG_EV_HTTP_PART_END:
+        handle_insert_part(nc, ev, (struct mg_http_multipart_part*)p);
+        break;
+
+    case MG_EV_CLOSE:
+        handle_insert_close(nc);
+        break;
+    }
 }
 
 int main (int argc, char *argv[])
 {
     int retval = ERR_NONE;
-    struct pictdb_file db_file = {
-        .fpdb = NULL, .header = { }, .metadata = NULL
-    };
+    struct volume_set volumes;
+    memset(&volumes, 0, sizeof(struct volume_set));
 
     struct mg_mgr mgr;
     struct mg_connection *nc = NULL;
@@ -145,22 +319,78 @@ int main (int argc, char *argv[])
     /* Comme mg_mgr_init() ne peut pas échouer,
      * l'init est fait ici pour ne pas segfault en cas d'erreur.
      */
-    mg_mgr_init(&mgr, &db_file);
+    mg_mgr_init(&mgr, &volumes);
 
     signal(SIGTERM, signal_handler);
     signal(SIGINT, signal_handler);
+    signal(SIGUSR1, trace_signal_handler);
 
     if (argc < 2) {
         retval = ERR_NOT_ENOUGH_ARGUMENTS;
         goto error;
     }
 
-    // Init pictDB
-    retval = do_open(argv[1], "r+", &db_file);
+    // Init pictDB (un fichier ou un répertoire de volumes), avec l'index
+    // des volumes et l'index trié des identifiants de chaque volume
+    retval = volume_open(argv[1], "r+", &volumes);
     if (retval != ERR_NONE)
         goto error;
 
-    print_header(&db_file.header);
+    for (uint32_t i = 0; i < volumes.count; i++)
+        print_header(&volumes.volumes[i]->header);
+
+    // Options
+    uint32_t cache_size = CACHE_DEFAULT_SIZE / MEGABYTE;
+    uint32_t scrub_rate = SCRUB_DEFAULT_RATE;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-cache_size") && i + 1 < argc) {
+            cache_size = atouint32(argv[++i]);
+
+            if (cache_size == 0 && strcmp(argv[i], "0")) {
+                retval = ERR_INVALID_ARGUMENT;
+                goto error;
+            }
+        } else if (!strcmp(argv[i], "-volume_size") && i + 1 < argc) {
+            volumes.max_size = (uint64_t)atouint32(argv[++i]) * MEGABYTE;
+
+            if (volumes.max_size == 0) {
+                retval = ERR_INVALID_ARGUMENT;
+                goto error;
+            }
+        } else if (!strcmp(argv[i], "-verify")) {
+            volume_set_verify(&volumes, 1);
+        } else if (!strcmp(argv[i], "-scrub_rate") && i + 1 < argc) {
+            scrub_rate = atouint32(argv[++i]);
+
+            if (scrub_rate == 0 && strcmp(argv[i], "0")) {
+                retval = ERR_INVALID_ARGUMENT;
+                goto error;
+            }
+        } else if (!strcmp(argv[i], "-trace")) {
+            // Nombre d'étapes gardées, optionnel
+            size_t events = TRACE_DEFAULT_EVENTS;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) {
+                events = atouint32(argv[++i]);
+
+                if (events == 0) {
+                    retval = ERR_INVALID_ARGUMENT;
+                    goto error;
+                }
+            }
+
+            retval = trace_enable(events);
+            if (retval != ERR_NONE)
+                goto error;
+        } else {
+            retval = ERR_INVALID_ARGUMENT;
+            goto error;
+        }
+    }
+
+    // Cache des images les plus lues (désactivé si taille nulle)
+    retval = volume_set_cache(&volumes, (size_t)cache_size * MEGABYTE);
+    if (retval != ERR_NONE)
+        goto error;
 
     // Start listening
     nc = mg_bind(&mgr, LISTEN_PORT, pictdb_handler);
@@ -173,23 +403,65 @@ int main (int argc, char *argv[])
 
     http_server_opts.document_root = ".";
 
-    // Polling
+    // Polling, avec vérification des images en tâche de fond
+    struct scrubber scrubber;
+    scrub_init(&scrubber);
+
+    const uint64_t scrub_bytes = (uint64_t)scrub_rate * MEGABYTE;
+    double last_scrub = mg_time();
+    double next_pass = last_scrub;
+
+    printf("CRC32C: %s\n", crc32c_implementation());
+
     while (!signal_received) {
-        mg_mgr_poll(&mgr, 1000);
+        mg_mgr_poll(&mgr, scrub_rate > 0 ? SCRUB_INTERVAL : 1000);
+
+        if (scrub_rate > 0) {
+            double now = mg_time();
+
+            if (now >= next_pass
+                && scrub_step(&scrubber, &volumes, (uint64_t)((now - last_scrub) * (double)scrub_bytes), scrub_bytes))
+                next_pass = now + SCRUB_PASS_INTERVAL;
+
+            last_scrub = now;
+        }
+
+        if (trace_requested) {
+            trace_requested = 0;
+
+            int err = trace_dump(TRACE_DUMP_FILE);
+            if (err == ERR_NONE)
+                printf("Trace written to %s\n", TRACE_DUMP_FILE);
+            else
+                fprintf(stderr, "ERROR: trace: %s\n", ERROR_MESSAGES[err]);
+        }
     }
 
     // Exciting
     printf("Exciting on signal %d\n", signal_received);
+    print_cache_stats(&volumes);
+    stats_print(stdout);
+
+    if (scrub_rate > 0)
+        printf("SCRUB: %" PRIu64 " image(s), %" PRIu64 " bytes, %" PRIu64 " error(s), %" PRIu64 " full pass(es), "
+               "%" PRIu64 " SHA computed\n", scrubber.images, scrubber.bytes, scrubber.errors, scrubber.passes,
+               scrubber.hashed);
 
     mg_mgr_free(&mgr);
-    do_close(&db_file);
+    volume_close(&volumes);
+    request_arena_free(&request_arena);
+    buffer_pool_flush();
+    trace_free();
     vips_shutdown();
 
     return ERR_NONE;
 
 error:
     mg_mgr_free(&mgr);
-    do_close(&db_file);
+    volume_close(&volumes);
+    request_arena_free(&request_arena);
+    buffer_pool_flush();
+    trace_free();
     vips_shutdown();
 
     fprintf(stderr, "ERROR: %s\n", ERROR_MESSAGES[retval]);
@@ -200,11 +472,33 @@ error:
 
 int help (struct mg_connection *nc, struct http_message *hm)
 {
-    printf("pictDB_server <dbfilename>\n");
+    printf("pictDB_server <dbfilename> [options]\n");
+    printf("      <dbfilename> is either a pictDB file or a directory of pictDB volumes.\n");
+    printf("      options are:\n");
+    printf("          -cache_size <MB>: memory budget of the image cache, shared by the volumes.\n");
+    printf("                            default value is %d, 0 disables the cache\n", CACHE_DEFAULT_SIZE / MEGABYTE);
+    printf("          -volume_size <MB>: size from which a new volume receives the insertions.\n");
+    printf("                            default value is %" PRIu64 "\n", VOLUME_MAX_SIZE / MEGABYTE);
+    printf("          -verify: check the CRC32C of every image read from disk.\n");
+    printf("          -scrub_rate <MB/s>: rate at which stored images are re-read and\n");
+    printf("                            checked in the background, one full pass\n");
+    printf("                            at most every %d seconds.\n", SCRUB_PASS_INTERVAL);
+    printf("                            default value is %d, 0 disables the scrubber\n", SCRUB_DEFAULT_RATE);
+    printf("          -trace [events]: record the steps of each request (handler, lookup,\n");
+    printf("                            fetch, VIPS load/resize/save, store, write), served\n");
+    printf("                            on /pictDB/trace and written to %s on SIGUSR1.\n", TRACE_DUMP_FILE);
+    printf("                            the last %d steps are kept by default\n", TRACE_DEFAULT_EVENTS);
 
     return ERR_NONE;
 }
 
+int keep_alive (struct http_message *hm)
+{
+    struct mg_str *connection = mg_get_http_header(hm, "Connection");
+
+    return !mg_vcmp(&hm->proto, "HTTP/1.1") && (connection == NULL || mg_vcasecmp(connection, "close"));
+}
+
 void mg_error(struct mg_connection* nc, int error)
 {
     /*
@@ -225,18 +519,64 @@ void mg_error(struct mg_connection* nc, int error)
 
 int handle_list_call (struct mg_connection *nc, struct http_message *hm)
 {
-    // Récupération de la liste
-    const char *response = do_list((struct pictdb_file*)nc->mgr->user_data, JSON);
+    struct volume_set *volumes = (struct volume_set*)nc->mgr->user_data;
+
+    // Sans paramètre, la liste complète (en cache tant que la base n'a pas changé)
+    if (hm->query_string.len == 0 && volumes->count == 1) {
+        size_t response_length = 0;
+        const char *response = do_list_json(volumes->volumes[0], &response_length);
+        if (response == NULL)
+            return ERR_INTERNAL;
+
+        mg_send_head(nc, 200, (signed long)response_length, "Content-Type: application/json");
+        mg_send(nc, response, (int)response_length);
+
+        return ERR_NONE;
+    }
+
+    // Pagination, filtre et champs optionnels
+    char after[MAX_PIC_ID + 1] = { '\0' };
+    char prefix[MAX_PIC_ID + 1] = { '\0' };
+    char limit[MAX_PIC_ID + 1] = { '\0' };
+    char fields[MAX_LIST_FIELDS + 1] = { '\0' };
+
+    struct list_query query = { NULL, NULL, 0, 0 };
+
+    if (mg_get_http_var(&hm->query_string, "after", after, sizeof(after)) > 0)
+        query.after = after;
+
+    if (mg_get_http_var(&hm->query_string, "prefix", prefix, sizeof(prefix)) > 0)
+        query.prefix = prefix;
+
+    if (mg_get_http_var(&hm->query_string, "limit", limit, sizeof(limit)) > 0) {
+        query.limit = atouint32(limit);
+        if (query.limit == 0)
+            return ERR_INVALID_PARAM;
+    }
+
+    if (mg_get_http_var(&hm->query_string, "fields", fields, sizeof(fields)) > 0) {
+        for (char *field = strtok(fields, ","); field != NULL; field = strtok(NULL, ",")) {
+            if (!strcmp(field, "sizes"))
+                query.fields |= LIST_FIELD_SIZES;
+            else if (!strcmp(field, "resolution"))
+                query.fields |= LIST_FIELD_RESOLUTION;
+            else if (!strcmp(field, "variants"))
+                query.fields |= LIST_FIELD_VARIANTS;
+            else
+                return ERR_INVALID_PARAM;
+        }
+    }
+
+    char *response = (char*)volume_list_page(volumes, JSON, &query);
     if (response == NULL)
         return ERR_INTERNAL;
 
-    // Envoi de la liste
     size_t response_length = strlen(response);
 
     mg_send_head(nc, 200, (signed long)response_length, "Content-Type: application/json");
     mg_send(nc, response, (int)response_length);
 
-    free((char*)response);
+    free(response);
 
     return ERR_NONE;
 }
@@ -266,53 +606,284 @@ int handle_read_call (struct mg_connection *nc, struct http_message *hm)
     if (resolution == -1 || pict_id == NULL)
         return ERR_INVALID_PARAM;
 
-    // Lecture de l'image
-    char *image = NULL;
-    uint32_t image_size = 0;
-    retval = do_read(pict_id, (uint32_t)resolution, &image, &image_size, (struct pictdb_file*)nc->mgr->user_data);
+    // Recherche du volume et de l'image (et création de la résolution si nécessaire)
+    struct pictdb_file *db_file = NULL;
+    retval = volume_find((struct volume_set*)nc->mgr->user_data, pict_id, &db_file);
     if (retval != ERR_NONE)
         return retval;
 
-    // Envoi de l'image
-    mg_send_head(nc, 200, (signed long)image_size, "Content-Type: image/jpeg");
-    mg_send(nc, image, (int)image_size);
+    uint32_t index = 0;
+    const uint64_t start = stats_now();
+    PROBE_READ_ENTRY(pict_id, resolution);
+    retval = do_read_prepare(pict_id, (uint32_t)resolution, &index, db_file);
+    if (retval != ERR_NONE) {
+        stats_record(STAT_READ, start, retval);
+        PROBE_READ_RETURN(pict_id, resolution, 0, retval);
+        return retval;
+    }
+
+    const struct pict_metadata *metadata = &db_file->metadata[index];
+    const uint32_t image_size = metadata->size[resolution];
+
+    char etag[MAX_ETAG_LENGTH + 1] = { '\0' };
+    make_etag(metadata, (uint32_t)resolution, etag);
+
+    // Gestion des requêtes partielles (Range / If-Range)
+    uint32_t from = 0, length = image_size;
+    enum range_status status = RANGE_IGNORED;
 
-    free(image);
+    struct mg_str *range = mg_get_http_header(hm, "Range");
+    struct mg_str *if_range = mg_get_http_header(hm, "If-Range");
+    if (range != NULL && (if_range == NULL || !mg_vcmp(if_range, etag)))
+        status = parse_range(range, image_size, &from, &length);
+
+    char headers[MAX_HEADERS_LENGTH + 1] = { '\0' };
+
+    if (status == RANGE_UNSATISFIABLE) {
+        snprintf(headers, sizeof(headers),
+                 "Content-Range: bytes */%" PRIu32 "\r\nETag: %s", image_size, etag);
+        mg_send_head(nc, 416, 0, headers);
+        stats_record(STAT_READ, start, ERR_NONE);
+        PROBE_READ_RETURN(pict_id, resolution, 0, ERR_NONE);
+
+        return ERR_NONE;
+    }
+
+    // Lecture de la portion demandée uniquement
+    char *image = request_arena_alloc(&request_arena, length);
+    if (image == NULL) {
+        stats_record(STAT_READ, start, ERR_OUT_OF_MEMORY);
+        PROBE_READ_RETURN(pict_id, resolution, 0, ERR_OUT_OF_MEMORY);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    const uint64_t fetch_start = stats_now();
+    retval = fetch_image_into(db_file, index, (uint32_t)resolution, from, length, image);
+    stats_record(STAT_READ_FETCH, fetch_start, retval);
+    stats_record(STAT_READ, start, retval);
+    PROBE_READ_RETURN(pict_id, resolution, length, retval);
+    if (retval != ERR_NONE)
+        return retval;
+
+    // Envoi de l'image
+    if (status == RANGE_OK) {
+        snprintf(headers, sizeof(headers),
+                 "Content-Type: image/jpeg\r\nAccept-Ranges: bytes\r\nETag: %s\r\n"
+                 "Content-Range: bytes %" PRIu32 "-%" PRIu32 "/%" PRIu32,
+                 etag, from, from + length - 1, image_size);
+        mg_send_head(nc, 206, (signed long)length, headers);
+    } else {
+        snprintf(headers, sizeof(headers),
+                 "Content-Type: image/jpeg\r\nAccept-Ranges: bytes\r\nETag: %s", etag);
+        mg_send_head(nc, 200, (signed long)length, headers);
+    }
+    mg_send(nc, image, (int)length);
 
     return ERR_NONE;
 }
 
+enum range_status parse_range (const struct mg_str* range, uint32_t total, uint32_t* from, uint32_t* length)
+{
+    static const char unit[] = "bytes=";
+
+    if (range == NULL || range->len > MAX_RANGE_LENGTH || total == 0)
+        return RANGE_IGNORED;
+
+    // Copie terminée par '\0' de la valeur de l'en-tête
+    char value[MAX_RANGE_LENGTH + 1] = { '\0' };
+    strncpy(value, range->p, range->len);
+    value[range->len] = '\0';
+
+    const char *cursor = value;
+    while (*cursor == ' ')
+        cursor++;
+
+    if (strncmp(cursor, unit, strlen(unit)) != 0)
+        return RANGE_IGNORED;
+    cursor += strlen(unit);
+
+    // Plusieurs intervalles : on renvoie l'image complète (RFC 7233, 3.1)
+    if (strchr(cursor, ',') != NULL)
+        return RANGE_IGNORED;
+
+    char *end = NULL;
+    int has_first = isdigit((unsigned char)*cursor);
+    unsigned long long first = 0, last = 0;
+
+    if (has_first) {
+        first = strtoull(cursor, &end, 10);
+        cursor = end;
+    }
+
+    if (*cursor != '-')
+        return RANGE_IGNORED;
+    cursor++;
+
+    int has_last = isdigit((unsigned char)*cursor);
+    if (has_last) {
+        last = strtoull(cursor, &end, 10);
+        cursor = end;
+    }
+
+    while (*cursor == ' ')
+        cursor++;
+
+    if (*cursor != '\0' || (!has_first && !has_last))
+        return RANGE_IGNORED;
+
+    if (!has_first) {
+        // Suffixe : les "last" derniers octets
+        if (last == 0)
+            return RANGE_UNSATISFIABLE;
+
+        if (last > total)
+            last = total;
+
+        *from = total - (uint32_t)last;
+        *length = (uint32_t)last;
+
+        return RANGE_OK;
+    }
+
+    if (has_last && last < first)
+        return RANGE_IGNORED;
+
+    if (first >= total)
+        return RANGE_UNSATISFIABLE;
+
+    if (!has_last || last >= total)
+        last = total - 1;
+
+    *from = (uint32_t)first;
+    *length = (uint32_t)(last - first + 1);
+
+    return RANGE_OK;
+}
+
+void make_etag (const struct pict_metadata* metadata, uint32_t res, char* etag)
+{
+    size_t written = 0;
+
+    etag[written++] = '"';
+
+    // Le CRC de l'original, fixé à l'insertion, plutôt que le SHA : celui-ci
+    // peut n'être calculé que plus tard (cf. fill_sha), et l'ETag d'une image
+    // inchangée ne doit pas changer. Seules les images insérées avant les
+    // CRC, dont le SHA est toujours connu, gardent l'ETag tiré du SHA
+    if (metadata->crc_orig != 0 || sha_pending(metadata)) {
+        written += (size_t)sprintf(&etag[written], "c%08" PRIx32, metadata->crc_orig);
+    } else {
+        for (size_t i = 0; i < ETAG_SHA_BYTES; i++)
+            written += (size_t)sprintf(&etag[written], "%02x", metadata->SHA[i]);
+    }
+
+    snprintf(&etag[written], MAX_ETAG_LENGTH + 1 - written, "-%" PRIu32 "-%" PRIu32 "\"",
+             res, metadata->size[res]);
+}
+
 int handle_insert_call (struct mg_connection *nc, struct http_message *hm)
 {
-    int retval = ERR_NONE;
+    // Une requête multipart n'arrive jamais ici : il n'y a donc pas d'image
+    return ERR_INVALID_PARAM;
+}
 
-    // Récupération de l'image dans le corps de la requête
-    char varname[MAX_PIC_ID + 1] = { '\0' };
-    size_t varname_length = MAX_PIC_ID;
+/**
+ * Fin d'une insertion en flux : mesures, puis libération de son état,
+ * détaché de la connexion
+ */
+static void upload_done (struct mg_connection *nc, struct upload_state *upload, int retval)
+{
+    stats_record(STAT_HTTP_INSERT, upload->start, retval);
+    trace_end("/pictDB/insert", upload->start, "%s", upload->pict_id);
+    PROBE_HTTP_RETURN("/pictDB/insert", retval);
 
-    char pict_id[MAX_PIC_ID + 1] = { '\0' };
-    size_t pict_id_length = MAX_PIC_ID;
+    free(upload);
+    nc->user_data = NULL;
+}
 
-    const char *image = NULL;
-    size_t image_size = 0;
+void handle_insert_part (struct mg_connection *nc, int ev, struct mg_http_multipart_part *mp)
+{
+    // L'état de l'insertion est gardé par la connexion : mongoose ne
+    // transmet pas mp->user_data lorsque le client se déconnecte
+    struct upload_state *upload = (struct upload_state*)nc->user_data;
+
+    // Réponse déjà envoyée (erreur ou autre URI) : on ignore la suite du flux
+    if (nc->flags & MG_F_SEND_AND_CLOSE)
+        return;
+
+    switch (ev) {
+    case MG_EV_HTTP_PART_BEGIN:
+        // Seules les parties contenant un fichier nous intéressent, et
+        // une seule image par requête
+        if (mp->file_name == NULL || mp->file_name[0] == '\0' || upload != NULL)
+            return;
+
+        upload = calloc(1, sizeof(struct upload_state));
+        if (upload == NULL) {
+            mg_error(nc, ERR_OUT_OF_MEMORY);
+            nc->flags |= MG_F_SEND_AND_CLOSE;
+            return;
+        }
 
-    mg_parse_multipart(hm->body.p, hm->body.len, varname, varname_length, pict_id, pict_id_length, &image, &image_size);
+        upload->start = stats_now();
+        PROBE_HTTP_ENTRY("/pictDB/insert", mp->file_name, strlen(mp->file_name));
+        strncpy(upload->pict_id, mp->file_name, MAX_PIC_ID);
 
-    if (image == NULL || image_size == 0)
-        return ERR_INVALID_PARAM;
+        // Comme auparavant, le nom du fichier sert d'identifiant d'image
+        upload->error = volume_insert_begin((struct volume_set*)nc->mgr->user_data, mp->file_name, &upload->stream);
+        nc->user_data = upload;
+        break;
 
-    // Insertion de la nouvelle image
-    retval = do_insert(image, image_size, pict_id, (struct pictdb_file*)nc->mgr->user_data);
-    if (retval != ERR_NONE)
-        return retval;
+    case MG_EV_HTTP_PART_DATA:
+        if (upload != NULL && upload->error == ERR_NONE)
+            upload->error = do_insert_append(&upload->stream, mp->data.p, mp->data.len);
+        break;
 
-    // Redirection vers l'accueil
-    mg_printf(nc,
-              "HTTP/1.1 302 Found\r\n"
-              "Location: http://%s:%s/index.html\r\n\r\n", LISTEN_ADDR, LISTEN_PORT
-             );
+    case MG_EV_HTTP_PART_END: {
+        if (upload == NULL)
+            return;
 
-    return ERR_NONE;
+        int retval = upload->error;
+
+        // Connexion interrompue (status < 0) ou erreur : abandon de l'insertion
+        if (mp->status < 0 && retval == ERR_NONE)
+            retval = ERR_IO;
+
+        if (retval == ERR_NONE)
+            retval = volume_insert_end((struct volume_set*)nc->mgr->user_data, &upload->stream);
+        else
+            do_insert_abort(&upload->stream);
+
+        upload_done(nc, upload, retval);
+
+        if (mp->status < 0)
+            return;
+
+        if (retval != ERR_NONE) {
+            mg_error(nc, retval);
+        } else {
+            // Redirection vers l'accueil
+            mg_printf(nc,
+                      "HTTP/1.1 302 Found\r\n"
+                      "Location: http://%s:%s/index.html\r\n\r\n", LISTEN_ADDR, LISTEN_PORT
+                     );
+        }
+
+        nc->flags |= MG_F_SEND_AND_CLOSE;
+        break;
+    }
+    }
+}
+
+void handle_insert_close (struct mg_connection *nc)
+{
+    struct upload_state *upload = (struct upload_state*)nc->user_data;
+    if (upload == NULL)
+        return;
+
+    do_insert_abort(&upload->stream);
+
+    upload_done(nc, upload, (upload->error != ERR_NONE) ? upload->error : ERR_IO);
 }
 
 int handle_delete_call (struct mg_connection *nc, struct http_message *hm)
@@ -338,19 +909,67 @@ int handle_delete_call (struct mg_connection *nc, struct http_message *hm)
         return ERR_INVALID_PARAM;
 
     // Suppression de l'image
-    retval = do_delete(pict_id, (struct pictdb_file*)nc->mgr->user_data);
+    retval = volume_delete((struct volume_set*)nc->mgr->user_data, pict_id);
     if (retval != ERR_NONE)
         return retval;
 
     // Redirection vers l'accueil
     mg_printf(nc,
               "HTTP/1.1 302 Found\r\n"
-              "Location: http://%s:%s/index.html\r\n\r\n", LISTEN_ADDR, LISTEN_PORT
+              "Location: http://%s:%s/index.html\r\n"
+              "Content-Length: 0\r\n\r\n", LISTEN_ADDR, LISTEN_PORT
              );
 
     return ERR_NONE;
 }
 
+int handle_stats_call (struct mg_connection *nc, struct http_message *hm)
+{
+    char *response = stats_json();
+    if (response == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    size_t response_length = strlen(response);
+
+    mg_send_head(nc, 200, (signed long)response_length, "Content-Type: application/json");
+    mg_send(nc, response, (int)response_length);
+
+    free(response);
+
+    return ERR_NONE;
+}
+
+int handle_metrics_call (struct mg_connection *nc, struct http_message *hm)
+{
+    size_t response_length = 0;
+    const char *response = metrics_prometheus((struct volume_set*)nc->mgr->user_data, &request_arena, &response_length);
+    if (response == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    mg_send_head(nc, 200, (signed long)response_length, "Content-Type: text/plain; version=0.0.4");
+    mg_send(nc, response, (int)response_length);
+
+    return ERR_NONE;
+}
+
+int handle_trace_call (struct mg_connection *nc, struct http_message *hm)
+{
+    if (!trace_enabled())
+        return ERR_INVALID_COMMAND;
+
+    size_t response_length = 0;
+    char *response = trace_json(&response_length);
+    if (response == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    mg_send_head(nc, 200, (signed long)response_length, "Content-Type: application/json");
+    mg_send(nc, response, (int)response_length);
+
+    free(response);
+
+    return ERR_NONE;
+}
+
 void split (char* result[], char* tmp, const char* src, const char* delim, size_t len)
 {
     if (src == NULL || tmp == NULL || delim == NULL || len == 0)
@@ -370,3 +989,19 @@ void split (char* result[], char* tmp, const char* src, const char* delim, size_
         tmp = NULL;
     } while (param != NULL && ++param_index < MAX_QUERY_PARAM);
 }
+
+void print_cache_stats (const struct volume_set* volumes)
+{
+    struct image_cache_stats stats;
+    volume_cache_stats(volumes, &stats);
+
+    if (stats.budget == 0)
+        return;
+
+    const uint64_t lookups = stats.hits + stats.misses;
+
+    printf("CACHE: %" PRIu64 " hit(s), %" PRIu64 " miss(es) (%.1f%% hit ratio)\n",
+           stats.hits, stats.misses, lookups > 0 ? 100.0 * (double)stats.hits / (double)lookups : 0.0);
+    printf("CACHE: %" PRIu64 " image(s), %" PRIu64 " / %" PRIu64 " bytes, %" PRIu64 " eviction(s)\n",
+           stats.entries, stats.used, stats.budget, stats.evictions);
+}
@@ -0,0 +1,78 @@
+/**
+ * @file probes.h
+ * @brief Points de sonde USDT (provider "pictdb") à l'entrée et à la sortie
+ *        des opérations de la base et des handlers du serveur.
+ *
+ * Les sondes sont celles de SystemTap (sys/sdt.h), utilisables par
+ * bpftrace, perf ou SystemTap sur un binaire déjà en production, p. ex. :
+ *
+ *   bpftrace -e 'usdt:./pictDB_server:pictdb:read__return
+ *                { @[arg3] = count(); }'
+ *
+ * Non attachée, une sonde n'est qu'une instruction nop : ses arguments,
+ * déjà calculés par l'appelant, ne sont pas copiés. Sans sys/sdt.h (ou
+ * avec PICTDB_NO_PROBES défini), les sondes disparaissent.
+ *
+ * Les identifiants passés aux sondes sont des chaînes terminées par un
+ * nul, sauf la requête HTTP, suivie de sa longueur ; err est un code de
+ * error.h.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_PROBES_H
+#define PICTDBPRJ_PROBES_H
+
+#if !defined(PICTDB_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PICTDB_PROBES 1
+#endif
+#endif
+
+#ifdef PICTDB_PROBES
+#define PICTDB_PROBE1(name, a) DTRACE_PROBE1(pictdb, name, a)
+#define PICTDB_PROBE2(name, a, b) DTRACE_PROBE2(pictdb, name, a, b)
+#define PICTDB_PROBE3(name, a, b, c) DTRACE_PROBE3(pictdb, name, a, b, c)
+#define PICTDB_PROBE4(name, a, b, c, d) DTRACE_PROBE4(pictdb, name, a, b, c, d)
+#else
+#define PICTDB_PROBE1(name, a) ((void)0)
+#define PICTDB_PROBE2(name, a, b) ((void)0)
+#define PICTDB_PROBE3(name, a, b, c) ((void)0)
+#define PICTDB_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+// Identifiant de l'image à la position index, NULL hors de la base
+#define PROBE_PICT_ID(db_file, index) \
+    ((index) < (db_file)->header.max_files ? (db_file)->metadata[(index)].pict_id : NULL)
+
+// do_read et lecture du serveur (pict_id, res[, size, err])
+#define PROBE_READ_ENTRY(pict_id, res) PICTDB_PROBE2(read__entry, pict_id, res)
+#define PROBE_READ_RETURN(pict_id, res, size, err) PICTDB_PROBE4(read__return, pict_id, res, size, err)
+
+// do_insert et insertion en flux (pict_id, size[, err])
+#define PROBE_INSERT_ENTRY(pict_id, size) PICTDB_PROBE2(insert__entry, pict_id, size)
+#define PROBE_INSERT_RETURN(pict_id, size, err) PICTDB_PROBE3(insert__return, pict_id, size, err)
+
+// do_delete (pict_id[, err])
+#define PROBE_DELETE_ENTRY(pict_id) PICTDB_PROBE1(delete__entry, pict_id)
+#define PROBE_DELETE_RETURN(pict_id, err) PICTDB_PROBE2(delete__return, pict_id, err)
+
+// lazily_resize (pict_id, res[, size de la variante, err])
+#define PROBE_RESIZE_ENTRY(pict_id, res) PICTDB_PROBE2(resize__entry, pict_id, res)
+#define PROBE_RESIZE_RETURN(pict_id, res, size, err) PICTDB_PROBE4(resize__return, pict_id, res, size, err)
+
+// fetch_image et ses variantes (pict_id, res, size[, err])
+#define PROBE_FETCH_ENTRY(pict_id, res, size) PICTDB_PROBE3(fetch__entry, pict_id, res, size)
+#define PROBE_FETCH_RETURN(pict_id, res, size, err) PICTDB_PROBE4(fetch__return, pict_id, res, size, err)
+
+// store_image (pict_id, res, size[, err])
+#define PROBE_STORE_ENTRY(pict_id, res, size) PICTDB_PROBE3(store__entry, pict_id, res, size)
+#define PROBE_STORE_RETURN(pict_id, res, size, err) PICTDB_PROBE4(store__return, pict_id, res, size, err)
+
+// Handlers du serveur (uri, query, query_len | uri, err)
+#define PROBE_HTTP_ENTRY(uri, query, query_len) PICTDB_PROBE3(http__entry, uri, query, query_len)
+#define PROBE_HTTP_RETURN(uri, err) PICTDB_PROBE2(http__return, uri, err)
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file request_arena.c
+ * @brief Zone d'allocation d'une requête du serveur.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdint.h> // pour SIZE_MAX
+#include <stdlib.h> // pour malloc, free
+
+#include "request_arena.h"
+
+#define ARENA_ALIGN 16 // alignement des allocations
+
+// Bloc de la zone ; les données suivent l'en-tête
+struct arena_block {
+    struct arena_block* next;
+    // Taille des données et octets déjà utilisés
+    size_t size;
+    size_t used;
+    // Garde les données alignées sur ARENA_ALIGN
+    long double align;
+};
+
+/********************************************************************//**
+ * Arrondit size au multiple d'ARENA_ALIGN supérieur
+ */
+static size_t align_up(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+/********************************************************************/
+void* request_arena_alloc (struct request_arena* arena, size_t size)
+{
+    if (size > SIZE_MAX / 2)
+        return NULL;
+
+    size = align_up((size == 0) ? 1 : size);
+
+    struct arena_block *block = arena->blocks;
+
+    // Bloc courant plein : nouveau bloc, au moins assez grand pour size
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+
+        block = malloc(sizeof(struct arena_block) + block_size);
+        if (block == NULL)
+            return NULL;
+
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+
+    void *data = (char*)(block + 1) + block->used;
+    block->used += size;
+    arena->used += size;
+
+    return data;
+}
+
+/********************************************************************/
+void request_arena_reset (struct request_arena* arena)
+{
+    struct arena_block *kept = NULL;
+    struct arena_block *block = arena->blocks;
+
+    // Seul le plus grand bloc (dans la limite d'ARENA_MAX_KEPT) est gardé
+    while (block != NULL) {
+        struct arena_block *next = block->next;
+
+        if (block->size <= ARENA_MAX_KEPT && (kept == NULL || block->size > kept->size)) {
+            free(kept);
+            kept = block;
+        } else {
+            free(block);
+        }
+
+        block = next;
+    }
+
+    if (kept != NULL) {
+        kept->next = NULL;
+        kept->used = 0;
+    }
+
+    arena->blocks = kept;
+    arena->used = 0;
+}
+
+/********************************************************************/
+void request_arena_free (struct request_arena* arena)
+{
+    struct arena_block *block = arena->blocks;
+
+    while (block != NULL) {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->blocks = NULL;
+    arena->used = 0;
+}
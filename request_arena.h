@@ -0,0 +1,63 @@
+/**
+ * @file request_arena.h
+ * @brief Zone d'allocation d'une requête du serveur.
+ *
+ * Les handlers du serveur prennent la mémoire dont ils ont besoin pendant
+ * une requête (image envoyée, copies temporaires) dans une zone où chaque
+ * allocation avance simplement un pointeur. Rien n'est libéré
+ * individuellement : la zone entière est remise à zéro en une opération
+ * quand la réponse est partie, et le plus grand bloc est gardé pour la
+ * requête suivante. Une zone n'est utilisée que par un seul thread.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_REQUEST_ARENA_H
+#define PICTDBPRJ_REQUEST_ARENA_H
+
+#include <stddef.h> // pour size_t
+
+#define ARENA_BLOCK_SIZE (64 * 1024) // taille minimale d'un bloc (octets)
+#define ARENA_MAX_KEPT (16 * 1024 * 1024) // plus grand bloc gardé entre deux requêtes (octets)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct arena_block;
+
+struct request_arena {
+    // Blocs de la requête en cours, le plus récent en tête
+    struct arena_block* blocks;
+    // Octets alloués depuis la dernière remise à zéro
+    size_t used;
+};
+
+/**
+ * @brief Alloue size octets (non initialisés) dans la zone, alignés comme
+ * ceux de malloc
+ * @param arena La zone
+ * @param size Nombre d'octets
+ * @return Les octets alloués, valables jusqu'au prochain request_arena_reset,
+ * ou NULL si la mémoire manque
+ */
+void* request_arena_alloc(struct request_arena* arena, size_t size);
+
+/**
+ * @brief Libère d'un coup toutes les allocations de la zone
+ * @param arena La zone
+ */
+void request_arena_reset(struct request_arena* arena);
+
+/**
+ * @brief Libère la zone et tous ses blocs
+ * @param arena La zone
+ */
+void request_arena_free(struct request_arena* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
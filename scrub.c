@@ -0,0 +1,104 @@
+/**
+ * @file scrub.c
+ * @brief Vérification en tâche de fond des CRC des images
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <string.h> // pour memset
+#include <inttypes.h> // pour PRIu32
+
+#include "scrub.h"
+#include "image_content.h"
+#include "dedup.h"
+
+#define SCRUB_MAX_VISITS 4096 // metadatas (et résolutions) parcourues au plus par étape
+
+/********************************************************************//**
+ * Passe à l'image (ou la résolution) suivante, puis au volume suivant.
+ * Retourne 1 à la fin d'un parcours complet.
+ */
+static int scrub_advance(struct scrubber* scrubber, const struct volume_set* set)
+{
+    if (++scrubber->res < NB_RES)
+        return 0;
+
+    scrubber->res = 0;
+
+    if (++scrubber->index < set->volumes[scrubber->volume]->header.max_files)
+        return 0;
+
+    scrubber->index = 0;
+
+    if (++scrubber->volume < set->count)
+        return 0;
+
+    scrubber->volume = 0;
+    scrubber->passes++;
+
+    return 1;
+}
+
+/********************************************************************/
+void scrub_init(struct scrubber* scrubber)
+{
+    memset(scrubber, 0, sizeof(struct scrubber));
+}
+
+/********************************************************************/
+int scrub_step(struct scrubber* scrubber, const struct volume_set* set, uint64_t credit, uint64_t max_credit)
+{
+    if (set->count == 0)
+        return 0;
+
+    scrubber->credit += (int64_t)credit;
+    if (scrubber->credit > (int64_t)max_credit)
+        scrubber->credit = (int64_t)max_credit;
+
+    // Étape courte, même si le crédit est grand ou les metadatas vides
+    for (uint32_t visited = 0; scrubber->credit > 0 && visited < SCRUB_MAX_VISITS; visited++) {
+        // Les volumes ont pu être ajoutés ou nettoyés depuis l'étape précédente
+        if (scrubber->volume >= set->count) {
+            scrubber->volume = 0;
+            scrubber->index = 0;
+            scrubber->res = 0;
+        }
+
+        struct pictdb_file *db_file = set->volumes[scrubber->volume];
+
+        if (scrubber->index < db_file->header.max_files && db_file->fpdb != NULL) {
+            const struct pict_metadata *metadata = &db_file->metadata[scrubber->index];
+
+            if (metadata->is_valid == NON_EMPTY && metadata->size[scrubber->res] != 0) {
+                int retval = verify_image(db_file, scrubber->index, scrubber->res);
+
+                // Original intact dont le SHA n'a pas été calculé à l'insertion
+                if (retval == ERR_NONE && scrubber->res == RES_ORIG && sha_pending(metadata)) {
+                    retval = fill_sha(db_file, scrubber->index);
+
+                    if (retval == ERR_NONE)
+                        scrubber->hashed++;
+                }
+
+                if (retval != ERR_NONE) {
+                    scrubber->errors++;
+                    fprintf(stderr, "SCRUB: volume %" PRIu32 ", picture %s (resolution %" PRIu32 "): %s\n",
+                            scrubber->volume, metadata->pict_id, scrubber->res, ERROR_MESSAGES[retval]);
+                }
+
+                scrubber->credit -= metadata->size[scrubber->res];
+                scrubber->bytes += metadata->size[scrubber->res];
+                scrubber->images++;
+            }
+        }
+
+        if (scrub_advance(scrubber, set)) {
+            // Le crédit restant n'est pas reporté sur le parcours suivant
+            scrubber->credit = 0;
+            return 1;
+        }
+    }
+
+    return 0;
+}
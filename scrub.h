@@ -0,0 +1,64 @@
+/**
+ * @file scrub.h
+ * @brief Vérification en tâche de fond (scrubbing) des images stockées.
+ *
+ * Le scrubber parcourt, par petites étapes, toutes les images de toutes
+ * les résolutions d'un ensemble de volumes, les relit depuis le fichier et
+ * vérifie leur CRC, afin de détecter la corruption des données sur le
+ * disque avant qu'une image endommagée ne soit servie. Le débit est limité
+ * par un crédit d'octets, alimenté par l'appelant à chaque étape.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_SCRUB_H
+#define PICTDBPRJ_SCRUB_H
+
+#include <stdint.h> // pour uint32_t, uint64_t
+
+#include "volume.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Position et compteurs du scrubber
+struct scrubber {
+    // Prochaine image à vérifier
+    uint32_t volume;
+    uint32_t index;
+    uint32_t res;
+    // Octets pouvant encore être relus (négatif : dette)
+    int64_t credit;
+    // Compteurs cumulés
+    uint64_t images;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t passes;
+    // SHA en attente calculés (cf. fill_sha)
+    uint64_t hashed;
+};
+
+/**
+ * @brief Initialise le scrubber au début du premier volume
+ * @param scrubber Scrubber à initialiser
+ */
+void scrub_init(struct scrubber* scrubber);
+
+/**
+ * @brief Vérifie des images tant que le crédit le permet. Les images
+ * endommagées sont signalées sur stderr ; les SHA en attente des originaux
+ * intacts sont calculés et enregistrés.
+ * @param scrubber Scrubber
+ * @param set Ensemble de volumes à vérifier
+ * @param credit Octets ajoutés au crédit
+ * @param max_credit Crédit maximal accumulé (p.ex. une seconde de débit)
+ * @return 1 si l'étape a terminé un parcours complet des volumes, 0 sinon
+ */
+int scrub_step(struct scrubber* scrubber, const struct volume_set* set, uint64_t credit, uint64_t max_credit);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
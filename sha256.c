@@ -0,0 +1,102 @@
+/**
+ * @file sha256.c
+ * @brief SHA-256 d'un lot d'images, réparti entre plusieurs threads
+ *
+ * Chaque image est hachée par SHA256() d'OpenSSL, qui choisit déjà à
+ * l'exécution le code le plus rapide pour le processeur (instructions
+ * SHA-NI, AVX2, ...). Le gain d'un lot vient donc du hachage de plusieurs
+ * images à la fois, sur plusieurs cœurs.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour sysconf
+
+#include <pthread.h> // pour pthread_create
+#include <unistd.h> // pour sysconf
+
+#include "sha256.h"
+
+#define SHA256_MAX_THREADS 16
+#define SHA256_PARALLEL_MIN (4 * 1024 * 1024) // taille min d'un lot réparti entre threads
+
+// Tranche d'un lot hachée par un thread
+struct sha256_slice {
+    pthread_t thread;
+    const void* const* data;
+    const size_t* len;
+    unsigned char* digests;
+    size_t first;
+    size_t last;
+    // Indique si la tranche est hachée par un thread à attendre
+    int running;
+};
+
+/********************************************************************//**
+ * Hachage d'une tranche d'un lot
+ */
+static void* sha256_slice_run(void* arg)
+{
+    const struct sha256_slice *slice = arg;
+
+    for (size_t i = slice->first; i < slice->last; i++)
+        SHA256(slice->data[i], slice->len[i], &slice->digests[i * SHA256_DIGEST_LENGTH]);
+
+    return NULL;
+}
+
+/********************************************************************/
+void sha256_batch(const void* const* data, const size_t* len, size_t count, unsigned char* digests)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += len[i];
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t nb_threads = (cores > 0) ? (size_t)cores : 1;
+
+    if (nb_threads > SHA256_MAX_THREADS)
+        nb_threads = SHA256_MAX_THREADS;
+
+    if (nb_threads > count)
+        nb_threads = count;
+
+    // Petit lot : pas de threads
+    if (nb_threads <= 1 || total < SHA256_PARALLEL_MIN) {
+        for (size_t i = 0; i < count; i++)
+            SHA256(data[i], len[i], &digests[i * SHA256_DIGEST_LENGTH]);
+
+        return;
+    }
+
+    // Tranches contiguës d'environ le même nombre d'octets ; le thread
+    // appelant hache la dernière
+    struct sha256_slice slices[SHA256_MAX_THREADS];
+    size_t next = 0, done = 0;
+
+    for (size_t t = 0; t < nb_threads; t++) {
+        const size_t target = total / nb_threads * (t + 1);
+
+        slices[t].data = data;
+        slices[t].len = len;
+        slices[t].digests = digests;
+        slices[t].first = next;
+
+        while (next < count && (done < target || t + 1 == nb_threads))
+            done += len[next++];
+
+        slices[t].last = next;
+        slices[t].running = (t + 1 < nb_threads
+                             && pthread_create(&slices[t].thread, NULL, sha256_slice_run, &slices[t]) == 0);
+
+        // Dernière tranche, ou thread impossible à créer
+        if (!slices[t].running)
+            (void)sha256_slice_run(&slices[t]);
+    }
+
+    for (size_t t = 0; t < nb_threads; t++) {
+        if (slices[t].running)
+            pthread_join(slices[t].thread, NULL);
+    }
+}
@@ -0,0 +1,33 @@
+/**
+ * @file sha256.h
+ * @brief Calcul du SHA-256 d'un lot d'images (import en masse), réparti
+ * entre plusieurs threads dès que le lot est assez grand.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_SHA256_H
+#define PICTDBPRJ_SHA256_H
+
+#include <stddef.h> // pour size_t
+#include <openssl/sha.h> // pour SHA256_DIGEST_LENGTH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Calcule le SHA-256 de plusieurs buffers, en parallèle si le lot
+ * est assez grand
+ * @param data Données de chaque buffer
+ * @param len Taille de chaque buffer
+ * @param count Nombre de buffers
+ * @param digests Reçoit les hashs (count * SHA256_DIGEST_LENGTH octets)
+ */
+void sha256_batch(const void* const* data, const size_t* len, size_t count, unsigned char* digests);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
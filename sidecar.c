@@ -0,0 +1,374 @@
+/**
+ * @file sidecar.c
+ * @brief Fichier d'index compact projeté en mémoire
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour open, mmap
+
+#include <stdlib.h> // pour malloc, free
+#include <string.h> // pour strcpy, strcmp
+#include <stdio.h> // pour rename
+#include <fcntl.h> // pour open
+#include <unistd.h> // pour close
+#include <sys/mman.h> // pour mmap
+#include <sys/stat.h> // pour fstat
+
+#include "sidecar.h"
+
+#define SIDECAR_MIN_CAPACITY 64 // puissance de 2
+#define TMP_SUFFIX ".tmp"
+
+/********************************************************************//**
+ * Case de la table destinée à l'image index : la sienne si elle y est
+ * déjà, sinon la première case supprimée ou vide ; added indique si une
+ * case vide est prise
+ */
+static uint32_t entry_slot(const struct sidecar_entry* entries, uint32_t capacity, uint64_t hash,
+                           uint32_t index, int* added)
+{
+    const uint32_t mask = capacity - 1;
+    uint32_t i = (uint32_t)hash & mask;
+    uint32_t target = capacity;
+
+    for (; entries[i].index != SIDECAR_EMPTY; i = (i + 1) & mask) {
+        if (entries[i].index == index) {
+            target = i;
+            break;
+        }
+
+        if (entries[i].index == SIDECAR_DELETED && target == capacity)
+            target = i;
+    }
+
+    *added = (target == capacity);
+
+    return *added ? i : target;
+}
+
+/********************************************************************//**
+ * Place (ou met à jour) l'entrée de l'image index dans la table
+ */
+static void entry_place(struct sidecar_entry* entries, uint32_t capacity, uint32_t* filled,
+                        uint64_t hash, uint32_t index, const struct pict_metadata* metadata)
+{
+    int added = 0;
+    const uint32_t target = entry_slot(entries, capacity, hash, index, &added);
+
+    if (added)
+        (*filled)++;
+
+    struct sidecar_entry *entry = &entries[target];
+    entry->hash = hash;
+    entry->index = index;
+    for (uint32_t res = 0; res < NB_RES; res++) {
+        entry->size[res] = metadata->size[res];
+        entry->offset[res] = metadata->offset[res];
+    }
+}
+
+/********************************************************************//**
+ * Projette le fichier d'index ouvert (fd) en mémoire
+ */
+static int sidecar_map(struct sidecar* sidecar, int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct sidecar_header))
+        return ERR_IO;
+
+    void *map = mmap(NULL, (size_t)st.st_size, sidecar->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return ERR_IO;
+
+    sidecar->map = map;
+    sidecar->map_size = (size_t)st.st_size;
+    sidecar->header = (struct sidecar_header*)map;
+    sidecar->entries = (struct sidecar_entry*)((char*)map + sizeof(struct sidecar_header));
+
+    // Taille cohérente avec l'en-tête
+    const struct sidecar_header *header = sidecar->header;
+    if (strcmp(header->magic, SIDECAR_MAGIC) != 0 || header->format_version != SIDECAR_FORMAT_VERSION
+        || header->capacity == 0 || (header->capacity & (header->capacity - 1)) != 0
+        || sidecar->map_size != sizeof(struct sidecar_header) + header->capacity * sizeof(struct sidecar_entry))
+        return ERR_IO;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Libère la projection du fichier d'index
+ */
+static void sidecar_unmap(struct sidecar* sidecar)
+{
+    if (sidecar->map != NULL)
+        munmap(sidecar->map, sidecar->map_size);
+
+    sidecar->map = NULL;
+    sidecar->map_size = 0;
+    sidecar->header = NULL;
+    sidecar->entries = NULL;
+    sidecar->current = 0;
+}
+
+/********************************************************************//**
+ * Reconstruit le fichier d'index depuis les metadatas (dans un fichier
+ * temporaire renommé ensuite), puis le projette
+ */
+static int sidecar_rebuild(const struct pictdb_file* db_file, struct sidecar* sidecar)
+{
+    const struct pictdb_header *db_header = &db_file->header;
+
+    uint32_t capacity = SIDECAR_MIN_CAPACITY;
+    while (capacity < 2 * db_header->num_files)
+        capacity *= 2;
+
+    const size_t size = sizeof(struct sidecar_header) + capacity * sizeof(struct sidecar_entry);
+
+    char *buffer = calloc(1, size);
+    if (buffer == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    struct sidecar_header *header = (struct sidecar_header*)buffer;
+    struct sidecar_entry *entries = (struct sidecar_entry*)(buffer + sizeof(struct sidecar_header));
+
+    for (uint32_t i = 0; i < capacity; i++)
+        entries[i].index = SIDECAR_EMPTY;
+
+    uint32_t i = 0, num_files = 0;
+    while (i < db_header->max_files && num_files < db_header->num_files) {
+        const struct pict_metadata *metadata = &db_file->metadata[i];
+
+        if (metadata->is_valid == NON_EMPTY) {
+            entry_place(entries, capacity, &header->filled, pict_id_hash(metadata->pict_id), i, metadata);
+            num_files++;
+        }
+
+        i++;
+    }
+
+    strcpy(header->magic, SIDECAR_MAGIC);
+    header->format_version = SIDECAR_FORMAT_VERSION;
+    header->db_version = db_header->db_version;
+    header->max_files = db_header->max_files;
+    header->num_files = db_header->num_files;
+    header->capacity = capacity;
+
+    // Écriture dans un fichier temporaire, puis remplacement
+    int retval = ERR_NONE;
+    char *tmp_name = malloc(strlen(sidecar->filename) + sizeof(TMP_SUFFIX));
+    if (tmp_name == NULL) {
+        free(buffer);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    strcpy(tmp_name, sidecar->filename);
+    strcat(tmp_name, TMP_SUFFIX);
+
+    FILE *file = fopen(tmp_name, "wb");
+    if (file == NULL) {
+        retval = ERR_IO;
+    } else {
+        if (fwrite(buffer, size, 1, file) != 1)
+            retval = ERR_IO;
+
+        if (fclose(file) != 0)
+            retval = ERR_IO;
+    }
+
+    if (retval == ERR_NONE && rename(tmp_name, sidecar->filename) != 0)
+        retval = ERR_IO;
+
+    if (retval != ERR_NONE)
+        remove(tmp_name);
+
+    free(tmp_name);
+    free(buffer);
+
+    if (retval != ERR_NONE)
+        return retval;
+
+    // Projection du nouveau fichier
+    sidecar_unmap(sidecar);
+
+    int fd = open(sidecar->filename, O_RDWR);
+    if (fd == -1)
+        return ERR_IO;
+
+    retval = sidecar_map(sidecar, fd);
+    close(fd);
+
+    if (retval != ERR_NONE) {
+        sidecar_unmap(sidecar);
+        return retval;
+    }
+
+    sidecar->current = 1;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int sidecar_open(struct pictdb_file* db_file, const char* db_filename, int writable)
+{
+    if (db_file == NULL || db_filename == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    struct sidecar *sidecar = calloc(1, sizeof(struct sidecar));
+    if (sidecar == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    sidecar->writable = writable;
+    sidecar->filename = malloc(strlen(db_filename) + sizeof(SIDECAR_SUFFIX));
+    if (sidecar->filename == NULL) {
+        free(sidecar);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    strcpy(sidecar->filename, db_filename);
+    strcat(sidecar->filename, SIDECAR_SUFFIX);
+
+    // Fichier existant : utilisable s'il correspond à la base
+    int retval = ERR_IO;
+    int fd = open(sidecar->filename, writable ? O_RDWR : O_RDONLY);
+    if (fd != -1) {
+        retval = sidecar_map(sidecar, fd);
+        close(fd);
+    }
+
+    if (retval == ERR_NONE) {
+        const struct sidecar_header *header = sidecar->header;
+
+        sidecar->current = header->db_version == db_file->header.db_version
+                           && header->max_files == db_file->header.max_files
+                           && header->num_files == db_file->header.num_files;
+    }
+
+    // Absent ou obsolète : reconstruit si possible
+    if (!sidecar->current) {
+        sidecar_unmap(sidecar);
+
+        retval = writable ? metadata_load_all(db_file) : ERR_IO;
+        if (retval == ERR_NONE)
+            retval = sidecar_rebuild(db_file, sidecar);
+        if (retval != ERR_NONE) {
+            sidecar_close(sidecar);
+            return retval;
+        }
+    }
+
+    db_file->sidecar = sidecar;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+void sidecar_close(struct sidecar* sidecar)
+{
+    if (sidecar == NULL)
+        return;
+
+    sidecar_unmap(sidecar);
+    free(sidecar->filename);
+    free(sidecar);
+}
+
+/********************************************************************/
+int sidecar_is_current(const struct pictdb_file* db_file)
+{
+    const struct sidecar *sidecar = db_file->sidecar;
+
+    return sidecar != NULL && sidecar->current && sidecar->header->db_version == db_file->header.db_version;
+}
+
+/********************************************************************/
+int sidecar_find(struct pictdb_file* db_file, const char* pict_id, uint32_t* index)
+{
+    const struct sidecar *sidecar = db_file->sidecar;
+    const uint64_t hash = pict_id_hash(pict_id);
+    const uint32_t mask = sidecar->header->capacity - 1;
+
+    for (uint32_t i = (uint32_t)hash & mask; sidecar->entries[i].index != SIDECAR_EMPTY; i = (i + 1) & mask) {
+        const struct sidecar_entry *entry = &sidecar->entries[i];
+
+        // Même hash : on vérifie l'identifiant dans les metadatas
+        if (entry->hash == hash && entry->index < db_file->header.max_files
+            && metadata_load(db_file, entry->index) == ERR_NONE
+            && db_file->metadata[entry->index].is_valid == NON_EMPTY
+            && !strcmp(db_file->metadata[entry->index].pict_id, pict_id)) {
+            *index = entry->index;
+            return ERR_NONE;
+        }
+    }
+
+    return ERR_FILE_NOT_FOUND;
+}
+
+/********************************************************************/
+void sidecar_sync(const struct pictdb_file* db_file, uint32_t index)
+{
+    struct sidecar *sidecar = db_file->sidecar;
+
+    if (sidecar == NULL || !sidecar->writable || !sidecar->current)
+        return;
+
+    struct sidecar_header *header = sidecar->header;
+    const struct pict_metadata *metadata = &db_file->metadata[index];
+
+    // Une modification précédente n'a pas été reportée : fichier obsolète
+    if (header->db_version != db_file->header.db_version
+        && header->db_version + 1 != db_file->header.db_version) {
+        sidecar->current = 0;
+        return;
+    }
+
+    if (metadata->is_valid == NON_EMPTY) {
+        const uint64_t hash = pict_id_hash(metadata->pict_id);
+        int added = 0;
+        (void)entry_slot(sidecar->entries, header->capacity, hash, index, &added);
+
+        // Nouvelle entrée dans une table remplie aux 3/4 : reconstruite, deux
+        // fois plus grande. Une base ouverte à la demande n'a pas toutes ses
+        // metadatas en mémoire : le fichier devient obsolète, et sera
+        // reconstruit à la prochaine ouverture complète
+        if (added && (header->filled + 1) * 4 > header->capacity * 3) {
+            if (db_file->loaded != NULL)
+                sidecar->current = 0;
+            else if (sidecar_rebuild(db_file, sidecar) != ERR_NONE)
+                sidecar_unmap(sidecar);
+            return;
+        }
+
+        entry_place(sidecar->entries, header->capacity, &header->filled, hash, index, metadata);
+    }
+
+    header->db_version = db_file->header.db_version;
+    header->max_files = db_file->header.max_files;
+    header->num_files = db_file->header.num_files;
+}
+
+/********************************************************************/
+void sidecar_remove(struct pictdb_file* db_file, uint32_t index)
+{
+    struct sidecar *sidecar = db_file->sidecar;
+
+    if (sidecar == NULL || !sidecar->writable || !sidecar->current)
+        return;
+
+    const uint32_t mask = sidecar->header->capacity - 1;
+    const uint64_t hash = pict_id_hash(db_file->metadata[index].pict_id);
+
+    for (uint32_t i = (uint32_t)hash & mask; sidecar->entries[i].index != SIDECAR_EMPTY; i = (i + 1) & mask) {
+        if (sidecar->entries[i].index == index) {
+            sidecar->entries[i].index = SIDECAR_DELETED;
+            break;
+        }
+    }
+
+    // Version déjà incrémentée : si la base n'est finalement pas écrite,
+    // le fichier d'index sera considéré comme obsolète
+    sidecar->header->db_version = db_file->header.db_version;
+    sidecar->header->num_files = db_file->header.num_files;
+}
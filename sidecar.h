@@ -0,0 +1,128 @@
+/**
+ * @file sidecar.h
+ * @brief Fichier d'index compact (<db>.idx) écrit à côté de la base.
+ *
+ * Le fichier d'index est une table de hachage à adressage ouvert, projetée
+ * en mémoire (mmap), qui associe le hash de chaque pict_id à sa position
+ * dans les metadatas, avec les positions et tailles de ses résolutions.
+ * Il est valable pour une version de la base (header.db_version) : s'il
+ * correspond à la base ouverte, les recherches par identifiant n'ont
+ * besoin ni de parcourir les metadatas ni de construire l'index trié.
+ * Sinon il est reconstruit à l'ouverture. Chaque modification écrite par
+ * do_write_entry est ensuite reportée dans le fichier d'index.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_SIDECAR_H
+#define PICTDBPRJ_SIDECAR_H
+
+#include <stddef.h> // pour size_t
+#include <stdint.h> // pour uint32_t, uint64_t
+
+#include "pictDB.h"
+
+#define SIDECAR_SUFFIX ".idx"
+#define SIDECAR_MAGIC "PICTIDX" // 7 caractères + '\0'
+#define SIDECAR_FORMAT_VERSION 1
+#define SIDECAR_EMPTY UINT32_MAX // entrée jamais utilisée
+#define SIDECAR_DELETED (UINT32_MAX - 1) // entrée d'une image supprimée
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// En-tête du fichier d'index
+struct sidecar_header {
+    char magic[8];
+    uint32_t format_version;
+    // Version, taille et nombre d'images de la base indexée
+    uint32_t db_version;
+    uint32_t max_files;
+    uint32_t num_files;
+    // Nombre d'entrées de la table (puissance de 2)
+    uint32_t capacity;
+    // Entrées utilisées ou supprimées
+    uint32_t filled;
+};
+
+// Entrée du fichier d'index (48 octets)
+struct sidecar_entry {
+    // Hash de l'identifiant (cf. pict_id_hash)
+    uint64_t hash;
+    // Position de l'image dans les metadatas (ou SIDECAR_EMPTY, SIDECAR_DELETED)
+    uint32_t index;
+    // Tailles et positions des résolutions (copie des metadatas)
+    uint32_t size[NB_RES];
+    uint64_t offset[NB_RES];
+};
+
+// Fichier d'index ouvert
+struct sidecar {
+    // Nom du fichier d'index
+    char* filename;
+    // Projection du fichier
+    void* map;
+    size_t map_size;
+    struct sidecar_header* header;
+    struct sidecar_entry* entries;
+    // Le fichier peut être modifié (base ouverte en écriture)
+    int writable;
+    // Le fichier correspond aux metadatas en mémoire
+    int current;
+};
+
+/**
+ * @brief Ouvre (et projette) le fichier d'index de la base db_filename.
+ * S'il est absent ou obsolète, il est reconstruit depuis les metadatas si
+ * la base est ouverte en écriture ; sinon il n'est pas utilisé.
+ * @param db_file Base ouverte (db_file->sidecar reçoit le fichier ouvert)
+ * @param db_filename Nom du fichier de la base
+ * @param writable Indique si la base est ouverte en écriture
+ * @return Code d'erreur approprié
+ */
+int sidecar_open(struct pictdb_file* db_file, const char* db_filename, int writable);
+
+/**
+ * @brief Ferme le fichier d'index
+ * @param sidecar Fichier d'index (peut être NULL)
+ */
+void sidecar_close(struct sidecar* sidecar);
+
+/**
+ * @brief Indique si le fichier d'index de la base est ouvert et correspond
+ * à la version de la base en mémoire
+ * @param db_file Base ouverte
+ */
+int sidecar_is_current(const struct pictdb_file* db_file);
+
+/**
+ * @brief Recherche une image dans le fichier d'index (à jour)
+ * @param db_file Base ouverte
+ * @param pict_id Identifiant recherché
+ * @param index Reçoit la position de l'image dans les metadatas
+ * @return ERR_NONE ou ERR_FILE_NOT_FOUND
+ */
+int sidecar_find(struct pictdb_file* db_file, const char* pict_id, uint32_t* index);
+
+/**
+ * @brief Reporte dans le fichier d'index la metadata index (ajoutée ou
+ * modifiée) et la version de la base. Appelée par do_write_entry.
+ * @param db_file Base ouverte
+ * @param index Position de la metadata écrite
+ */
+void sidecar_sync(const struct pictdb_file* db_file, uint32_t index);
+
+/**
+ * @brief Retire une image du fichier d'index. Doit être appelée après la
+ * mise à jour du header et avant l'effacement de la metadata.
+ * @param db_file Base ouverte
+ * @param index Position de l'image supprimée
+ */
+void sidecar_remove(struct pictdb_file* db_file, uint32_t index);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,236 @@
+/**
+ * @file stats.c
+ * @brief Compteurs et histogrammes de latence des opérations de la base.
+ *
+ * Une durée v est rangée dans la case de sa puissance de deux, subdivisée
+ * en STAT_SUB_BUCKETS cases linéaires ; les durées plus petites que
+ * STAT_SUB_BUCKETS ont chacune leur case. Les durées trop grandes pour
+ * l'histogramme sont rangées dans la dernière case.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour clock_gettime
+
+#include <stdlib.h> // pour malloc
+#include <inttypes.h> // pour PRIu64
+#include <time.h> // pour clock_gettime
+
+#include "stats.h"
+#include "error.h"
+
+#define STAT_SUB_BITS 4
+#define STAT_SUB_BUCKETS (1 << STAT_SUB_BITS) // cases par puissance de deux
+#define STAT_MAX_BITS 40 // durée max distinguée : 2^40 ns (18 minutes)
+#define STAT_BUCKETS ((STAT_MAX_BITS - STAT_SUB_BITS + 2) * STAT_SUB_BUCKETS)
+#define STAT_JSON_ENTRY 256 // taille max d'une opération dans le JSON
+
+const char* const STAT_NAMES[NB_STATS] = {
+    "open",
+    "read",
+    "read.lookup",
+    "read.resize",
+    "read.fetch",
+    "insert",
+    "insert.hash",
+    "insert.dedup",
+    "insert.probe",
+    "insert.store",
+    "insert.write",
+    "delete",
+    "write",
+    "gbcollect",
+    "http.list",
+    "http.read",
+    "http.insert",
+    "http.delete",
+    "http.stats",
+    "http.metrics",
+    "http.trace"
+};
+
+// Compteurs d'une opération, modifiés uniquement par des opérations atomiques
+struct stat_counters {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[STAT_BUCKETS];
+};
+
+static struct stat_counters counters[NB_STATS];
+static uint64_t totals[NB_STAT_COUNTERS];
+static int64_t gauges[NB_STAT_GAUGES];
+
+/********************************************************************//**
+ * Case de l'histogramme d'une durée
+ */
+static uint32_t bucket_of(uint64_t value)
+{
+    if (value < STAT_SUB_BUCKETS)
+        return (uint32_t)value;
+
+    uint32_t exponent = 63 - (uint32_t)__builtin_clzll(value);
+    if (exponent > STAT_MAX_BITS)
+        return STAT_BUCKETS - 1;
+
+    const uint32_t sub = (uint32_t)(value >> (exponent - STAT_SUB_BITS)) & (STAT_SUB_BUCKETS - 1);
+
+    return (exponent - STAT_SUB_BITS + 1) * STAT_SUB_BUCKETS + sub;
+}
+
+/********************************************************************//**
+ * Plus grande durée rangée dans une case
+ */
+static uint64_t bucket_max(uint32_t bucket)
+{
+    if (bucket < STAT_SUB_BUCKETS)
+        return bucket;
+
+    const uint32_t exponent = bucket / STAT_SUB_BUCKETS + STAT_SUB_BITS - 1;
+    const uint64_t low = (uint64_t)(STAT_SUB_BUCKETS + bucket % STAT_SUB_BUCKETS) << (exponent - STAT_SUB_BITS);
+
+    return low + (UINT64_C(1) << (exponent - STAT_SUB_BITS)) - 1;
+}
+
+/********************************************************************/
+uint64_t stats_now (void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+}
+
+/********************************************************************/
+void stats_record (enum stat_op op, uint64_t start, int error)
+{
+    if (op >= NB_STATS)
+        return;
+
+    struct stat_counters *stat = &counters[op];
+    const uint64_t now = stats_now();
+    const uint64_t elapsed = (now > start) ? now - start : 0;
+
+    __atomic_fetch_add(&stat->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat->total, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat->buckets[bucket_of(elapsed)], 1, __ATOMIC_RELAXED);
+
+    if (error != ERR_NONE)
+        __atomic_fetch_add(&stat->errors, 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&stat->max, __ATOMIC_RELAXED);
+    while (elapsed > max
+           && !__atomic_compare_exchange_n(&stat->max, &max, elapsed, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/********************************************************************/
+void stats_add (enum stat_counter counter, uint64_t value)
+{
+    if (counter < NB_STAT_COUNTERS)
+        __atomic_fetch_add(&totals[counter], value, __ATOMIC_RELAXED);
+}
+
+/********************************************************************/
+uint64_t stats_counter (enum stat_counter counter)
+{
+    return (counter < NB_STAT_COUNTERS) ? __atomic_load_n(&totals[counter], __ATOMIC_RELAXED) : 0;
+}
+
+/********************************************************************/
+void stats_gauge_add (enum stat_gauge gauge, int64_t delta)
+{
+    if (gauge < NB_STAT_GAUGES)
+        __atomic_fetch_add(&gauges[gauge], delta, __ATOMIC_RELAXED);
+}
+
+/********************************************************************/
+int64_t stats_gauge (enum stat_gauge gauge)
+{
+    return (gauge < NB_STAT_GAUGES) ? __atomic_load_n(&gauges[gauge], __ATOMIC_RELAXED) : 0;
+}
+
+/********************************************************************/
+void stats_summary (enum stat_op op, struct stat_summary* summary)
+{
+    const struct stat_counters *stat = &counters[op];
+    uint64_t buckets[STAT_BUCKETS];
+    uint64_t count = 0;
+
+    // Copie de l'histogramme : les rangs sont calculés sur un état cohérent
+    for (uint32_t i = 0; i < STAT_BUCKETS; i++) {
+        buckets[i] = __atomic_load_n(&stat->buckets[i], __ATOMIC_RELAXED);
+        count += buckets[i];
+    }
+
+    summary->count = count;
+    summary->errors = __atomic_load_n(&stat->errors, __ATOMIC_RELAXED);
+    summary->total = __atomic_load_n(&stat->total, __ATOMIC_RELAXED);
+    summary->max = __atomic_load_n(&stat->max, __ATOMIC_RELAXED);
+
+    // Rangs des centiles (arrondis au supérieur), en millièmes
+    const uint64_t permille[] = { 500, 900, 990, 999 };
+    uint64_t *results[] = { &summary->p50, &summary->p90, &summary->p99, &summary->p999 };
+    uint64_t seen = 0;
+    uint32_t bucket = 0;
+
+    for (size_t p = 0; p < sizeof(permille) / sizeof(permille[0]); p++) {
+        const uint64_t rank = (count * permille[p] + 999) / 1000;
+
+        while (bucket < STAT_BUCKETS && seen + buckets[bucket] < rank)
+            seen += buckets[bucket++];
+
+        uint64_t value = (count == 0) ? 0 : bucket_max(bucket);
+        *results[p] = (value < summary->max) ? value : summary->max;
+    }
+}
+
+/********************************************************************/
+void stats_print (FILE* out)
+{
+    fprintf(out, "%-14s %10s %8s %10s %10s %10s %10s %10s\n",
+            "OPERATION", "COUNT", "ERRORS", "MEAN(us)", "P50(us)", "P99(us)", "P99.9(us)", "MAX(us)");
+
+    for (int op = 0; op < NB_STATS; op++) {
+        struct stat_summary summary;
+        stats_summary((enum stat_op)op, &summary);
+
+        if (summary.count == 0)
+            continue;
+
+        fprintf(out, "%-14s %10" PRIu64 " %8" PRIu64 " %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                STAT_NAMES[op], summary.count, summary.errors,
+                (double)summary.total / (double)summary.count / 1000.0,
+                (double)summary.p50 / 1000.0, (double)summary.p99 / 1000.0,
+                (double)summary.p999 / 1000.0, (double)summary.max / 1000.0);
+    }
+}
+
+/********************************************************************/
+char* stats_json (void)
+{
+    const size_t capacity = NB_STATS * STAT_JSON_ENTRY + 8;
+    char *json = malloc(capacity);
+    if (json == NULL)
+        return NULL;
+
+    size_t length = (size_t)snprintf(json, capacity, "{");
+
+    for (int op = 0; op < NB_STATS; op++) {
+        struct stat_summary summary;
+        stats_summary((enum stat_op)op, &summary);
+
+        length += (size_t)snprintf(&json[length], capacity - length,
+                                   "%s \"%s\": { \"count\": %" PRIu64 ", \"errors\": %" PRIu64
+                                   ", \"total_ns\": %" PRIu64 ", \"p50_ns\": %" PRIu64 ", \"p90_ns\": %" PRIu64
+                                   ", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 " }",
+                                   (op == 0) ? "" : ",", STAT_NAMES[op], summary.count, summary.errors,
+                                   summary.total, summary.p50, summary.p90, summary.p99, summary.p999, summary.max);
+    }
+
+    snprintf(&json[length], capacity - length, " }");
+
+    return json;
+}
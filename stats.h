@@ -0,0 +1,142 @@
+/**
+ * @file stats.h
+ * @brief Compteurs et histogrammes de latence des opérations de la base.
+ *
+ * Chaque opération (et chaque étape de la lecture et de l'insertion) a un
+ * compteur d'appels, un compteur d'erreurs et un histogramme de ses durées.
+ * L'histogramme a la forme de ceux de HdrHistogram : 16 cases par
+ * puissance de deux, soit une précision de 6 % de la nanoseconde à une
+ * vingtaine de minutes, pour une taille fixe. Un enregistrement coûte une
+ * lecture de l'horloge et quelques additions atomiques, sans verrou : les
+ * compteurs restent actifs en production et peuvent être lus à tout moment
+ * par un autre thread.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_STATS_H
+#define PICTDBPRJ_STATS_H
+
+#include <stdio.h> // pour FILE
+#include <stdint.h> // pour uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Opérations mesurées ; les étapes suivent l'opération qui les contient
+enum stat_op {
+    STAT_OPEN,
+    STAT_READ,
+    STAT_READ_LOOKUP,
+    STAT_READ_RESIZE,
+    STAT_READ_FETCH,
+    STAT_INSERT,
+    STAT_INSERT_HASH,
+    STAT_INSERT_DEDUP,
+    STAT_INSERT_PROBE,
+    STAT_INSERT_STORE,
+    STAT_INSERT_WRITE,
+    STAT_DELETE,
+    STAT_WRITE,
+    STAT_GBCOLLECT,
+    // Requêtes HTTP du serveur, par handler
+    STAT_HTTP_LIST,
+    STAT_HTTP_READ,
+    STAT_HTTP_INSERT,
+    STAT_HTTP_DELETE,
+    STAT_HTTP_STATS,
+    STAT_HTTP_METRICS,
+    STAT_HTTP_TRACE,
+    NB_STATS
+};
+
+#define STAT_HTTP_FIRST STAT_HTTP_LIST
+
+// Compteurs cumulés (octets)
+enum stat_counter {
+    STAT_BYTES_READ, // lus depuis les fichiers par fetch_image et verify_image
+    STAT_BYTES_WRITTEN, // images écrites par store_image et les insertions en flux
+    NB_STAT_COUNTERS
+};
+
+// Valeurs instantanées
+enum stat_gauge {
+    STAT_RESIZE_PENDING, // redimensionnements en cours (cf. do_read_prepare)
+    NB_STAT_GAUGES
+};
+
+// Noms des opérations (p.ex. "read.lookup"), indexés par enum stat_op
+extern const char* const STAT_NAMES[NB_STATS];
+
+// Résumé d'une opération ; les durées sont en nanosecondes
+struct stat_summary {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t total;
+    uint64_t max;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+};
+
+/**
+ * @brief Instant courant (horloge monotone), à passer à stats_record
+ * @return L'instant en nanosecondes
+ */
+uint64_t stats_now(void);
+
+/**
+ * @brief Enregistre une exécution de l'opération, commencée à start
+ * @param op L'opération
+ * @param start Instant de début (cf. stats_now)
+ * @param error Code d'erreur de l'exécution (ERR_NONE si réussie)
+ */
+void stats_record(enum stat_op op, uint64_t start, int error);
+
+/**
+ * @brief Ajoute value à un compteur
+ */
+void stats_add(enum stat_counter counter, uint64_t value);
+
+/**
+ * @brief Valeur d'un compteur
+ */
+uint64_t stats_counter(enum stat_counter counter);
+
+/**
+ * @brief Ajoute delta (positif ou négatif) à une valeur instantanée
+ */
+void stats_gauge_add(enum stat_gauge gauge, int64_t delta);
+
+/**
+ * @brief Valeur instantanée
+ */
+int64_t stats_gauge(enum stat_gauge gauge);
+
+/**
+ * @brief Résume les exécutions d'une opération
+ * @param op L'opération
+ * @param summary Résumé rempli
+ */
+void stats_summary(enum stat_op op, struct stat_summary* summary);
+
+/**
+ * @brief Affiche le résumé des opérations exécutées au moins une fois
+ * @param out Flux de sortie
+ */
+void stats_print(FILE* out);
+
+/**
+ * @brief Résumé de toutes les opérations au format JSON
+ * @return Le document (à libérer par l'appelant), ou NULL si la mémoire manque
+ */
+char* stats_json(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,246 @@
+/**
+ * @file trace.c
+ * @brief Traces des étapes d'une requête, dans un tampon circulaire sans
+ *        verrou.
+ *
+ * Un thread réserve une entrée du tampon en incrémentant atomiquement le
+ * numéro de la prochaine étape, puis la remplit. Le numéro de l'étape
+ * (plus un) n'est écrit dans l'entrée qu'une fois celle-ci remplie, et
+ * remis à zéro avant : l'export ignore les entrées en cours d'écriture ou
+ * réécrites pendant qu'il les copie.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#include <stdio.h> // pour vsnprintf, FILE
+#include <stdlib.h> // pour calloc, malloc
+#include <stdarg.h> // pour va_list
+#include <string.h> // pour memcpy
+#include <inttypes.h> // pour PRIu32
+#include <pthread.h> // pour pthread_once, pthread_key_t
+
+#include "trace.h"
+#include "stats.h"
+#include "error.h"
+
+#define TRACE_JSON_EVENT (256 + 2 * TRACE_DETAIL_SIZE) // taille max d'une étape dans le JSON
+#define TRACE_JSON_PREFIX "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": ["
+#define TRACE_JSON_SUFFIX "\n] }\n"
+
+// Une étape enregistrée
+struct trace_event {
+    // Numéro de l'étape plus un, 0 pendant son écriture
+    uint64_t seq;
+    uint64_t start;
+    uint64_t duration;
+    const char* name;
+    uint32_t tid;
+    char detail[TRACE_DETAIL_SIZE];
+};
+
+static struct trace_event* ring = NULL;
+static uint64_t ring_mask = 0;
+// Numéro de la prochaine étape
+static uint64_t head = 0;
+// Instant d'activation, origine des temps de l'export
+static uint64_t origin = 0;
+static int enabled = 0;
+
+// Numéro (à partir de 1) de chaque thread, dans l'ordre de leur première étape
+static pthread_once_t tid_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tid_key;
+static int tid_key_ok = 0;
+static uint32_t next_tid = 0;
+
+/********************************************************************//**
+ * Création de la clé des numéros de thread
+ */
+static void tid_key_init(void)
+{
+    tid_key_ok = (pthread_key_create(&tid_key, NULL) == 0);
+}
+
+/********************************************************************//**
+ * Numéro du thread appelant
+ */
+static uint32_t thread_id(void)
+{
+    pthread_once(&tid_once, tid_key_init);
+    if (!tid_key_ok)
+        return 0;
+
+    uint32_t tid = (uint32_t)(uintptr_t)pthread_getspecific(tid_key);
+    if (tid == 0) {
+        tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+        pthread_setspecific(tid_key, (void*)(uintptr_t)tid);
+    }
+
+    return tid;
+}
+
+/********************************************************************/
+int trace_enable (size_t events)
+{
+    if (trace_enabled())
+        return ERR_NONE;
+
+    size_t capacity = 2;
+    while (capacity < events)
+        capacity *= 2;
+
+    ring = calloc(capacity, sizeof(struct trace_event));
+    if (ring == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    ring_mask = capacity - 1;
+    head = 0;
+    origin = stats_now();
+
+    // Le tampon est prêt avant que les threads ne voient les traces actives
+    __atomic_store_n(&enabled, 1, __ATOMIC_RELEASE);
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int trace_enabled (void)
+{
+    return __atomic_load_n(&enabled, __ATOMIC_ACQUIRE);
+}
+
+/********************************************************************/
+uint64_t trace_begin (void)
+{
+    return trace_enabled() ? stats_now() : 0;
+}
+
+/********************************************************************/
+void trace_end (const char* name, uint64_t start, const char* format, ...)
+{
+    if (start == 0 || !trace_enabled())
+        return;
+
+    const uint64_t now = stats_now();
+    const uint64_t number = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    struct trace_event *event = &ring[number & ring_mask];
+
+    // Entrée marquée en cours d'écriture avant d'être modifiée
+    __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    event->start = start;
+    event->duration = (now > start) ? now - start : 0;
+    event->name = name;
+    event->tid = thread_id();
+    event->detail[0] = '\0';
+
+    if (format != NULL) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(event->detail, TRACE_DETAIL_SIZE, format, args);
+        va_end(args);
+    }
+
+    __atomic_store_n(&event->seq, number + 1, __ATOMIC_RELEASE);
+}
+
+/********************************************************************//**
+ * Copie une chaîne dans le JSON, avec les échappements nécessaires
+ */
+static size_t json_escape(char* out, const char* text)
+{
+    size_t length = 0;
+
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            out[length++] = '\\';
+
+        out[length++] = ((unsigned char)*c < 0x20) ? ' ' : *c;
+    }
+
+    return length;
+}
+
+/********************************************************************/
+char* trace_json (size_t* length)
+{
+    if (!trace_enabled())
+        return NULL;
+
+    const uint64_t last = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    const uint64_t first = (last > ring_mask + 1) ? last - (ring_mask + 1) : 0;
+    const size_t capacity = (size_t)(last - first) * TRACE_JSON_EVENT + sizeof(TRACE_JSON_PREFIX TRACE_JSON_SUFFIX);
+
+    char *json = malloc(capacity);
+    if (json == NULL)
+        return NULL;
+
+    size_t written = (size_t)snprintf(json, capacity, "%s", TRACE_JSON_PREFIX);
+    int empty = 1;
+
+    for (uint64_t number = first; number < last; number++) {
+        const struct trace_event *slot = &ring[number & ring_mask];
+        struct trace_event event;
+
+        // Entrée copiée seulement si elle n'est ni en cours d'écriture, ni
+        // réécrite pendant la copie
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != number + 1)
+            continue;
+
+        memcpy(&event, slot, sizeof(struct trace_event));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != number + 1)
+            continue;
+
+        event.detail[TRACE_DETAIL_SIZE - 1] = '\0';
+
+        // Temps en microsecondes depuis l'activation
+        written += (size_t)snprintf(&json[written], capacity - written,
+                                    "%s\n  { \"name\": \"%s\", \"cat\": \"pictdb\", \"ph\": \"X\", \"pid\": 1, "
+                                    "\"tid\": %" PRIu32 ", \"ts\": %.3f, \"dur\": %.3f, \"args\": { \"detail\": \"",
+                                    empty ? "" : ",", event.name, event.tid,
+                                    (double)(int64_t)(event.start - origin) / 1000.0, (double)event.duration / 1000.0);
+        written += json_escape(&json[written], event.detail);
+        written += (size_t)snprintf(&json[written], capacity - written, "\" } }");
+        empty = 0;
+    }
+
+    written += (size_t)snprintf(&json[written], capacity - written, "%s", TRACE_JSON_SUFFIX);
+    *length = written;
+
+    return json;
+}
+
+/********************************************************************/
+int trace_dump (const char* filename)
+{
+    size_t length = 0;
+    char *json = trace_json(&length);
+    if (json == NULL)
+        return trace_enabled() ? ERR_OUT_OF_MEMORY : ERR_INVALID_ARGUMENT;
+
+    int retval = ERR_NONE;
+    FILE *file = fopen(filename, "w");
+
+    if (file == NULL || fwrite(json, length, 1, file) != 1)
+        retval = ERR_IO;
+
+    if (file != NULL && fclose(file) != 0)
+        retval = ERR_IO;
+
+    free(json);
+
+    return retval;
+}
+
+/********************************************************************/
+void trace_free (void)
+{
+    __atomic_store_n(&enabled, 0, __ATOMIC_RELEASE);
+
+    free(ring);
+    ring = NULL;
+    ring_mask = 0;
+}
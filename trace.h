@@ -0,0 +1,89 @@
+/**
+ * @file trace.h
+ * @brief Traces des étapes d'une requête (spans), exportées au format
+ *        Chrome trace-event (chrome://tracing, Perfetto).
+ *
+ * Les compteurs de stats.h disent combien de lectures sont lentes ; les
+ * traces disent pourquoi une lecture donnée l'a été : chaque étape
+ * (handler du serveur, recherche de l'identifiant, fetch_image, chargement,
+ * redimensionnement et export par VIPS, store_image, do_write) enregistre
+ * son début, sa durée et son thread. Les étapes d'une même requête
+ * s'emboîtent dans le temps sur leur thread.
+ *
+ * Les traces sont désactivées par défaut : une étape ne coûte alors que la
+ * lecture d'un indicateur. Activées, elles sont rangées sans verrou dans un
+ * tampon circulaire de taille fixe, où les plus récentes remplacent les
+ * plus anciennes.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_TRACE_H
+#define PICTDBPRJ_TRACE_H
+
+#include <stddef.h> // pour size_t
+#include <stdint.h> // pour uint64_t
+
+#define TRACE_DEFAULT_EVENTS 65536 // étapes gardées par défaut
+#define TRACE_DETAIL_SIZE 48 // taille max du détail d'une étape (identifiant, requête...)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Active les traces
+ * @param events Nombre d'étapes gardées (arrondi à la puissance de deux
+ *        supérieure) ; sans effet si les traces sont déjà actives
+ * @return Code d'erreur approprié
+ */
+int trace_enable(size_t events);
+
+/**
+ * @brief Indique si les traces sont actives
+ */
+int trace_enabled(void);
+
+/**
+ * @brief Instant de début d'une étape
+ * @return L'instant (cf. stats_now), ou 0 si les traces sont désactivées
+ */
+uint64_t trace_begin(void);
+
+/**
+ * @brief Enregistre une étape commencée à start et finie maintenant ;
+ * sans effet si les traces sont désactivées ou si start est nul
+ * @param name Nom de l'étape (chaîne constante, non copiée)
+ * @param start Instant de début (cf. trace_begin ou stats_now)
+ * @param format Détail de l'étape, au format printf (NULL si aucun) ;
+ *        n'est formaté que si l'étape est enregistrée
+ */
+void trace_end(const char* name, uint64_t start, const char* format, ...);
+
+/**
+ * @brief Étapes gardées au format Chrome trace-event (JSON)
+ * @param length Longueur du document
+ * @return Le document (à libérer par l'appelant), ou NULL si la mémoire
+ *         manque ou si les traces sont désactivées
+ */
+char* trace_json(size_t* length);
+
+/**
+ * @brief Écrit les étapes gardées dans un fichier (cf. trace_json)
+ * @param filename Nom du fichier
+ * @return Code d'erreur approprié
+ */
+int trace_dump(const char* filename);
+
+/**
+ * @brief Désactive les traces et libère le tampon ; les threads ne doivent
+ * plus enregistrer d'étapes
+ */
+void trace_free(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
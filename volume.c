@@ -0,0 +1,644 @@
+/**
+ * @file volume.c
+ * @brief Ensemble de volumes pictDB : création des volumes, index
+ *        pict_id -> volume et routage des commandes.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // pour mkdir, stat, strdup
+
+#include <stdlib.h> // pour calloc, realloc
+#include <string.h> // pour strchr, strcmp, strdup
+#include <stdio.h> // pour snprintf
+#include <sys/stat.h> // pour mkdir, stat
+
+#include "volume.h"
+#include "image_cache.h"
+#include "sidecar.h"
+
+#define ROUTE_EMPTY 0
+#define ROUTE_USED 1
+#define ROUTE_DELETED 2
+#define ROUTE_MIN_CAPACITY 64 // puissance de 2
+#define TMP_SUFFIX ".tmp"
+
+/********************************************************************//**
+ * Recherche de l'entrée de l'index correspondant à pict_id. Le hash ne
+ * suffit pas : l'image est recherchée dans le volume indiqué par l'entrée.
+ */
+static int route_lookup(const struct volume_set* set, const char* pict_id, uint32_t* slot)
+{
+    if (set->routes == NULL)
+        return ERR_FILE_NOT_FOUND;
+
+    const uint64_t hash = pict_id_hash(pict_id);
+    const uint32_t mask = set->route_capacity - 1;
+
+    for (uint32_t i = (uint32_t)hash & mask; set->routes[i].state != ROUTE_EMPTY; i = (i + 1) & mask) {
+        const struct volume_route *route = &set->routes[i];
+        uint32_t index = 0;
+
+        if (route->state == ROUTE_USED && route->hash == hash
+            && find_pict_id(set->volumes[route->volume], pict_id, &index) == ERR_NONE) {
+            *slot = i;
+            return ERR_NONE;
+        }
+    }
+
+    return ERR_FILE_NOT_FOUND;
+}
+
+/********************************************************************//**
+ * Place une entrée dans la première case libre de la table
+ */
+static void route_place(struct volume_route* routes, uint32_t capacity, uint64_t hash, uint32_t volume, uint32_t* filled)
+{
+    const uint32_t mask = capacity - 1;
+    uint32_t i = (uint32_t)hash & mask;
+
+    while (routes[i].state == ROUTE_USED)
+        i = (i + 1) & mask;
+
+    if (routes[i].state == ROUTE_EMPTY)
+        (*filled)++;
+
+    routes[i].hash = hash;
+    routes[i].volume = volume;
+    routes[i].state = ROUTE_USED;
+}
+
+/********************************************************************//**
+ * Reconstruit la table avec (au moins) capacity entrées, sans les
+ * entrées supprimées
+ */
+static int route_resize(struct volume_set* set, uint32_t capacity)
+{
+    uint32_t new_capacity = ROUTE_MIN_CAPACITY;
+    while (new_capacity < capacity)
+        new_capacity *= 2;
+
+    struct volume_route *routes = calloc(new_capacity, sizeof(struct volume_route));
+    if (routes == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    uint32_t filled = 0;
+    for (uint32_t i = 0; i < set->route_capacity; i++) {
+        if (set->routes[i].state == ROUTE_USED)
+            route_place(routes, new_capacity, set->routes[i].hash, set->routes[i].volume, &filled);
+    }
+
+    free(set->routes);
+    set->routes = routes;
+    set->route_capacity = new_capacity;
+    set->route_filled = filled;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Ajoute une image à l'index (la table est gardée remplie aux 3/4 au plus)
+ */
+static int route_add(struct volume_set* set, uint64_t hash, uint32_t volume)
+{
+    if ((set->route_filled + 1) * 4 > set->route_capacity * 3) {
+        // Beaucoup d'entrées supprimées : même taille suffit
+        uint32_t capacity = (set->route_count + 1) * 2 < set->route_capacity ? set->route_capacity : set->route_capacity * 2;
+
+        int retval = route_resize(set, capacity);
+        if (retval != ERR_NONE)
+            return retval;
+    }
+
+    route_place(set->routes, set->route_capacity, hash, volume, &set->route_filled);
+    set->route_count++;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Nom du fichier du volume numéro volume (à libérer par l'appelant)
+ */
+static char* volume_name(const struct volume_set* set, uint32_t volume)
+{
+    if (!set->directory)
+        return strdup(set->path);
+
+    size_t length = strlen(set->path) + sizeof(VOLUME_NAME_FORMAT) + 10;
+
+    char *name = malloc(length);
+    if (name != NULL)
+        snprintf(name, length, VOLUME_NAME_FORMAT, set->path, volume);
+
+    return name;
+}
+
+/********************************************************************//**
+ * Numéro d'un volume de l'ensemble
+ */
+static uint32_t volume_number(const struct volume_set* set, const struct pictdb_file* db_file)
+{
+    uint32_t i = 0;
+    while (i < set->count && set->volumes[i] != db_file)
+        i++;
+
+    return i;
+}
+
+/********************************************************************//**
+ * Prépare un volume ouvert : cache d'images, puis fichier d'index (ou, à
+ * défaut, index trié) qui sert à vérifier les entrées de l'index des volumes
+ */
+static int volume_prepare(const struct volume_set* set, struct pictdb_file* db_file, const char* name)
+{
+    int retval = ERR_NONE;
+
+    db_file->verify_crc = set->verify_crc;
+
+    if (set->cache_budget > 0)
+        retval = image_cache_init(&db_file->cache, set->cache_budget);
+
+    if (retval == ERR_NONE) {
+        const int writable = strchr(set->mode, '+') != NULL || strchr(set->mode, 'w') != NULL;
+
+        if (sidecar_open(db_file, name, writable) != ERR_NONE)
+            retval = id_index_build(db_file);
+    }
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Ouvre un volume et l'ajoute à la fin de l'ensemble
+ */
+static int volume_append(struct volume_set* set, const char* name)
+{
+    struct pictdb_file **volumes = realloc(set->volumes, (set->count + 1) * sizeof(struct pictdb_file*));
+    if (volumes == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    set->volumes = volumes;
+
+    struct pictdb_file *db_file = calloc(1, sizeof(struct pictdb_file));
+    if (db_file == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    int retval = set->lazy ? do_open_lazy(name, set->mode, db_file) : do_open(name, set->mode, db_file);
+    if (retval == ERR_NONE)
+        retval = volume_prepare(set, db_file, name);
+
+    if (retval != ERR_NONE) {
+        do_close(db_file);
+        free(db_file);
+        return retval;
+    }
+
+    set->volumes[set->count++] = db_file;
+
+    return ERR_NONE;
+}
+
+/********************************************************************//**
+ * Crée un nouveau volume, avec les paramètres du dernier volume
+ */
+static int volume_add(struct volume_set* set)
+{
+    if (set->count >= MAX_VOLUMES)
+        return ERR_FULL_DATABASE;
+
+    const struct pictdb_file *last = set->volumes[set->count - 1];
+
+    struct pictdb_file db_file;
+    db_file.header.max_files = (last->header.ext_offset != 0) ? last->ext.initial_files : last->header.max_files;
+    db_file.ext.page_size = last->ext.page_size;
+    db_file.ext.format_version = last->ext.format_version;
+
+    for (int i = 0; i < 2 * (NB_RES - 1); i++)
+        db_file.header.res_resized[i] = last->header.res_resized[i];
+
+    char *name = volume_name(set, set->count);
+    if (name == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    int retval = do_create(name, &db_file);
+    if (retval == ERR_NONE) {
+        // do_create ouvre le fichier en écriture seule
+        do_close(&db_file);
+        retval = volume_append(set, name);
+    }
+
+    free(name);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Volume dans lequel insérer la prochaine image : le dernier, remplacé
+ * par un nouveau volume s'il est plein ou a atteint la taille maximale
+ */
+static int volume_writable(struct volume_set* set, struct pictdb_file** db_file)
+{
+    struct pictdb_file *last = set->volumes[set->count - 1];
+    int full = last->header.num_files >= last->header.max_files && last->ext.page_size == 0;
+
+    if (!full && set->max_size > 0) {
+        if (fseek(last->fpdb, 0, SEEK_END) != 0)
+            return ERR_IO;
+
+        long size = ftell(last->fpdb);
+        if (size == -1)
+            return ERR_IO;
+
+        full = (uint64_t)size >= set->max_size;
+    }
+
+    // Un simple fichier n'est jamais complété par d'autres volumes
+    if (full && set->directory) {
+        int retval = volume_add(set);
+        if (retval != ERR_NONE)
+            return retval;
+
+        last = set->volumes[set->count - 1];
+    }
+
+    *db_file = last;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int volume_create(const char* dirname, struct pictdb_file* db_file)
+{
+    if (dirname == NULL || db_file == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    if (mkdir(dirname, 0755) != 0)
+        return ERR_IO;
+
+    struct volume_set set;
+    memset(&set, 0, sizeof(struct volume_set));
+    set.path = (char*)dirname;
+    set.directory = 1;
+
+    char *name = volume_name(&set, 0);
+    if (name == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    int retval = do_create(name, db_file);
+
+    free(name);
+
+    return retval;
+}
+
+/********************************************************************//**
+ * Ouverture des volumes, dont les metadatas sont lues à la demande si lazy
+ * n'est pas nul
+ */
+static int open_set(const char* path, const char* mode, int lazy, struct volume_set* set)
+{
+    if (path == NULL || mode == NULL || set == NULL)
+        return ERR_INVALID_ARGUMENT;
+
+    memset(set, 0, sizeof(struct volume_set));
+    set->mode = mode;
+    set->lazy = lazy;
+    set->max_size = VOLUME_MAX_SIZE;
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return ERR_INVALID_FILENAME;
+
+    set->directory = S_ISDIR(st.st_mode);
+    set->path = strdup(path);
+    if (set->path == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    int retval = ERR_NONE;
+    char *name = NULL;
+
+    // Ouverture des volumes, dans l'ordre, jusqu'au premier absent
+    for (uint32_t i = 0; i < MAX_VOLUMES; i++) {
+        name = volume_name(set, i);
+        if (name == NULL) {
+            retval = ERR_OUT_OF_MEMORY;
+            goto error;
+        }
+
+        if (set->directory && stat(name, &st) != 0)
+            break;
+
+        retval = volume_append(set, name);
+        if (retval != ERR_NONE)
+            goto error;
+
+        free(name);
+        name = NULL;
+
+        if (!set->directory)
+            break;
+    }
+
+    free(name);
+    name = NULL;
+
+    if (set->count == 0) {
+        retval = ERR_INVALID_FILENAME;
+        goto error;
+    }
+
+    // Index pict_id -> volume de toutes les images
+    uint32_t num_files = 0;
+    for (uint32_t i = 0; i < set->count; i++)
+        num_files += set->volumes[i]->header.num_files;
+
+    retval = route_resize(set, 2 * num_files);
+    if (retval != ERR_NONE)
+        goto error;
+
+    for (uint32_t v = 0; v < set->count; v++) {
+        const struct pictdb_file *db_file = set->volumes[v];
+
+        // Les hashs sont lus dans le fichier d'index, sans les metadatas
+        if (sidecar_is_current(db_file)) {
+            const struct sidecar *sidecar = db_file->sidecar;
+
+            for (uint32_t i = 0; i < sidecar->header->capacity; i++) {
+                if (sidecar->entries[i].index >= SIDECAR_DELETED)
+                    continue;
+
+                retval = route_add(set, sidecar->entries[i].hash, v);
+                if (retval != ERR_NONE)
+                    goto error;
+            }
+
+            continue;
+        }
+
+        const struct id_index *ids = &db_file->ids;
+
+        for (uint32_t i = 0; i < ids->count; i++) {
+            retval = route_add(set, pict_id_hash(ids->entries[i].pict_id), v);
+            if (retval != ERR_NONE)
+                goto error;
+        }
+    }
+
+    return ERR_NONE;
+
+error:
+    free(name);
+    volume_close(set);
+
+    return retval;
+}
+
+/********************************************************************/
+int volume_open(const char* path, const char* mode, struct volume_set* set)
+{
+    return open_set(path, mode, 0, set);
+}
+
+/********************************************************************/
+int volume_open_lazy(const char* path, const char* mode, struct volume_set* set)
+{
+    return open_set(path, mode, 1, set);
+}
+
+/********************************************************************/
+void volume_close(struct volume_set* set)
+{
+    for (uint32_t i = 0; i < set->count; i++) {
+        do_close(set->volumes[i]);
+        free(set->volumes[i]);
+    }
+
+    free(set->volumes);
+    free(set->routes);
+    free(set->path);
+
+    memset(set, 0, sizeof(struct volume_set));
+}
+
+/********************************************************************/
+int volume_set_cache(struct volume_set* set, size_t budget)
+{
+    set->cache_budget = (set->count > 0) ? budget / set->count : budget;
+
+    for (uint32_t i = 0; i < set->count; i++) {
+        image_cache_free(set->volumes[i]->cache);
+        set->volumes[i]->cache = NULL;
+
+        if (set->cache_budget > 0) {
+            int retval = image_cache_init(&set->volumes[i]->cache, set->cache_budget);
+            if (retval != ERR_NONE)
+                return retval;
+        }
+    }
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+void volume_cache_stats(const struct volume_set* set, struct image_cache_stats* stats)
+{
+    memset(stats, 0, sizeof(struct image_cache_stats));
+
+    for (uint32_t i = 0; i < set->count; i++) {
+        struct image_cache_stats volume;
+
+        if (set->volumes[i]->cache == NULL)
+            continue;
+
+        image_cache_get_stats(set->volumes[i]->cache, &volume);
+
+        stats->hits += volume.hits;
+        stats->misses += volume.misses;
+        stats->insertions += volume.insertions;
+        stats->evictions += volume.evictions;
+        stats->entries += volume.entries;
+        stats->used += volume.used;
+        stats->budget += volume.budget;
+    }
+}
+
+/********************************************************************/
+void volume_set_verify(struct volume_set* set, int verify_crc)
+{
+    set->verify_crc = verify_crc;
+
+    for (uint32_t i = 0; i < set->count; i++)
+        set->volumes[i]->verify_crc = verify_crc;
+}
+
+/********************************************************************/
+int volume_find(const struct volume_set* set, const char* pict_id, struct pictdb_file** db_file)
+{
+    if (pict_id == NULL)
+        return ERR_INVALID_PICID;
+
+    uint32_t slot = 0;
+    int retval = route_lookup(set, pict_id, &slot);
+    if (retval != ERR_NONE)
+        return retval;
+
+    *db_file = set->volumes[set->routes[slot].volume];
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int volume_insert(struct volume_set* set, const char* img, size_t size, const char* pict_id)
+{
+    return volume_insert_hashed(set, img, size, pict_id, NULL);
+}
+
+/********************************************************************/
+int volume_insert_hashed(struct volume_set* set, const char* img, size_t size, const char* pict_id,
+                         const unsigned char* sha)
+{
+    uint32_t slot = 0;
+    if (route_lookup(set, pict_id, &slot) == ERR_NONE)
+        return ERR_DUPLICATE_ID;
+
+    struct pictdb_file *db_file = NULL;
+    int retval = volume_writable(set, &db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    retval = do_insert_hashed(img, size, pict_id, sha, db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    return route_add(set, pict_id_hash(pict_id), volume_number(set, db_file));
+}
+
+/********************************************************************/
+int volume_insert_begin(struct volume_set* set, const char* pict_id, struct insert_stream* stream)
+{
+    if (pict_id == NULL)
+        return ERR_INVALID_PICID;
+
+    uint32_t slot = 0;
+    if (route_lookup(set, pict_id, &slot) == ERR_NONE)
+        return ERR_DUPLICATE_ID;
+
+    struct pictdb_file *db_file = NULL;
+    int retval = volume_writable(set, &db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    return do_insert_begin(pict_id, db_file, stream);
+}
+
+/********************************************************************/
+int volume_insert_end(struct volume_set* set, struct insert_stream* stream)
+{
+    // L'identifiant a pu être pris dans un autre volume entre temps
+    uint32_t slot = 0;
+    if (route_lookup(set, stream->pict_id, &slot) == ERR_NONE) {
+        do_insert_abort(stream);
+        return ERR_DUPLICATE_ID;
+    }
+
+    struct pictdb_file *db_file = stream->db_file;
+
+    int retval = do_insert_end(stream);
+    if (retval != ERR_NONE)
+        return retval;
+
+    return route_add(set, pict_id_hash(stream->pict_id), volume_number(set, db_file));
+}
+
+/********************************************************************/
+int volume_read(struct volume_set* set, const char* pict_id, uint32_t res, char** image_buffer, uint32_t* image_size)
+{
+    struct pictdb_file *db_file = NULL;
+
+    int retval = volume_find(set, pict_id, &db_file);
+    if (retval != ERR_NONE)
+        return retval;
+
+    return do_read(pict_id, res, image_buffer, image_size, db_file);
+}
+
+/********************************************************************/
+int volume_delete(struct volume_set* set, const char* pict_id)
+{
+    if (pict_id == NULL)
+        return ERR_INVALID_PICID;
+
+    uint32_t slot = 0;
+    int retval = route_lookup(set, pict_id, &slot);
+    if (retval != ERR_NONE)
+        return retval;
+
+    retval = do_delete(pict_id, set->volumes[set->routes[slot].volume]);
+    if (retval != ERR_NONE)
+        return retval;
+
+    set->routes[slot].state = ROUTE_DELETED;
+    set->route_count--;
+
+    return ERR_NONE;
+}
+
+/********************************************************************/
+int volume_gc(struct volume_set* set, uint32_t volume, const char* tmp_name)
+{
+    if (volume >= set->count)
+        return ERR_INVALID_ARGUMENT;
+
+    int retval = ERR_NONE;
+    char *tmp = NULL;
+
+    char *name = volume_name(set, volume);
+    if (name == NULL)
+        return ERR_OUT_OF_MEMORY;
+
+    // Fichier temporaire par défaut : à côté du volume
+    if (tmp_name == NULL) {
+        tmp = malloc(strlen(name) + sizeof(TMP_SUFFIX));
+        if (tmp == NULL) {
+            retval = ERR_OUT_OF_MEMORY;
+            goto end;
+        }
+
+        strcpy(tmp, name);
+        strcat(tmp, TMP_SUFFIX);
+        tmp_name = tmp;
+    }
+
+    struct pictdb_file *db_file = set->volumes[volume];
+
+    retval = do_gbcollect(db_file, name, tmp_name);
+    if (retval != ERR_NONE)
+        goto end;
+
+    // Le volume nettoyé remplace l'ancien : les images n'ont pas changé de
+    // volume, seules leurs positions ont changé
+    do_close(db_file);
+
+    retval = do_open(name, set->mode, db_file);
+    if (retval == ERR_NONE)
+        retval = volume_prepare(set, db_file, name);
+
+    // Volume illisible : il apparaît vide plutôt que de rester à moitié ouvert
+    if (retval != ERR_NONE) {
+        do_close(db_file);
+        memset(&db_file->header, 0, sizeof(struct pictdb_header));
+    }
+
+end:
+    free(tmp);
+    free(name);
+
+    return retval;
+}
+
+/********************************************************************/
+const char* volume_list_page(struct volume_set* set, enum do_list_mode mode, const struct list_query* query)
+{
+    return do_list_page_multi(set->volumes, set->count, mode, query);
+}
@@ -0,0 +1,200 @@
+/**
+ * @file volume.h
+ * @brief Ensemble de bases pictDB (volumes) adressé comme une seule base.
+ *
+ * Un ensemble de volumes est un répertoire contenant des fichiers pictDB
+ * nommés volume_0000.pictdb, volume_0001.pictdb, etc. Les insertions sont
+ * faites dans le dernier volume (le volume "ouvert") ; lorsqu'il est plein
+ * ou qu'il a atteint max_size octets, un nouveau volume est créé avec les
+ * mêmes paramètres. Les lectures et suppressions sont dirigées vers le bon
+ * volume par un index pict_id -> volume construit à l'ouverture, et chaque
+ * volume peut être nettoyé (garbage collecting) indépendamment des autres.
+ *
+ * Un simple fichier pictDB peut aussi être ouvert comme un ensemble d'un
+ * seul volume, auquel aucun volume n'est alors jamais ajouté.
+ *
+ * @author Dominique Roduit, Thierry Treyer
+ * @date 18 Oct 2026
+ */
+
+#ifndef PICTDBPRJ_VOLUME_H
+#define PICTDBPRJ_VOLUME_H
+
+#include <stddef.h> // pour size_t
+#include <stdint.h> // pour uint32_t, uint64_t
+#include <inttypes.h> // pour PRIu32
+
+#include "pictDB.h"
+#include "image_cache.h"
+
+#define VOLUME_NAME_FORMAT "%s/volume_%04" PRIu32 ".pictdb"
+#define MAX_VOLUMES 10000 // nombre max de volumes d'un ensemble
+#define VOLUME_MAX_SIZE ((uint64_t)1 << 32) // taille par défaut d'un volume (octets)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Entrée de l'index pict_id -> volume (table de hachage à adressage ouvert)
+struct volume_route {
+    // Hash de l'identifiant de l'image
+    uint64_t hash;
+    // Volume contenant l'image
+    uint32_t volume;
+    // ROUTE_EMPTY, ROUTE_USED ou ROUTE_DELETED
+    uint32_t state;
+};
+
+// Ensemble de volumes
+struct volume_set {
+    // Répertoire des volumes, ou fichier pictDB
+    char* path;
+    // Indique si path est un répertoire de volumes
+    int directory;
+    // Mode d'ouverture des volumes
+    const char* mode;
+    // Volumes, dans l'ordre de leur numéro ; le dernier est le volume ouvert
+    struct pictdb_file** volumes;
+    uint32_t count;
+    // Taille à partir de laquelle le volume ouvert est fermé aux insertions
+    uint64_t max_size;
+    // Budget du cache d'images de chaque volume (0 : pas de cache)
+    size_t cache_budget;
+    // Vérification du CRC des images lues (cf. pictdb_file.verify_crc)
+    int verify_crc;
+    // Metadatas des volumes lues à la demande (cf. volume_open_lazy)
+    int lazy;
+    // Index pict_id -> volume
+    struct volume_route* routes;
+    uint32_t route_capacity;
+    // Entrées utilisées (ROUTE_USED)
+    uint32_t route_count;
+    // Entrées utilisées ou supprimées (ROUTE_USED et ROUTE_DELETED)
+    uint32_t route_filled;
+};
+
+/**
+ * @brief Crée un ensemble de volumes : le répertoire dirname et son premier
+ * volume, avec les paramètres de db_file (cf. do_create).
+ * @param dirname Répertoire à créer
+ * @param db_file Paramètres des volumes (max_files, res_resized, ext.page_size)
+ * @return Code d'erreur approprié
+ */
+int volume_create(const char* dirname, struct pictdb_file* db_file);
+
+/**
+ * @brief Ouvre tous les volumes du répertoire path (ou le fichier pictDB
+ * path) et construit l'index pict_id -> volume.
+ * @param path Répertoire des volumes ou fichier pictDB
+ * @param mode Mode d'ouverture des volumes (cf. do_open)
+ * @param set Ensemble à initialiser
+ * @return Code d'erreur approprié
+ */
+int volume_open(const char* path, const char* mode, struct volume_set* set);
+
+/**
+ * @brief Comme volume_open, mais les metadatas des volumes ne sont lues
+ * qu'à la demande (cf. do_open_lazy) : pour les commandes qui ne touchent
+ * que quelques images (read, delete)
+ * @param path Répertoire des volumes ou fichier pictDB
+ * @param mode Mode d'ouverture des volumes (cf. do_open)
+ * @param set Ensemble à initialiser
+ * @return Code d'erreur approprié
+ */
+int volume_open_lazy(const char* path, const char* mode, struct volume_set* set);
+
+/**
+ * @brief Ferme tous les volumes et libère l'ensemble
+ * @param set Ensemble à fermer
+ */
+void volume_close(struct volume_set* set);
+
+/**
+ * @brief Donne à chaque volume (présent ou futur) un cache d'images
+ * @param set Ensemble de volumes
+ * @param budget Budget total, réparti entre les volumes actuels
+ * @return Code d'erreur approprié
+ */
+int volume_set_cache(struct volume_set* set, size_t budget);
+
+/**
+ * @brief Active ou désactive la vérification du CRC des images lues dans
+ * chaque volume (présent ou futur)
+ * @param set Ensemble de volumes
+ * @param verify_crc 1 pour vérifier, 0 sinon
+ */
+void volume_set_verify(struct volume_set* set, int verify_crc);
+
+/**
+ * @brief Recherche le volume contenant une image
+ * @param set Ensemble de volumes
+ * @param pict_id Identifiant de l'image
+ * @param db_file Reçoit le volume contenant l'image
+ * @return ERR_NONE ou ERR_FILE_NOT_FOUND
+ */
+int volume_find(const struct volume_set* set, const char* pict_id, struct pictdb_file** db_file);
+
+/**
+ * @brief Insère une image dans le volume ouvert (cf. do_insert)
+ * @return Code d'erreur approprié
+ */
+int volume_insert(struct volume_set* set, const char* img, size_t size, const char* pict_id);
+
+/**
+ * @brief Comme volume_insert, avec le SHA-256 de l'image déjà calculé
+ * (cf. do_insert_hashed)
+ * @return Code d'erreur approprié
+ */
+int volume_insert_hashed(struct volume_set* set, const char* img, size_t size, const char* pict_id,
+                         const unsigned char* sha);
+
+/**
+ * @brief Commence une insertion en flux dans le volume ouvert (cf. do_insert_begin)
+ * @return Code d'erreur approprié
+ */
+int volume_insert_begin(struct volume_set* set, const char* pict_id, struct insert_stream* stream);
+
+/**
+ * @brief Termine une insertion en flux et l'ajoute à l'index (cf. do_insert_end)
+ * @return Code d'erreur approprié
+ */
+int volume_insert_end(struct volume_set* set, struct insert_stream* stream);
+
+/**
+ * @brief Lit une image, quel que soit son volume (cf. do_read)
+ * @return Code d'erreur approprié
+ */
+int volume_read(struct volume_set* set, const char* pict_id, uint32_t res, char** image_buffer, uint32_t* image_size);
+
+/**
+ * @brief Supprime une image, quel que soit son volume (cf. do_delete)
+ * @return Code d'erreur approprié
+ */
+int volume_delete(struct volume_set* set, const char* pict_id);
+
+/**
+ * @brief Nettoie un seul volume (cf. do_gbcollect), puis le rouvre
+ * @param set Ensemble de volumes
+ * @param volume Numéro du volume à nettoyer
+ * @param tmp_name Fichier temporaire (NULL : nom du volume suivi de ".tmp")
+ * @return Code d'erreur approprié
+ */
+int volume_gc(struct volume_set* set, uint32_t volume, const char* tmp_name);
+
+/**
+ * @brief Compteurs des caches d'images, cumulés sur tous les volumes
+ * @param set Ensemble de volumes
+ * @param stats Compteurs remplis (budget nul si aucun volume n'a de cache)
+ */
+void volume_cache_stats(const struct volume_set* set, struct image_cache_stats* stats);
+
+/**
+ * @brief Liste une page d'images de tous les volumes (cf. do_list_page)
+ * @return En mode JSON, le document alloué dynamiquement, sinon NULL
+ */
+const char* volume_list_page(struct volume_set* set, enum do_list_mode mode, const struct list_query* query);
+
+#ifdef __cplusplus
+}
+#endif
+#endif